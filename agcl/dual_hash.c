@@ -0,0 +1,68 @@
+#include "dual_hash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "fast_agcl.h"
+#include "git_lfs.h"
+#include "git_object.h"
+
+// Pairs recorded by add workers, appended to the map in one go
+static pthread_mutex_t g_pairs_lock = PTHREAD_MUTEX_INITIALIZER;
+static avc_oid_t* g_avc_oids = NULL;
+static uint8_t* g_git_ids = NULL;
+static size_t g_pair_count = 0;
+static size_t g_pair_cap = 0;
+// Blobs this large are left to sync-to-git, which exports them to LFS
+static uint64_t g_lfs_threshold = 0;
+
+int dual_hash_enabled(void) {
+    struct stat st;
+    if (stat(".git/objects", &st) == -1 || !S_ISDIR(st.st_mode)) return 0;
+    if (!avc_config_get_bool(DUAL_HASH_SECTION, DUAL_HASH_KEY, 0)) return 0;
+    // The hook does not see file names, so LFS patterns rule it out
+    git_lfs_policy_t policy;
+    git_lfs_policy_load(&policy);
+    g_lfs_threshold = policy.threshold;
+    return policy.patterns[0] == '\0';
+}
+
+void dual_hash_record_blob(const avc_oid_t* oid, const char* content, size_t size) {
+    if (g_lfs_threshold > 0 && size >= g_lfs_threshold) return;
+    uint8_t git_id[GIT_OID_RAWSZ];
+    git_hash_object("blob", content, size, git_id);
+
+    // Only map blobs whose Git object exists, or sync would skip a missing one
+    if (git_write_loose_object("blob", content, size, git_id) != 0) return;
+
+    pthread_mutex_lock(&g_pairs_lock);
+    if (g_pair_count == g_pair_cap) {
+        size_t cap = g_pair_cap ? g_pair_cap * 2 : 256;
+        avc_oid_t* oids = realloc(g_avc_oids, cap * sizeof(avc_oid_t));
+        if (oids) g_avc_oids = oids;
+        uint8_t* ids = realloc(g_git_ids, cap * GIT_OID_RAWSZ);
+        if (ids) g_git_ids = ids;
+        if (!oids || !ids) {
+            pthread_mutex_unlock(&g_pairs_lock);
+            return;
+        }
+        g_pair_cap = cap;
+    }
+    g_avc_oids[g_pair_count] = *oid;
+    memcpy(g_git_ids + g_pair_count * GIT_OID_RAWSZ, git_id, GIT_OID_RAWSZ);
+    g_pair_count++;
+    pthread_mutex_unlock(&g_pairs_lock);
+}
+
+int dual_hash_flush(void) {
+    pthread_mutex_lock(&g_pairs_lock);
+    int result = hash_map_append_pairs(g_avc_oids, g_git_ids, g_pair_count);
+    free(g_avc_oids);
+    free(g_git_ids);
+    g_avc_oids = NULL;
+    g_git_ids = NULL;
+    g_pair_count = g_pair_cap = 0;
+    pthread_mutex_unlock(&g_pairs_lock);
+    return result;
+}
@@ -0,0 +1,25 @@
+#ifndef DUAL_HASH_H
+#define DUAL_HASH_H
+
+#include <stddef.h>
+#include "oid.h"
+
+// Opt-in dual hashing (agcl.dualhash in .avc/config). Every blob stored by
+// `avc add` also gets its Git SHA-1 and a zlib loose object while its
+// content is still in memory, and the AVC -> Git pair goes straight into
+// .git/avc-map. sync-to-git then finds all blobs converted already and only
+// writes trees and commits.
+
+#define DUAL_HASH_SECTION "agcl"
+#define DUAL_HASH_KEY "dualhash"
+
+// Nonzero if the mode is on and a Git repository sits alongside
+int dual_hash_enabled(void);
+
+// Blob hook for objects_set_blob_hook (thread-safe)
+void dual_hash_record_blob(const avc_oid_t* oid, const char* content, size_t size);
+
+// Append the pairs recorded so far to .git/avc-map
+int dual_hash_flush(void);
+
+#endif // DUAL_HASH_H
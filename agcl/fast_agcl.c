@@ -1,22 +1,79 @@
-#include "fast_agcl.h"
-#define _XOPEN_SOURCE 700   /* for strptime */
 #define _GNU_SOURCE
+#include "fast_agcl.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <zlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <arpa/inet.h>
 
-#define AGCL_MAP_PATH ".git/avc-map"
+// Table layout, integers in network order:
+//   "AVCM", version, pair count
+//   fanout by first AVC ID byte, then by first Git ID byte (256 x 4 each)
+//   pairs sorted by AVC ID: 32-byte AVC ID, 20-byte Git ID
+//   pair indexes sorted by Git ID (4 each)
+#define MAP_TABLE_MAGIC "AVCM"
+#define MAP_TABLE_VERSION 1
+#define MAP_HEADER_LEN 12
+#define MAP_FANOUT_LEN (256 * 4)
+#define MAP_RECORD_LEN (AVC_OID_RAWSZ + GIT_OID_RAWSZ)
+#define MAP_TABLE_TMP ".git/avc-map.bin.tmp"
 
-// FNV-1a hash for string keys
-static uint32_t hash_string(const char* str) {
-    uint32_t hash = 2166136261u;
-    while (*str) {
-        hash ^= (unsigned char)*str++;
-        hash *= 16777619u;
-    }
-    return hash % 4096;
+#define MAP_JOURNAL_LINE (AVC_OID_HEXSZ + 1 + GIT_OID_HEXSZ + 1)
+// The journal is merged once it has this many lines and at least an
+// eighth as many as the table
+#define MAP_MERGE_MIN 8192
+
+#define MAP_CHUNK 4096
+#define MAP_NONE UINT32_MAX
+
+typedef struct {
+    avc_oid_t avc_oid;
+    uint8_t git_id[GIT_OID_RAWSZ];
+} map_pair_t;
+
+struct hash_map {
+    const unsigned char* table;   // Read-only mapping of the table file
+    size_t table_size;
+    uint32_t table_count;
+    const unsigned char* fanout;
+    const unsigned char* records;
+    const unsigned char* reverse;
+
+    // Journal pairs and pairs set since loading, one per AVC ID. Chunks
+    // keep the pointers handed out by hash_map_get stable.
+    map_pair_t** chunks;
+    size_t chunk_count;
+    size_t count;
+    uint32_t* slots;              // By AVC ID, index + 1
+    uint32_t* git_slots;          // By Git ID, index + 1 (may point at replaced IDs)
+    size_t slot_mask;
+    size_t git_slots_used;
+
+    uint32_t* pending;            // Entries for the next commit
+    size_t pending_count;
+    size_t pending_capacity;
+};
+
+static map_pair_t* pair_at(const hash_map_t* map, uint32_t index) {
+    return &map->chunks[index / MAP_CHUNK][index % MAP_CHUNK];
+}
+
+static uint64_t git_hash(const uint8_t git_id[GIT_OID_RAWSZ]) {
+    uint64_t h;
+    memcpy(&h, git_id, sizeof(h));
+    return h;
+}
+
+static uint32_t read_u32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
 }
 
 hash_map_t* hash_map_create(void) {
@@ -24,94 +81,515 @@ hash_map_t* hash_map_create(void) {
     return map;
 }
 
+static uint32_t find_entry(const hash_map_t* map, const avc_oid_t* avc_oid) {
+    if (!map->slots) return MAP_NONE;
+    for (size_t s = oid_hash(avc_oid) & map->slot_mask; map->slots[s]; s = (s + 1) & map->slot_mask) {
+        uint32_t index = map->slots[s] - 1;
+        if (oid_equal(&pair_at(map, index)->avc_oid, avc_oid)) return index;
+    }
+    return MAP_NONE;
+}
+
+static uint32_t find_git_entry(const hash_map_t* map, const uint8_t git_id[GIT_OID_RAWSZ]) {
+    if (!map->git_slots) return MAP_NONE;
+    for (size_t s = git_hash(git_id) & map->slot_mask; map->git_slots[s]; s = (s + 1) & map->slot_mask) {
+        uint32_t index = map->git_slots[s] - 1;
+        if (memcmp(pair_at(map, index)->git_id, git_id, GIT_OID_RAWSZ) == 0) return index;
+    }
+    return MAP_NONE;
+}
+
+static void add_git_slot(hash_map_t* map, uint32_t index) {
+    size_t s = git_hash(pair_at(map, index)->git_id) & map->slot_mask;
+    while (map->git_slots[s]) s = (s + 1) & map->slot_mask;
+    map->git_slots[s] = index + 1;
+    map->git_slots_used++;
+}
+
+// Rebuild both slot tables at twice the size, dropping replaced Git IDs
+static int grow_slots(hash_map_t* map) {
+    size_t size = map->slots ? (map->slot_mask + 1) * 2 : 1 << 12;
+    uint32_t* slots = calloc(size, sizeof(uint32_t));
+    uint32_t* git_slots = calloc(size, sizeof(uint32_t));
+    if (!slots || !git_slots) {
+        free(slots);
+        free(git_slots);
+        return -1;
+    }
+    free(map->slots);
+    free(map->git_slots);
+    map->slots = slots;
+    map->git_slots = git_slots;
+    map->slot_mask = size - 1;
+    map->git_slots_used = 0;
+    for (uint32_t i = 0; i < map->count; i++) {
+        size_t s = oid_hash(&pair_at(map, i)->avc_oid) & map->slot_mask;
+        while (slots[s]) s = (s + 1) & map->slot_mask;
+        slots[s] = i + 1;
+        add_git_slot(map, i);
+    }
+    return 0;
+}
+
+// Add or replace the in-memory pair for an AVC ID; its index, or MAP_NONE
+static uint32_t put_entry(hash_map_t* map, const avc_oid_t* avc_oid, const uint8_t git_id[GIT_OID_RAWSZ]) {
+    uint32_t index = find_entry(map, avc_oid);
+    if (index != MAP_NONE) {
+        map_pair_t* pair = pair_at(map, index);
+        if (memcmp(pair->git_id, git_id, GIT_OID_RAWSZ) != 0) {
+            memcpy(pair->git_id, git_id, GIT_OID_RAWSZ);
+            if ((map->git_slots_used + 1) * 2 > map->slot_mask + 1 && grow_slots(map) != 0) return MAP_NONE;
+            if (find_git_entry(map, git_id) != index) add_git_slot(map, index);
+        }
+        return index;
+    }
+
+    if (map->count >= MAP_NONE - 1) return MAP_NONE;
+    size_t used = map->count > map->git_slots_used ? map->count : map->git_slots_used;
+    if ((used + 1) * 2 > map->slot_mask + 1 && grow_slots(map) != 0) return MAP_NONE;
+    if (map->count == map->chunk_count * MAP_CHUNK) {
+        map_pair_t** chunks = realloc(map->chunks, (map->chunk_count + 1) * sizeof(map_pair_t*));
+        if (!chunks) return MAP_NONE;
+        map->chunks = chunks;
+        map->chunks[map->chunk_count] = malloc(MAP_CHUNK * sizeof(map_pair_t));
+        if (!map->chunks[map->chunk_count]) return MAP_NONE;
+        map->chunk_count++;
+    }
+
+    index = (uint32_t)map->count++;
+    map_pair_t* pair = pair_at(map, index);
+    pair->avc_oid = *avc_oid;
+    memcpy(pair->git_id, git_id, GIT_OID_RAWSZ);
+    size_t s = oid_hash(avc_oid) & map->slot_mask;
+    while (map->slots[s]) s = (s + 1) & map->slot_mask;
+    map->slots[s] = index + 1;
+    add_git_slot(map, index);
+    return index;
+}
+
+// Binary search of the table's pairs by AVC ID
+static const unsigned char* table_find(const hash_map_t* map, const avc_oid_t* avc_oid) {
+    if (!map->table) return NULL;
+    uint8_t first = avc_oid->bytes[0];
+    uint32_t lo = first ? read_u32(map->fanout + (first - 1) * 4) : 0;
+    uint32_t hi = read_u32(map->fanout + first * 4);
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const unsigned char* record = map->records + (size_t)mid * MAP_RECORD_LEN;
+        int cmp = memcmp(record, avc_oid->bytes, AVC_OID_RAWSZ);
+        if (cmp == 0) return record;
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+// Binary search of the reverse index by Git ID
+static const unsigned char* table_find_git(const hash_map_t* map, const uint8_t git_id[GIT_OID_RAWSZ]) {
+    if (!map->table) return NULL;
+    const unsigned char* fanout = map->fanout + MAP_FANOUT_LEN;
+    uint32_t lo = git_id[0] ? read_u32(fanout + (git_id[0] - 1) * 4) : 0;
+    uint32_t hi = read_u32(fanout + git_id[0] * 4);
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        uint32_t index = read_u32(map->reverse + (size_t)mid * 4);
+        if (index >= map->table_count) return NULL;
+        const unsigned char* record = map->records + (size_t)index * MAP_RECORD_LEN;
+        int cmp = memcmp(record + AVC_OID_RAWSZ, git_id, GIT_OID_RAWSZ);
+        if (cmp == 0) return record;
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+// Map the table file; a missing table is an empty one
+static int map_table(hash_map_t* map) {
+    int fd = open(AGCL_MAP_TABLE_PATH, O_RDONLY);
+    if (fd == -1) return errno == ENOENT ? 0 : -1;
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= MAP_HEADER_LEN + 2 * MAP_FANOUT_LEN) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Warning: ignoring unreadable %s\n", AGCL_MAP_TABLE_PATH);
+        return 0;
+    }
+
+    const unsigned char* table = data;
+    uint32_t count = read_u32(table + 8);
+    size_t expected = MAP_HEADER_LEN + 2 * MAP_FANOUT_LEN + (size_t)count * (MAP_RECORD_LEN + 4);
+    if (memcmp(table, MAP_TABLE_MAGIC, 4) != 0 || read_u32(table + 4) != MAP_TABLE_VERSION ||
+        (size_t)st.st_size != expected || read_u32(table + MAP_HEADER_LEN + 255 * 4) != count) {
+        fprintf(stderr, "Warning: ignoring corrupt %s\n", AGCL_MAP_TABLE_PATH);
+        munmap(data, (size_t)st.st_size);
+        return 0;
+    }
+    map->table = table;
+    map->table_size = (size_t)st.st_size;
+    map->table_count = count;
+    map->fanout = table + MAP_HEADER_LEN;
+    map->records = map->fanout + 2 * MAP_FANOUT_LEN;
+    map->reverse = map->records + (size_t)count * MAP_RECORD_LEN;
+    return 0;
+}
+
+// Whole journal into memory; NULL with *size_out 0 if it is empty
+static char* read_journal(int fd, size_t* size_out) {
+    *size_out = 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) return NULL;
+    char* data = malloc((size_t)st.st_size + 1);
+    size_t size = 0;
+    while (data && size < (size_t)st.st_size) {
+        ssize_t n = pread(fd, data + size, (size_t)st.st_size - size, (off_t)size);
+        if (n <= 0) break;
+        size += (size_t)n;
+    }
+    if (data) data[size] = '\0';
+    *size_out = size;
+    return data;
+}
+
+// "<avc_hash> <git_hash>" per line; malformed and unfinished lines are skipped
+static int replay_journal(hash_map_t* map, const char* data, size_t size) {
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) break;
+        char avc_hash[AVC_OID_HEXSZ + 1], git_hash_hex[GIT_OID_HEXSZ + 1];
+        avc_oid_t avc_oid;
+        uint8_t git_id[GIT_OID_RAWSZ];
+        if (eol - p >= AVC_OID_HEXSZ + 1 + GIT_OID_HEXSZ &&
+            sscanf(p, "%64s %40s", avc_hash, git_hash_hex) == 2 &&
+            oid_from_hex(avc_hash, &avc_oid) == 0 &&
+            hex_decode(git_hash_hex, git_id, GIT_OID_RAWSZ) == 0) {
+            if (put_entry(map, &avc_oid, git_id) == MAP_NONE) return -1;
+        }
+        p = eol + 1;
+    }
+    return 0;
+}
+
+// Table and journal as of one moment; the caller holds a lock on journal_fd
+static int load_locked(hash_map_t* map, int journal_fd) {
+    if (map_table(map) != 0) return -1;
+    if (journal_fd == -1) return 0;
+    size_t size;
+    char* data = read_journal(journal_fd, &size);
+    int result = replay_journal(map, data ? data : "", size);
+    free(data);
+    return result;
+}
+
 int hash_map_load(hash_map_t* map) {
     if (!map) return -1;
-    
-    FILE* fp = fopen(AGCL_MAP_PATH, "r");
-    if (!fp) return 0; // No mappings yet
-    
-    char avc_hash[65], git_hash[41];
-    while (fscanf(fp, "%64s %40s", avc_hash, git_hash) == 2) {
-        hash_map_set(map, avc_hash, git_hash);
-    }
-    
-    fclose(fp);
+
+    // A merge swaps the table and empties the journal under an exclusive lock
+    int fd = open(AGCL_MAP_PATH, O_RDONLY);
+    if (fd != -1) flock(fd, LOCK_SH);
+    int result = load_locked(map, fd);
+    if (fd != -1) close(fd);
+    return result;
+}
+
+const uint8_t* hash_map_get(hash_map_t* map, const avc_oid_t* avc_oid) {
+    if (!map || !avc_oid) return NULL;
+    uint32_t index = find_entry(map, avc_oid);
+    if (index != MAP_NONE) return pair_at(map, index)->git_id;
+    const unsigned char* record = table_find(map, avc_oid);
+    return record ? record + AVC_OID_RAWSZ : NULL;
+}
+
+int hash_map_get_avc(hash_map_t* map, const uint8_t git_id[GIT_OID_RAWSZ], avc_oid_t* avc_oid_out) {
+    if (!map || !git_id) return -1;
+    uint32_t index = find_git_entry(map, git_id);
+    if (index != MAP_NONE) {
+        *avc_oid_out = pair_at(map, index)->avc_oid;
+        return 0;
+    }
+    // A table pair replaced in the journal no longer counts
+    const unsigned char* record = table_find_git(map, git_id);
+    if (!record) return -1;
+    memcpy(avc_oid_out->bytes, record, AVC_OID_RAWSZ);
+    if (find_entry(map, avc_oid_out) != MAP_NONE) return -1;
     return 0;
 }
 
-const char* hash_map_get(hash_map_t* map, const char* avc_hash) {
-    if (!map || !avc_hash) return NULL;
-    
-    uint32_t bucket = hash_string(avc_hash);
-    hash_map_entry_t* entry = map->buckets[bucket];
-    
-    while (entry) {
-        if (strcmp(entry->avc_hash, avc_hash) == 0) {
-            return entry->git_hash;
+int hash_map_set(hash_map_t* map, const avc_oid_t* avc_oid, const uint8_t git_id[GIT_OID_RAWSZ]) {
+    if (!map || !avc_oid || !git_id) return -1;
+
+    // Already recorded with this value
+    const uint8_t* current = hash_map_get(map, avc_oid);
+    if (current && memcmp(current, git_id, GIT_OID_RAWSZ) == 0) return 0;
+
+    uint32_t index = put_entry(map, avc_oid, git_id);
+    if (index == MAP_NONE) return -1;
+    if (map->pending_count == map->pending_capacity) {
+        size_t capacity = map->pending_capacity ? map->pending_capacity * 2 : 1024;
+        uint32_t* pending = realloc(map->pending, capacity * sizeof(uint32_t));
+        if (!pending) return -1;
+        map->pending = pending;
+        map->pending_capacity = capacity;
+    }
+    map->pending[map->pending_count++] = index;
+    return 0;
+}
+
+// Pair count in the table header, without mapping the table
+static uint32_t table_count(void) {
+    unsigned char header[MAP_HEADER_LEN];
+    int fd = open(AGCL_MAP_TABLE_PATH, O_RDONLY);
+    if (fd == -1) return 0;
+    ssize_t n = pread(fd, header, sizeof(header), 0);
+    close(fd);
+    if (n != (ssize_t)sizeof(header) || memcmp(header, MAP_TABLE_MAGIC, 4) != 0) return 0;
+    return read_u32(header + 8);
+}
+
+typedef struct {
+    uint8_t git_id[GIT_OID_RAWSZ];
+    uint32_t index;
+} reverse_entry_t;
+
+static int compare_pairs(const void* a, const void* b) {
+    return memcmp(((const map_pair_t*)a)->avc_oid.bytes, ((const map_pair_t*)b)->avc_oid.bytes, AVC_OID_RAWSZ);
+}
+
+static int compare_reverse(const void* a, const void* b) {
+    const reverse_entry_t* x = a;
+    const reverse_entry_t* y = b;
+    int cmp = memcmp(x->git_id, y->git_id, GIT_OID_RAWSZ);
+    if (cmp != 0) return cmp;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static void write_u32(FILE* fp, uint32_t value) {
+    uint32_t be = htonl(value);
+    fwrite(&be, 4, 1, fp);
+}
+
+// New table from the current one and the journal pairs of map
+static int write_table(const hash_map_t* map, const char* path) {
+    // Journal pairs in AVC ID order, merged with the (sorted) table pairs
+    map_pair_t* journal = malloc((map->count + 1) * sizeof(map_pair_t));
+    if (!journal) return -1;
+    for (uint32_t i = 0; i < map->count; i++) journal[i] = *pair_at(map, i);
+    qsort(journal, map->count, sizeof(map_pair_t), compare_pairs);
+
+    size_t max = (size_t)map->table_count + map->count;
+    map_pair_t* pairs = malloc((max + 1) * sizeof(map_pair_t));
+    reverse_entry_t* reverse = malloc((max + 1) * sizeof(reverse_entry_t));
+    if (!pairs || !reverse || max >= MAP_NONE) {
+        free(journal);
+        free(pairs);
+        free(reverse);
+        return -1;
+    }
+    size_t count = 0, t = 0, j = 0;
+    while (t < map->table_count || j < map->count) {
+        const unsigned char* record = t < map->table_count ? map->records + t * MAP_RECORD_LEN : NULL;
+        int cmp = !record ? 1 : j == map->count ? -1 : memcmp(record, journal[j].avc_oid.bytes, AVC_OID_RAWSZ);
+        if (cmp < 0) {
+            memcpy(pairs[count].avc_oid.bytes, record, AVC_OID_RAWSZ);
+            memcpy(pairs[count].git_id, record + AVC_OID_RAWSZ, GIT_OID_RAWSZ);
+            t++;
+        } else {
+            pairs[count] = journal[j++];
+            if (cmp == 0) t++;  // The journal's value replaces the table's
         }
-        entry = entry->next;
+        count++;
     }
-    
-    return NULL;
+    free(journal);
+
+    for (size_t i = 0; i < count; i++) {
+        memcpy(reverse[i].git_id, pairs[i].git_id, GIT_OID_RAWSZ);
+        reverse[i].index = (uint32_t)i;
+    }
+    qsort(reverse, count, sizeof(reverse_entry_t), compare_reverse);
+
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        free(pairs);
+        free(reverse);
+        return -1;
+    }
+    fwrite(MAP_TABLE_MAGIC, 1, 4, fp);
+    write_u32(fp, MAP_TABLE_VERSION);
+    write_u32(fp, (uint32_t)count);
+    size_t at = 0;
+    for (int byte = 0; byte < 256; byte++) {
+        while (at < count && pairs[at].avc_oid.bytes[0] == byte) at++;
+        write_u32(fp, (uint32_t)at);
+    }
+    at = 0;
+    for (int byte = 0; byte < 256; byte++) {
+        while (at < count && reverse[at].git_id[0] == byte) at++;
+        write_u32(fp, (uint32_t)at);
+    }
+    for (size_t i = 0; i < count; i++) {
+        fwrite(pairs[i].avc_oid.bytes, 1, AVC_OID_RAWSZ, fp);
+        fwrite(pairs[i].git_id, 1, GIT_OID_RAWSZ, fp);
+    }
+    for (size_t i = 0; i < count; i++) write_u32(fp, reverse[i].index);
+    free(pairs);
+    free(reverse);
+
+    int failed = ferror(fp) || fflush(fp) != 0 || fsync(fileno(fp)) != 0;
+    if (fclose(fp) != 0 || failed) {
+        unlink(path);
+        return -1;
+    }
+    return 0;
 }
 
-int hash_map_set(hash_map_t* map, const char* avc_hash, const char* git_hash) {
-    if (!map || !avc_hash || !git_hash) return -1;
-    
-    uint32_t bucket = hash_string(avc_hash);
-    
-    // Check if exists
-    hash_map_entry_t* entry = map->buckets[bucket];
-    while (entry) {
-        if (strcmp(entry->avc_hash, avc_hash) == 0) {
-            strcpy(entry->git_hash, git_hash);
-            return 0;
+// Fold the journal into a new table and empty it. Appends wait meanwhile;
+// if another merge is running this one gives up.
+static int merge_journal(void) {
+    int fd = open(AGCL_MAP_PATH, O_RDWR);
+    if (fd == -1) return errno == ENOENT ? 0 : -1;
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return 0;
+    }
+
+    hash_map_t* map = hash_map_create();
+    int result = map ? load_locked(map, fd) : -1;
+    if (result == 0 && map->count > 0) {
+        result = write_table(map, MAP_TABLE_TMP);
+        if (result == 0 && rename(MAP_TABLE_TMP, AGCL_MAP_TABLE_PATH) != 0) {
+            unlink(MAP_TABLE_TMP);
+            result = -1;
+        }
+        if (result == 0 && ftruncate(fd, 0) != 0) result = -1;
+    }
+    hash_map_free(map);
+    close(fd);
+    return result;
+}
+
+// Merge in a detached grandchild, so the command does not wait for it and
+// leaves no zombie behind. It lets go of stdio too: a pipe reading the
+// command's output ends with the command.
+static void merge_in_background(void) {
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (fork() == 0) {
+            setsid();
+            int null_fd = open("/dev/null", O_RDWR);
+            if (null_fd != -1) {
+                dup2(null_fd, STDIN_FILENO);
+                dup2(null_fd, STDOUT_FILENO);
+                dup2(null_fd, STDERR_FILENO);
+                if (null_fd > STDERR_FILENO) close(null_fd);
+            }
+            _exit(merge_journal() == 0 ? 0 : 1);
+        }
+        _exit(0);
+    }
+    if (pid > 0) waitpid(pid, NULL, 0);
+}
+
+// Append whole lines under an exclusive lock, so concurrent writers and a
+// merge never interleave, then merge if the journal has grown large
+static int append_journal(const char* data, size_t size) {
+    int fd = open(AGCL_MAP_PATH, O_RDWR | O_APPEND | O_CREAT, 0644);
+    if (fd == -1) return -1;
+    flock(fd, LOCK_EX);
+
+    // Finish a line torn by an interrupted writer so the new ones parse
+    struct stat st;
+    char last = '\n';
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && pread(fd, &last, 1, st.st_size - 1) == 1 && last != '\n') {
+        if (write(fd, "\n", 1) != 1) {
+            close(fd);
+            return -1;
         }
-        entry = entry->next;
-    }
-    
-    // Create new entry
-    entry = malloc(sizeof(hash_map_entry_t));
-    if (!entry) return -1;
-    
-    strcpy(entry->avc_hash, avc_hash);
-    strcpy(entry->git_hash, git_hash);
-    entry->next = map->buckets[bucket];
-    map->buckets[bucket] = entry;
-    map->count++;
-    
+    }
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = write(fd, data + written, size - written);
+        if (n <= 0) break;
+        written += (size_t)n;
+    }
+    off_t journal_size = fstat(fd, &st) == 0 ? st.st_size : 0;
+    close(fd);
+    if (written != size) return -1;
+
+    size_t lines = (size_t)journal_size / MAP_JOURNAL_LINE;
+    if (lines >= MAP_MERGE_MIN && lines * 8 >= table_count()) merge_in_background();
     return 0;
 }
 
+static int append_lines(const avc_oid_t* const* avc_oids, const uint8_t* const* git_ids, size_t count) {
+    if (count == 0) return 0;
+    char* data = malloc(count * MAP_JOURNAL_LINE + 1);
+    if (!data) return -1;
+    char* p = data;
+    for (size_t i = 0; i < count; i++) {
+        oid_to_hex(avc_oids[i], p);
+        p[AVC_OID_HEXSZ] = ' ';
+        hex_encode(git_ids[i], GIT_OID_RAWSZ, p + AVC_OID_HEXSZ + 1);
+        p[MAP_JOURNAL_LINE - 1] = '\n';
+        p += MAP_JOURNAL_LINE;
+    }
+    int result = append_journal(data, count * MAP_JOURNAL_LINE);
+    free(data);
+    return result;
+}
+
 int hash_map_commit(hash_map_t* map) {
     if (!map) return -1;
-    
-    FILE* fp = fopen(AGCL_MAP_PATH, "w");
-    if (!fp) return -1;
-    
-    for (int i = 0; i < 4096; i++) {
-        hash_map_entry_t* entry = map->buckets[i];
-        while (entry) {
-            fprintf(fp, "%s %s\n", entry->avc_hash, entry->git_hash);
-            entry = entry->next;
+    const avc_oid_t** avc_oids = malloc((map->pending_count + 1) * sizeof(avc_oid_t*));
+    const uint8_t** git_ids = malloc((map->pending_count + 1) * sizeof(uint8_t*));
+    int result = -1;
+    if (avc_oids && git_ids) {
+        for (size_t i = 0; i < map->pending_count; i++) {
+            const map_pair_t* pair = pair_at(map, map->pending[i]);
+            avc_oids[i] = &pair->avc_oid;
+            git_ids[i] = pair->git_id;
         }
+        result = append_lines(avc_oids, git_ids, map->pending_count);
+        if (result == 0) map->pending_count = 0;
     }
-    
-    fclose(fp);
-    return 0;
+    free(avc_oids);
+    free(git_ids);
+    return result;
 }
 
-void hash_map_free(hash_map_t* map) {
-    if (!map) return;
-    
-    for (int i = 0; i < 4096; i++) {
-        hash_map_entry_t* entry = map->buckets[i];
-        while (entry) {
-            hash_map_entry_t* next = entry->next;
-            free(entry);
-            entry = next;
+int hash_map_append_pairs(const avc_oid_t* avc_oids, const uint8_t* git_ids, size_t count) {
+    const avc_oid_t** avc_ptrs = malloc((count + 1) * sizeof(avc_oid_t*));
+    const uint8_t** git_ptrs = malloc((count + 1) * sizeof(uint8_t*));
+    int result = -1;
+    if (avc_ptrs && git_ptrs) {
+        for (size_t i = 0; i < count; i++) {
+            avc_ptrs[i] = &avc_oids[i];
+            git_ptrs[i] = git_ids + i * GIT_OID_RAWSZ;
         }
+        result = append_lines(avc_ptrs, git_ptrs, count);
     }
-    
+    free(avc_ptrs);
+    free(git_ptrs);
+    return result;
+}
+
+void hash_map_free(hash_map_t* map) {
+    if (!map) return;
+    if (map->table) munmap((void*)map->table, map->table_size);
+    for (size_t i = 0; i < map->chunk_count; i++) free(map->chunks[i]);
+    free(map->chunks);
+    free(map->slots);
+    free(map->git_slots);
+    free(map->pending);
     free(map);
-}
\ No newline at end of file
+}
@@ -2,35 +2,49 @@
 #define FAST_AGCL_H
 
 #include <stddef.h>
-
-// Fast hash mapping cache
-typedef struct hash_map_entry {
-    char avc_hash[65];
-    char git_hash[41];
-    struct hash_map_entry* next;
-} hash_map_entry_t;
-
-typedef struct {
-    hash_map_entry_t* buckets[4096];
-    size_t count;
-} hash_map_t;
-
-// Initialize hash mapping cache
+#include <stdint.h>
+#include "oid.h"
+
+#define GIT_OID_RAWSZ 20
+#define GIT_OID_HEXSZ 40
+
+// AVC <-> Git ID map of a repository, kept in two files:
+//   .git/avc-map.bin  Sorted binary table of (AVC ID, Git ID) pairs with a
+//                     reverse index sorted by Git ID; mmap'ed and
+//                     binary-searched, never read as a whole
+//   .git/avc-map      Append-only journal of "<avc_hash> <git_hash>" lines,
+//                     newer lines win (older versions kept only this file)
+// Loading maps the table and reads just the journal. Once the journal is
+// large next to the table, a background process merges it in.
+#define AGCL_MAP_PATH ".git/avc-map"
+#define AGCL_MAP_TABLE_PATH ".git/avc-map.bin"
+
+typedef struct hash_map hash_map_t;
+
+// Initialize an empty map
 hash_map_t* hash_map_create(void);
 
-// Load all mappings into memory
+// Map the table and replay the journal
 int hash_map_load(hash_map_t* map);
 
-// Fast lookup
-const char* hash_map_get(hash_map_t* map, const char* avc_hash);
+// Raw Git SHA-1 for an AVC object, or NULL. Safe to call from several
+// threads while nothing is being set.
+const uint8_t* hash_map_get(hash_map_t* map, const avc_oid_t* avc_oid);
 
-// Fast insert
-int hash_map_set(hash_map_t* map, const char* avc_hash, const char* git_hash);
+// Reverse lookup: an AVC object that converts to git_id; 0 if found
+int hash_map_get_avc(hash_map_t* map, const uint8_t git_id[GIT_OID_RAWSZ], avc_oid_t* avc_oid_out);
 
-// Batch commit to disk
+// Record a pair in memory; hash_map_commit appends it to the journal
+int hash_map_set(hash_map_t* map, const avc_oid_t* avc_oid, const uint8_t git_id[GIT_OID_RAWSZ]);
+
+// Append the pairs set since loading to the journal
 int hash_map_commit(hash_map_t* map);
 
+// Append count pairs to the journal without loading the map (git_ids holds
+// count * GIT_OID_RAWSZ bytes). Duplicates are harmless: the last one wins.
+int hash_map_append_pairs(const avc_oid_t* avc_oids, const uint8_t* git_ids, size_t count);
+
 // Free hash map
 void hash_map_free(hash_map_t* map);
 
-#endif // FAST_AGCL_H
\ No newline at end of file
+#endif // FAST_AGCL_H
@@ -0,0 +1,192 @@
+#define _XOPEN_SOURCE 700
+#include "git_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <openssl/evp.h>
+#include "config.h"
+#ifdef AVC_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+static const EVP_MD* g_sha1_md = NULL;
+static pthread_once_t g_sha1_once = PTHREAD_ONCE_INIT;
+// Per-thread context reused for object IDs, freed when the thread exits
+static pthread_key_t g_sha1_key;
+
+static void free_thread_ctx(void* ctx) {
+    EVP_MD_CTX_free(ctx);
+}
+
+// Fetch the implementation once: an implicit fetch on every init costs more
+// than hashing a small object
+static void init_sha1(void) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    g_sha1_md = EVP_MD_fetch(NULL, "SHA1", NULL);
+#endif
+    if (!g_sha1_md) g_sha1_md = EVP_sha1();
+    pthread_key_create(&g_sha1_key, free_thread_ctx);
+}
+
+int git_sha1_init(git_sha1_t* sha) {
+    pthread_once(&g_sha1_once, init_sha1);
+    sha->ctx = EVP_MD_CTX_new();
+    if (!sha->ctx || EVP_DigestInit_ex(sha->ctx, g_sha1_md, NULL) != 1) {
+        EVP_MD_CTX_free(sha->ctx);
+        sha->ctx = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void git_sha1_update(git_sha1_t* sha, const void* data, size_t len) {
+    if (sha->ctx) EVP_DigestUpdate(sha->ctx, data, len);
+}
+
+void git_sha1_final(git_sha1_t* sha, uint8_t out[GIT_OID_RAWSZ]) {
+    if (!sha->ctx || EVP_DigestFinal_ex(sha->ctx, out, NULL) != 1) memset(out, 0, GIT_OID_RAWSZ);
+    EVP_MD_CTX_free(sha->ctx);
+    sha->ctx = NULL;
+}
+
+// Hash parts as one stream with this thread's context
+static void sha1_parts(const void* a, size_t a_len, const void* b, size_t b_len, uint8_t out[GIT_OID_RAWSZ]) {
+    pthread_once(&g_sha1_once, init_sha1);
+    EVP_MD_CTX* ctx = pthread_getspecific(g_sha1_key);
+    if (!ctx) {
+        ctx = EVP_MD_CTX_new();
+        if (ctx) pthread_setspecific(g_sha1_key, ctx);
+    }
+    if (!ctx || EVP_DigestInit_ex(ctx, g_sha1_md, NULL) != 1 ||
+        EVP_DigestUpdate(ctx, a, a_len) != 1 || EVP_DigestUpdate(ctx, b, b_len) != 1 ||
+        EVP_DigestFinal_ex(ctx, out, NULL) != 1) {
+        memset(out, 0, GIT_OID_RAWSZ);
+    }
+}
+
+void git_sha1(const void* data, size_t len, uint8_t out[GIT_OID_RAWSZ]) {
+    sha1_parts(data, len, "", 0, out);
+}
+
+void git_codec_hash_object(const char* type, const char* content, size_t size,
+                           uint8_t git_id_out[GIT_OID_RAWSZ]) {
+    char header[64];
+    int header_len = snprintf(header, sizeof(header), "%s %zu", type, size);
+    sha1_parts(header, (size_t)header_len + 1, content, size, git_id_out);
+}
+
+static int g_level = GIT_CODEC_DEFAULT_LEVEL;
+static pthread_once_t g_level_once = PTHREAD_ONCE_INIT;
+
+static void read_level(void) {
+    int level = avc_config_get_int("agcl", "compression", GIT_CODEC_DEFAULT_LEVEL);
+    if (level < 0 || level > GIT_CODEC_MAX_LEVEL) level = GIT_CODEC_DEFAULT_LEVEL;
+    g_level = level;
+}
+
+int git_codec_level(void) {
+    pthread_once(&g_level_once, read_level);
+    return g_level;
+}
+
+#ifdef AVC_HAVE_LIBDEFLATE
+
+static pthread_key_t g_compressor_key;
+static pthread_once_t g_compressor_once = PTHREAD_ONCE_INIT;
+
+static void free_compressor(void* compressor) {
+    libdeflate_free_compressor(compressor);
+}
+
+static void init_compressor_key(void) {
+    pthread_key_create(&g_compressor_key, free_compressor);
+}
+
+const char* git_codec_backend(void) {
+    return "libdeflate";
+}
+
+// libdeflate needs the input in one piece, so a prefix (a loose object's
+// header) costs one copy of the content
+unsigned char* git_codec_deflate(const void* prefix, size_t prefix_len, const void* data, size_t size,
+                                 size_t* size_out) {
+    pthread_once(&g_compressor_once, init_compressor_key);
+    struct libdeflate_compressor* compressor = pthread_getspecific(g_compressor_key);
+    if (!compressor) {
+        compressor = libdeflate_alloc_compressor(git_codec_level());
+        if (!compressor) return NULL;
+        pthread_setspecific(g_compressor_key, compressor);
+    }
+
+    const void* in = data;
+    char* joined = NULL;
+    if (prefix_len > 0) {
+        joined = malloc(prefix_len + size);
+        if (!joined) return NULL;
+        memcpy(joined, prefix, prefix_len);
+        memcpy(joined + prefix_len, data, size);
+        in = joined;
+    }
+    size_t bound = libdeflate_zlib_compress_bound(compressor, prefix_len + size);
+    unsigned char* out = malloc(bound);
+    size_t n = out ? libdeflate_zlib_compress(compressor, in, prefix_len + size, out, bound) : 0;
+    free(joined);
+    if (n == 0) {
+        free(out);
+        return NULL;
+    }
+    *size_out = n;
+    return out;
+}
+
+#else
+
+const char* git_codec_backend(void) {
+    return "zlib";
+}
+
+// Prefix and data go through one deflate stream without being joined
+unsigned char* git_codec_deflate(const void* prefix, size_t prefix_len, const void* data, size_t size,
+                                 size_t* size_out) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit(&zs, git_codec_level()) != Z_OK) return NULL;
+
+    uLong bound = deflateBound(&zs, (uLong)(prefix_len + size));
+    unsigned char* out = malloc(bound);
+    if (!out) {
+        deflateEnd(&zs);
+        return NULL;
+    }
+    zs.next_out = out;
+    zs.avail_out = (uInt)bound;
+
+    zs.next_in = (Bytef*)prefix;
+    zs.avail_in = (uInt)prefix_len;
+    int ret = prefix_len > 0 ? deflate(&zs, Z_NO_FLUSH) : Z_OK;
+
+    // zlib counts input in uInt, so feed very large blobs in slices
+    const char* p = data;
+    size_t left = size;
+    while (ret == Z_OK && left > 0) {
+        uInt slice = left > (1u << 30) ? (1u << 30) : (uInt)left;
+        zs.next_in = (Bytef*)p;
+        zs.avail_in = slice;
+        ret = deflate(&zs, Z_NO_FLUSH);
+        p += slice - zs.avail_in;
+        left -= slice - zs.avail_in;
+    }
+    if (ret == Z_OK) ret = deflate(&zs, Z_FINISH);
+
+    *size_out = zs.total_out;
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef GIT_CODEC_H
+#define GIT_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fast_agcl.h"
+
+// Hashing and compression of Git objects. SHA-1 goes through OpenSSL's EVP
+// interface, which uses the CPU's SHA extensions (SHA-NI, ARMv8 SHA1) when
+// present. Deflate uses libdeflate when the build found it (whole buffers,
+// much faster at the same level) and zlib otherwise. Both produce zlib
+// streams that git reads alike.
+
+#define GIT_CODEC_DEFAULT_LEVEL 6
+#define GIT_CODEC_MAX_LEVEL 9
+
+// Streaming SHA-1 (e.g. over a whole pack); -1 if OpenSSL fails
+typedef struct {
+    void* ctx;
+} git_sha1_t;
+
+int git_sha1_init(git_sha1_t* sha);
+void git_sha1_update(git_sha1_t* sha, const void* data, size_t len);
+void git_sha1_final(git_sha1_t* sha, uint8_t out[GIT_OID_RAWSZ]);
+
+// SHA-1 of one buffer
+void git_sha1(const void* data, size_t len, uint8_t out[GIT_OID_RAWSZ]);
+
+// Git object ID: SHA-1 of "type size\0" followed by content, hashed as one
+// stream without joining them. Thread-safe.
+void git_codec_hash_object(const char* type, const char* content, size_t size,
+                           uint8_t git_id_out[GIT_OID_RAWSZ]);
+
+// Deflate level: [agcl] compression in .avc/config (0-9, default 6, like
+// git's core.compression). Read once.
+int git_codec_level(void);
+
+// "libdeflate" or "zlib"
+const char* git_codec_backend(void);
+
+// One zlib stream of prefix (may be empty) followed by data, in a malloc'ed
+// buffer; NULL on error. Thread-safe.
+unsigned char* git_codec_deflate(const void* prefix, size_t prefix_len, const void* data, size_t size,
+                                 size_t* size_out);
+
+#endif // GIT_CODEC_H
@@ -0,0 +1,221 @@
+#include "git_delta.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DELTA_BLOCK 16
+#define DELTA_HASH_MULT 0x01000193u      // FNV prime, odd so the hash rolls
+#define DELTA_MAX_COPY 0x10000           // Largest copy git's encoder emits
+#define DELTA_MAX_INSERT 0x7f
+#define DELTA_MAX_BASE 0xffffffffu       // Copy offsets are 32-bit
+
+typedef struct {
+    unsigned char* data;
+    size_t len;
+    size_t cap;
+    size_t max;
+} delta_out_t;
+
+static int out_reserve(delta_out_t* out, size_t extra) {
+    if (out->len + extra > out->max) return -1;
+    if (out->len + extra <= out->cap) return 0;
+    size_t cap = out->cap * 2;
+    while (cap < out->len + extra) cap *= 2;
+    unsigned char* data = realloc(out->data, cap);
+    if (!data) return -1;
+    out->data = data;
+    out->cap = cap;
+    return 0;
+}
+
+static int out_varint(delta_out_t* out, size_t value) {
+    if (out_reserve(out, 10) != 0) return -1;
+    do {
+        unsigned char byte = value & 0x7f;
+        value >>= 7;
+        out->data[out->len++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return 0;
+}
+
+static int out_insert(delta_out_t* out, const unsigned char* data, size_t len) {
+    while (len > 0) {
+        size_t n = len > DELTA_MAX_INSERT ? DELTA_MAX_INSERT : len;
+        if (out_reserve(out, n + 1) != 0) return -1;
+        out->data[out->len++] = (unsigned char)n;
+        memcpy(out->data + out->len, data, n);
+        out->len += n;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int out_copy(delta_out_t* out, size_t offset, size_t len) {
+    while (len > 0) {
+        size_t n = len > DELTA_MAX_COPY ? DELTA_MAX_COPY : len;
+        if (out_reserve(out, 8) != 0) return -1;
+        unsigned char* cmd = &out->data[out->len++];
+        *cmd = 0x80;
+        for (int i = 0; i < 4; i++) {
+            unsigned char byte = (offset >> (i * 8)) & 0xff;
+            if (byte) {
+                out->data[out->len++] = byte;
+                *cmd |= 1 << i;
+            }
+        }
+        // A size of 0x10000 is encoded by leaving every size byte out
+        if (n != DELTA_MAX_COPY) {
+            for (int i = 0; i < 3; i++) {
+                unsigned char byte = (n >> (i * 8)) & 0xff;
+                if (byte) {
+                    out->data[out->len++] = byte;
+                    *cmd |= 0x10 << i;
+                }
+            }
+        }
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static uint32_t block_hash(const unsigned char* p) {
+    uint32_t h = 0;
+    for (int i = 0; i < DELTA_BLOCK; i++) h = h * DELTA_HASH_MULT + p[i];
+    return h;
+}
+
+// Emit instructions for target against the indexed base
+static int encode_target(delta_out_t* out, const uint32_t* table, size_t table_size,
+                         const unsigned char* base, size_t base_size,
+                         const unsigned char* target, size_t target_size) {
+    // Weight of the byte leaving the window: MULT^(BLOCK-1)
+    uint32_t out_weight = 1;
+    for (int i = 1; i < DELTA_BLOCK; i++) out_weight *= DELTA_HASH_MULT;
+
+    size_t literal = 0;   // Start of bytes not yet emitted
+    size_t i = 0;
+    uint32_t h = block_hash(target);
+    while (i + DELTA_BLOCK <= target_size) {
+        uint32_t slot = table[h & (table_size - 1)];
+        if (slot && memcmp(base + slot - 1, target + i, DELTA_BLOCK) == 0) {
+            size_t src = slot - 1;
+            size_t len = DELTA_BLOCK;
+            while (i + len < target_size && src + len < base_size && base[src + len] == target[i + len]) {
+                len++;
+            }
+            // Grow the match backwards over bytes still waiting as literals
+            while (i > literal && src > 0 && base[src - 1] == target[i - 1]) {
+                i--;
+                src--;
+                len++;
+            }
+            if (out_insert(out, target + literal, i - literal) != 0 || out_copy(out, src, len) != 0) {
+                return -1;
+            }
+            i += len;
+            literal = i;
+            if (i + DELTA_BLOCK <= target_size) h = block_hash(target + i);
+            continue;
+        }
+        if (i + DELTA_BLOCK < target_size) {
+            h = (h - target[i] * out_weight) * DELTA_HASH_MULT + target[i + DELTA_BLOCK];
+        }
+        i++;
+    }
+    return out_insert(out, target + literal, target_size - literal);
+}
+
+unsigned char* git_delta_create(const unsigned char* base, size_t base_size,
+                                const unsigned char* target, size_t target_size,
+                                size_t max_size, size_t* delta_size) {
+    if (base_size < DELTA_BLOCK || target_size < DELTA_BLOCK || base_size > DELTA_MAX_BASE) {
+        return NULL;
+    }
+
+    // Index every aligned block of the base; later blocks win collisions
+    size_t blocks = base_size / DELTA_BLOCK;
+    size_t table_size = 1;
+    while (table_size < blocks * 2) table_size <<= 1;
+    uint32_t* table = calloc(table_size, sizeof(uint32_t));  // offset + 1
+    if (!table) return NULL;
+    for (size_t b = 0; b < blocks; b++) {
+        uint32_t h = block_hash(base + b * DELTA_BLOCK);
+        table[h & (table_size - 1)] = (uint32_t)(b * DELTA_BLOCK + 1);
+    }
+
+    delta_out_t out = { malloc(4096), 0, 4096, max_size };
+    int result = -1;
+    if (out.data && out_varint(&out, base_size) == 0 && out_varint(&out, target_size) == 0) {
+        result = encode_target(&out, table, table_size, base, base_size, target, target_size);
+    }
+    free(table);
+
+    if (result != 0) {
+        free(out.data);
+        return NULL;
+    }
+    *delta_size = out.len;
+    return out.data;
+}
+
+// Read a delta header varint; 0 past the end
+static size_t read_varint(const unsigned char** p, const unsigned char* end) {
+    size_t value = 0;
+    int shift = 0;
+    while (*p < end && shift < 64) {
+        unsigned char byte = *(*p)++;
+        value |= (size_t)(byte & 0x7f) << shift;
+        shift += 7;
+        if (!(byte & 0x80)) return value;
+    }
+    *p = end;
+    return 0;
+}
+
+unsigned char* git_delta_apply(const unsigned char* base, size_t base_size,
+                               const unsigned char* delta, size_t delta_size,
+                               size_t* result_size) {
+    const unsigned char* p = delta;
+    const unsigned char* end = delta + delta_size;
+    if (read_varint(&p, end) != base_size) return NULL;
+    size_t size = read_varint(&p, end);
+    if (p >= end && size > 0) return NULL;
+
+    unsigned char* out = malloc(size + 1);
+    if (!out) return NULL;
+    size_t len = 0;
+
+    while (p < end) {
+        unsigned char cmd = *p++;
+        if (cmd & 0x80) {
+            size_t offset = 0, n = 0;
+            for (int i = 0; i < 4; i++) {
+                if ((cmd & (1 << i)) && p < end) offset |= (size_t)*p++ << (i * 8);
+            }
+            for (int i = 0; i < 3; i++) {
+                if ((cmd & (0x10 << i)) && p < end) n |= (size_t)*p++ << (i * 8);
+            }
+            if (n == 0) n = DELTA_MAX_COPY;
+            if (offset > base_size || n > base_size - offset || n > size - len) break;
+            memcpy(out + len, base + offset, n);
+            len += n;
+        } else if (cmd) {
+            if (cmd > (size_t)(end - p) || cmd > size - len) break;
+            memcpy(out + len, p, cmd);
+            p += cmd;
+            len += cmd;
+        } else {
+            break;  // Reserved opcode
+        }
+    }
+
+    if (p != end || len != size) {
+        free(out);
+        return NULL;
+    }
+    out[size] = '\0';
+    *result_size = size;
+    return out;
+}
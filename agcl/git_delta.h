@@ -0,0 +1,24 @@
+#ifndef GIT_DELTA_H
+#define GIT_DELTA_H
+
+#include <stddef.h>
+
+// Git delta encoding (the payload of OFS_DELTA/REF_DELTA pack entries):
+// varint base size, varint result size, then copy-from-base and insert
+// instructions. Matches are found with a rolling hash over 16-byte blocks
+// of the base, so encoding is linear in base plus target size.
+
+// Encode target against base. Returns a malloc'ed delta and its size, or
+// NULL if the delta would exceed max_size (or on allocation failure).
+unsigned char* git_delta_create(const unsigned char* base, size_t base_size,
+                                const unsigned char* target, size_t target_size,
+                                size_t max_size, size_t* delta_size);
+
+// Rebuild a target from base and delta. Returns a malloc'ed buffer (with a
+// NUL past the end) and its size, or NULL if the delta is malformed or was
+// made against a base of another size.
+unsigned char* git_delta_apply(const unsigned char* base, size_t base_size,
+                               const unsigned char* delta, size_t delta_size,
+                               size_t* result_size);
+
+#endif // GIT_DELTA_H
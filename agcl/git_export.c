@@ -0,0 +1,1122 @@
+#define _XOPEN_SOURCE 700   /* for strptime */
+#define _GNU_SOURCE
+#include "git_export.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "git_lfs.h"
+#include "git_object.h"
+#include "objects.h"
+#include "thread_pool.h"
+
+// Trees built per parallel pass, and blobs read per pass
+#define EXPORT_BATCH 4096
+#define EXPORT_BLOB_BATCH 256
+// Larger blobs are read again when packed instead of being kept meanwhile
+#define EXPORT_KEEP_MAX (1024 * 1024)
+
+#define EXPORT_NONE UINT32_MAX
+#define AVC_MODE_TREE 040000
+
+// Delta candidates for packed blobs beyond the parent's version: blobs
+// recently packed under the same file name (catches moves and copies)
+#define RECENT_NAME_BUCKETS 4096
+
+enum { EXPORT_COMMIT, EXPORT_TREE, EXPORT_BLOB };
+enum { EXPORT_PENDING, EXPORT_DONE, EXPORT_FAILED };
+
+typedef struct {
+    avc_oid_t avc_oid;
+    avc_oid_t base;            // Same path in the parent commit; commits: their tree
+    uint8_t git_id[GIT_OID_RAWSZ];
+    uint8_t kind;
+    uint8_t state;
+    uint8_t has_base;
+    uint8_t base_trusted;      // Trees: base and all below it are known to be in .git
+    uint8_t lfs;               // Blobs: exported as an LFS pointer
+    uint8_t mark;              // Queued for reading, or topological sort state
+    int32_t height;            // Trees: 0 without unconverted subtrees
+    uint32_t first;            // Earliest commit reaching it, in conversion order
+    uint32_t name_hash;        // Blobs: file name, for delta candidates
+    uint32_t tree;             // Commits: root tree
+    uint32_t* children;        // Trees: per entry; commits: parents
+    uint32_t child_count;
+    char* content;             // Commits: the AVC commit; blobs and trees: the Git content for the pack
+    size_t size;
+} export_object_t;
+
+typedef struct {
+    uint32_t name_hash;
+    git_pack_base_t base;
+} recent_blob_t;
+
+typedef struct {
+    export_object_t* objects;
+    size_t count;
+    size_t capacity;
+    uint32_t* slots;           // Open addressing over objects, index + 1
+    size_t slot_mask;
+    hash_map_t* map;
+    git_pack_writer_t* pack;
+    recent_blob_t* recent;     // RECENT_NAME_BUCKETS x window, newest first
+    int window;
+    git_lfs_policy_t lfs;
+    int lfs_enabled;
+} export_t;
+
+// A tree entry as read in parallel, before it is linked to its object
+typedef struct {
+    avc_oid_t oid;
+    avc_oid_t base;
+    uint8_t git_id[GIT_OID_RAWSZ];
+    uint8_t kind;
+    uint8_t done;              // Converted by an earlier sync: git_id is valid
+    uint8_t has_base;
+    uint8_t base_trusted;
+    uint8_t shared;            // Same as in the base tree, which resolves it
+    uint8_t lfs;               // File name matches the LFS patterns
+    uint32_t name_hash;
+} export_link_t;
+
+typedef struct {
+    export_t* exp;
+    const uint32_t* items;
+    export_link_t** links;     // Tree reads: entries per item
+    size_t* link_counts;
+} export_job_t;
+
+// One "mode name hash" line of an AVC tree
+typedef struct {
+    unsigned int mode;
+    char path[256];            // As stored
+    size_t name;               // Offset of the Git entry name ("./" dropped)
+    avc_oid_t oid;
+} tree_line_t;
+
+static uint32_t find_object(const export_t* exp, const avc_oid_t* oid) {
+    if (!exp->slots) return EXPORT_NONE;
+    for (size_t slot = oid_hash(oid) & exp->slot_mask; exp->slots[slot]; slot = (slot + 1) & exp->slot_mask) {
+        uint32_t index = exp->slots[slot] - 1;
+        if (oid_equal(&exp->objects[index].avc_oid, oid)) return index;
+    }
+    return EXPORT_NONE;
+}
+
+static int grow_slots(export_t* exp) {
+    size_t size = exp->slot_mask ? (exp->slot_mask + 1) * 2 : 1 << 12;
+    uint32_t* slots = calloc(size, sizeof(uint32_t));
+    if (!slots) return -1;
+    free(exp->slots);
+    exp->slots = slots;
+    exp->slot_mask = size - 1;
+    for (size_t i = 0; i < exp->count; i++) {
+        size_t slot = oid_hash(&exp->objects[i].avc_oid) & exp->slot_mask;
+        while (slots[slot]) slot = (slot + 1) & exp->slot_mask;
+        slots[slot] = (uint32_t)i + 1;
+    }
+    return 0;
+}
+
+// Index of the object, added if new; EXPORT_NONE on allocation failure
+static uint32_t add_object(export_t* exp, const avc_oid_t* oid, int kind) {
+    uint32_t index = find_object(exp, oid);
+    if (index != EXPORT_NONE) return index;
+
+    if (exp->count >= EXPORT_NONE - 1) return EXPORT_NONE;
+    if ((exp->count + 1) * 2 > exp->slot_mask + 1 && grow_slots(exp) != 0) return EXPORT_NONE;
+    if (exp->count == exp->capacity) {
+        size_t capacity = exp->capacity ? exp->capacity * 2 : 1 << 12;
+        export_object_t* grown = realloc(exp->objects, capacity * sizeof(export_object_t));
+        if (!grown) return EXPORT_NONE;
+        exp->objects = grown;
+        exp->capacity = capacity;
+    }
+
+    index = (uint32_t)exp->count++;
+    export_object_t* obj = &exp->objects[index];
+    memset(obj, 0, sizeof(*obj));
+    obj->avc_oid = *oid;
+    obj->kind = (uint8_t)kind;
+    obj->height = -1;
+    obj->first = EXPORT_NONE;
+    obj->tree = EXPORT_NONE;
+
+    size_t slot = oid_hash(oid) & exp->slot_mask;
+    while (exp->slots[slot]) slot = (slot + 1) & exp->slot_mask;
+    exp->slots[slot] = index + 1;
+    return index;
+}
+
+static int push_item(uint32_t** items, size_t* count, size_t* cap, uint32_t index) {
+    if (*count == *cap) {
+        size_t grown_cap = *cap ? *cap * 2 : 1024;
+        uint32_t* grown = realloc(*items, grown_cap * sizeof(uint32_t));
+        if (!grown) return -1;
+        *items = grown;
+        *cap = grown_cap;
+    }
+    (*items)[(*count)++] = index;
+    return 0;
+}
+
+// Loose, packed, or already in the pack being written
+static int git_exists(const export_t* exp, const uint8_t git_id[GIT_OID_RAWSZ]) {
+    char hex[GIT_OID_HEXSZ + 1], path[64];
+    hex_encode(git_id, GIT_OID_RAWSZ, hex);
+    snprintf(path, sizeof(path), ".git/objects/%.2s/%s", hex, hex + 2);
+    return access(path, F_OK) == 0 || git_pack_writer_has(exp->pack, git_id) || git_pack_has_object(git_id);
+}
+
+// Converted by an earlier sync: mapped, and the Git object is still there
+static int is_converted(const export_t* exp, const avc_oid_t* oid, uint8_t git_id_out[GIT_OID_RAWSZ]) {
+    const uint8_t* git_id = hash_map_get(exp->map, oid);
+    if (!git_id) return 0;
+    memcpy(git_id_out, git_id, GIT_OID_RAWSZ);
+    return git_exists(exp, git_id_out);
+}
+
+// Mark an object converted and add its pair to the map
+static int record_converted(export_t* exp, export_object_t* obj) {
+    obj->state = EXPORT_DONE;
+    return hash_map_set(exp->map, &obj->avc_oid, obj->git_id);
+}
+
+static uint32_t name_hash(const char* name) {
+    uint32_t h = 2166136261u;
+    for (const char* p = name; *p; p++) h = (h ^ (unsigned char)*p) * 16777619u;
+    return h ? h : 1;
+}
+
+static void remember_packed_blob(export_t* exp, const export_object_t* blob) {
+    if (!exp->recent) return;
+    recent_blob_t* ring = &exp->recent[(blob->name_hash % RECENT_NAME_BUCKETS) * exp->window];
+    memmove(ring + 1, ring, (exp->window - 1) * sizeof(recent_blob_t));
+    ring[0].name_hash = blob->name_hash;
+    ring[0].base.avc_oid = blob->avc_oid;
+    memcpy(ring[0].base.git_id, blob->git_id, GIT_OID_RAWSZ);
+}
+
+// The same path in the parent commit first, then recent blobs of that name.
+// LFS pointers are not deltified, and their AVC content is not what Git has.
+static size_t collect_delta_bases(export_t* exp, const export_object_t* blob, git_pack_base_t* bases) {
+    size_t count = 0;
+    const uint8_t* git_id = exp->window > 0 && blob->has_base ? hash_map_get(exp->map, &blob->base) : NULL;
+    if (git_id) {
+        uint32_t base = find_object(exp, &blob->base);
+        if (base != EXPORT_NONE && exp->objects[base].lfs) git_id = NULL;
+    }
+    if (git_id) {
+        bases[0].avc_oid = blob->base;
+        memcpy(bases[0].git_id, git_id, GIT_OID_RAWSZ);
+        count = 1;
+    }
+    if (exp->recent) {
+        const recent_blob_t* ring = &exp->recent[(blob->name_hash % RECENT_NAME_BUCKETS) * exp->window];
+        for (int i = 0; i < exp->window && count < GIT_PACK_MAX_WINDOW; i++) {
+            if (ring[i].name_hash == blob->name_hash) bases[count++] = ring[i].base;
+        }
+    }
+    return count;
+}
+
+typedef struct {
+    const char* name;
+    size_t line;
+} line_name_t;
+
+static int compare_line_names(const void* a, const void* b) {
+    const line_name_t* x = a;
+    const line_name_t* y = b;
+    int cmp = strcmp(x->name, y->name);
+    if (cmp != 0) return cmp;
+    return x->line < y->line ? -1 : x->line > y->line;
+}
+
+// Entries of an AVC tree in stored order. A repeated name keeps its first
+// entry; malformed lines are skipped. NULL on error.
+static tree_line_t* parse_tree_lines(char* content, size_t* count_out) {
+    size_t capacity = 16, count = 0;
+    tree_line_t* lines = malloc(capacity * sizeof(tree_line_t));
+    char* line = content;
+    char* end;
+    while (lines && *line) {
+        end = strchr(line, '\n');
+        if (end) *end = '\0';
+
+        tree_line_t entry;
+        char hex[AVC_OID_HEXSZ + 1];
+        if (sscanf(line, "%o %255s %64s", &entry.mode, entry.path, hex) == 3 &&
+            oid_from_hex(hex, &entry.oid) == 0) {
+            entry.name = strncmp(entry.path, "./", 2) == 0 ? 2 : 0;
+            if (count == capacity) {
+                capacity *= 2;
+                tree_line_t* grown = realloc(lines, capacity * sizeof(tree_line_t));
+                if (!grown) {
+                    free(lines);
+                    return NULL;
+                }
+                lines = grown;
+            }
+            lines[count++] = entry;
+        }
+        if (!end) break;
+        line = end + 1;
+    }
+    if (!lines) return NULL;
+
+    // Drop repeated names (should not happen with hierarchical trees)
+    line_name_t* names = malloc((count + 1) * sizeof(line_name_t));
+    if (!names) {
+        free(lines);
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) names[i] = (line_name_t){lines[i].path + lines[i].name, i};
+    qsort(names, count, sizeof(line_name_t), compare_line_names);
+    int repeated = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (strcmp(names[i].name, names[i - 1].name) == 0) {
+            lines[names[i].line].mode = UINT32_MAX;
+            repeated = 1;
+        }
+    }
+    free(names);
+    if (repeated) {
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (lines[i].mode != UINT32_MAX) lines[kept++] = lines[i];
+        }
+        count = kept;
+    }
+    *count_out = count;
+    return lines;
+}
+
+static tree_line_t* load_tree_lines(const avc_oid_t* oid, size_t* count_out) {
+    size_t size;
+    char type[16];
+    char* content = load_object(oid, &size, type);
+    tree_line_t* lines = NULL;
+    if (content && strcmp(type, "tree") == 0) lines = parse_tree_lines(content, count_out);
+    free(content);
+    return lines;
+}
+
+static int compare_line_paths(const void* a, const void* b) {
+    return strcmp(((const tree_line_t*)a)->path, ((const tree_line_t*)b)->path);
+}
+
+static void read_commit(void* ctx, size_t i) {
+    export_job_t* job = ctx;
+    export_object_t* obj = &job->exp->objects[job->items[i]];
+    if (obj->state == EXPORT_DONE) return;
+    if (is_converted(job->exp, &obj->avc_oid, obj->git_id)) {
+        obj->state = EXPORT_DONE;
+        return;
+    }
+    char type[16];
+    obj->content = load_object(&obj->avc_oid, &obj->size, type);
+    if (!obj->content || strcmp(type, "commit") != 0) {
+        free(obj->content);
+        obj->content = NULL;
+        obj->state = EXPORT_FAILED;
+    }
+}
+
+// Tree and parents of a commit, from its headers; new parents are queued
+static int link_commit(export_t* exp, uint32_t index, uint32_t** next, size_t* count, size_t* cap) {
+    export_object_t* obj = &exp->objects[index];
+    size_t lines = 1;
+    for (const char* p = obj->content; (p = strchr(p, '\n')); p++) lines++;
+    obj->children = malloc(lines * sizeof(uint32_t));
+    if (!obj->children) return -1;
+
+    int has_tree = 0;
+    const char* line = obj->content;
+    while (*line && *line != '\n') {
+        char hex[AVC_OID_HEXSZ + 1];
+        avc_oid_t oid;
+        if (strncmp(line, "tree ", 5) == 0 && sscanf(line, "tree %64s", hex) == 1) {
+            if (oid_from_hex(hex, &obj->base) != 0) {
+                printf("Failed to convert tree %s\n", hex);
+                return -1;
+            }
+            has_tree = 1;
+        } else if (strncmp(line, "parent ", 7) == 0 && sscanf(line, "parent %64s", hex) == 1) {
+            if (oid_from_hex(hex, &oid) != 0) {
+                printf("Failed to convert parent commit %s\n", hex);
+                return -1;
+            }
+            uint32_t parent = add_object(exp, &oid, EXPORT_COMMIT);
+            if (parent == EXPORT_NONE) return -1;
+            obj = &exp->objects[index];
+            obj->children[obj->child_count++] = parent;
+            export_object_t* p = &exp->objects[parent];
+            if (!p->mark) {
+                p->mark = 1;
+                if (push_item(next, count, cap, parent) != 0) return -1;
+            }
+        }
+        line = strchr(line, '\n');
+        if (!line) break;
+        line++;
+    }
+    return has_tree ? 0 : -1;
+}
+
+// Breadth-first from the head down to commits an earlier sync converted
+static int walk_commits(export_t* exp, uint32_t head) {
+    uint32_t* frontier = NULL;
+    size_t count = 0, cap = 0;
+    exp->objects[head].mark = 1;
+    if (push_item(&frontier, &count, &cap, head) != 0) return -1;
+
+    int result = 0;
+    while (count > 0 && result == 0) {
+        export_job_t job = {exp, frontier, NULL, NULL};
+        thread_pool_parallel_for(count, read_commit, &job);
+
+        uint32_t* next = NULL;
+        size_t next_count = 0, next_cap = 0;
+        for (size_t i = 0; i < count && result == 0; i++) {
+            export_object_t* obj = &exp->objects[frontier[i]];
+            if (obj->state == EXPORT_DONE) continue;
+            if (obj->state == EXPORT_FAILED || link_commit(exp, frontier[i], &next, &next_count, &next_cap) != 0) {
+                char hex[AVC_OID_HEXSZ + 1];
+                oid_to_hex(&exp->objects[frontier[i]].avc_oid, hex);
+                fprintf(stderr, "Failed to read AVC commit %s\n", hex);
+                result = -1;
+            }
+        }
+        free(frontier);
+        frontier = next;
+        count = next_count;
+    }
+    free(frontier);
+
+    for (size_t i = 0; i < exp->count; i++) exp->objects[i].mark = 0;
+    return result;
+}
+
+// Unconverted commits, parents before children. Parents are visited in
+// header order, so a first parent's history precedes the merged branch.
+static uint32_t* sort_commits(export_t* exp, uint32_t head, size_t* count_out) {
+    size_t total = 0;
+    for (size_t i = 0; i < exp->count; i++) {
+        if (exp->objects[i].kind == EXPORT_COMMIT && exp->objects[i].state == EXPORT_PENDING) total++;
+    }
+    uint32_t* order = malloc((total + 1) * sizeof(uint32_t));
+    size_t stack_cap = total + 1;
+    uint32_t* stack = malloc(stack_cap * sizeof(uint32_t));
+    if (!order || !stack) {
+        free(order);
+        free(stack);
+        return NULL;
+    }
+
+    size_t count = 0, depth = 0;
+    stack[depth++] = head;
+    while (depth > 0) {
+        export_object_t* obj = &exp->objects[stack[depth - 1]];
+        if (obj->state != EXPORT_PENDING || obj->mark == 2) {
+            depth--;
+        } else if (obj->mark == 1) {
+            obj->mark = 2;
+            order[count++] = stack[--depth];
+        } else {
+            obj->mark = 1;
+            for (uint32_t c = obj->child_count; c > 0; c--) {
+                uint32_t parent = obj->children[c - 1];
+                const export_object_t* p = &exp->objects[parent];
+                if (p->state != EXPORT_PENDING || p->mark) continue;
+                if (depth == stack_cap) {
+                    stack_cap *= 2;
+                    uint32_t* grown = realloc(stack, stack_cap * sizeof(uint32_t));
+                    if (!grown) {
+                        free(order);
+                        free(stack);
+                        return NULL;
+                    }
+                    stack = grown;
+                }
+                stack[depth++] = parent;
+            }
+        }
+    }
+    free(stack);
+    *count_out = count;
+    return order;
+}
+
+// Tree of a commit converted by an earlier sync, as the delta reference for its child
+static int read_commit_tree(const avc_oid_t* commit_oid, avc_oid_t* tree_out) {
+    size_t size;
+    char type[16];
+    char* content = load_object(commit_oid, &size, type);
+    char hex[AVC_OID_HEXSZ + 1];
+    int result = -1;
+    if (content && strcmp(type, "commit") == 0 && sscanf(content, "tree %64s", hex) == 1) {
+        result = oid_from_hex(hex, tree_out);
+    }
+    free(content);
+    return result;
+}
+
+static void read_tree(void* ctx, size_t i) {
+    export_job_t* job = ctx;
+    export_t* exp = job->exp;
+    export_object_t* obj = &exp->objects[job->items[i]];
+    if (is_converted(exp, &obj->avc_oid, obj->git_id)) {
+        obj->state = EXPORT_DONE;
+        return;
+    }
+
+    size_t count = 0;
+    tree_line_t* lines = load_tree_lines(&obj->avc_oid, &count);
+    export_link_t* links = lines ? malloc((count + 1) * sizeof(export_link_t)) : NULL;
+    if (!links) {
+        free(lines);
+        obj->state = EXPORT_FAILED;
+        return;
+    }
+
+    // What each path held in the parent commit. An entry that did not change
+    // is not looked up in .git: if the parent's tree is there, so is the
+    // entry; otherwise the parent's tree is converted too and resolves it.
+    // Changed entries get their old version as delta base.
+    size_t parent_count = 0;
+    tree_line_t* parent = obj->has_base ? load_tree_lines(&obj->base, &parent_count) : NULL;
+    if (parent) qsort(parent, parent_count, sizeof(tree_line_t), compare_line_paths);
+
+    for (size_t k = 0; k < count; k++) {
+        export_link_t* link = &links[k];
+        int is_tree = lines[k].mode == AVC_MODE_TREE;
+        link->oid = lines[k].oid;
+        link->kind = is_tree ? EXPORT_TREE : EXPORT_BLOB;
+        link->name_hash = name_hash(lines[k].path + lines[k].name);
+        link->lfs = !is_tree && exp->lfs_enabled && git_lfs_matches_name(&exp->lfs, lines[k].path + lines[k].name);
+        link->has_base = 0;
+        link->base_trusted = 0;
+        link->shared = 0;
+        link->done = 0;
+        const tree_line_t* old = parent ? bsearch(&lines[k], parent, parent_count, sizeof(tree_line_t),
+                                                  compare_line_paths) : NULL;
+        if (old && (old->mode == AVC_MODE_TREE) != is_tree) old = NULL;
+        if (old && oid_equal(&old->oid, &link->oid)) {
+            const uint8_t* git_id = obj->base_trusted ? hash_map_get(exp->map, &link->oid) : NULL;
+            if (git_id) {
+                memcpy(link->git_id, git_id, GIT_OID_RAWSZ);
+                link->done = 1;
+            } else {
+                link->shared = !obj->base_trusted;
+            }
+            continue;
+        }
+        if (old) {
+            link->base = old->oid;
+            link->has_base = 1;
+            link->base_trusted = obj->base_trusted;
+        }
+        link->done = (uint8_t)is_converted(exp, &link->oid, link->git_id);
+    }
+    free(parent);
+    free(lines);
+    job->links[i] = links;
+    job->link_counts[i] = count;
+}
+
+// Attach the entries read for a tree; new unconverted subtrees are queued.
+// An object reached from several commits takes its delta reference from
+// the earliest one.
+static int link_tree(export_t* exp, uint32_t index, const export_link_t* links, size_t count,
+                     uint32_t** next, size_t* next_count, size_t* next_cap) {
+    uint32_t* children = malloc((count + 1) * sizeof(uint32_t));
+    if (!children) return -1;
+    exp->objects[index].children = children;
+    exp->objects[index].child_count = (uint32_t)count;
+    uint32_t first = exp->objects[index].first;
+
+    for (size_t k = 0; k < count; k++) {
+        uint32_t child = add_object(exp, &links[k].oid, links[k].kind);
+        if (child == EXPORT_NONE) return -1;
+        children[k] = child;
+
+        export_object_t* c = &exp->objects[child];
+        c->lfs |= links[k].lfs;
+        if (c->first == EXPORT_NONE && links[k].done) {
+            memcpy(c->git_id, links[k].git_id, GIT_OID_RAWSZ);
+            c->state = EXPORT_DONE;
+        } else if (c->first == EXPORT_NONE && links[k].shared && is_converted(exp, &c->avc_oid, c->git_id)) {
+            // The base tree was converted before and did not list it here
+            c->state = EXPORT_DONE;
+        }
+        if (first < c->first) {
+            c->first = first;
+            c->base = links[k].base;
+            c->has_base = links[k].has_base;
+            c->base_trusted = links[k].base_trusted;
+            c->name_hash = links[k].name_hash;
+        }
+        if (c->kind == EXPORT_TREE && c->state == EXPORT_PENDING && !c->mark) {
+            c->mark = 1;
+            if (push_item(next, next_count, next_cap, child) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+// Breadth-first from the root trees of the commits being converted, down to
+// trees an earlier sync converted
+static int walk_trees(export_t* exp, const uint32_t* order, size_t order_count) {
+    uint32_t* frontier = NULL;
+    size_t count = 0, cap = 0;
+    for (size_t i = 0; i < order_count; i++) {
+        export_object_t* commit = &exp->objects[order[i]];
+        // Compared with the first parent's tree; a parent already in .git
+        // vouches for everything its tree reaches
+        avc_oid_t parent_tree;
+        int has_parent_tree = 0, parent_synced = 0;
+        if (commit->child_count > 0) {
+            const export_object_t* parent = &exp->objects[commit->children[0]];
+            if (parent->state == EXPORT_PENDING) {
+                parent_tree = parent->base;
+                has_parent_tree = 1;
+            } else {
+                has_parent_tree = read_commit_tree(&parent->avc_oid, &parent_tree) == 0;
+                parent_synced = has_parent_tree;
+            }
+        }
+
+        avc_oid_t tree_oid = commit->base;
+        uint32_t tree = add_object(exp, &tree_oid, EXPORT_TREE);
+        if (tree == EXPORT_NONE) {
+            free(frontier);
+            return -1;
+        }
+        exp->objects[order[i]].tree = tree;
+        export_object_t* t = &exp->objects[tree];
+        if (t->first == EXPORT_NONE) {
+            t->first = (uint32_t)i;
+            t->base = parent_tree;
+            t->has_base = (uint8_t)has_parent_tree;
+            t->base_trusted = (uint8_t)parent_synced;
+        }
+        if (!t->mark) {
+            t->mark = 1;
+            if (push_item(&frontier, &count, &cap, tree) != 0) {
+                free(frontier);
+                return -1;
+            }
+        }
+    }
+
+    int result = 0;
+    while (count > 0 && result == 0) {
+        export_link_t** links = calloc(count, sizeof(export_link_t*));
+        size_t* link_counts = calloc(count, sizeof(size_t));
+        uint32_t* next = NULL;
+        size_t next_count = 0, next_cap = 0;
+        if (!links || !link_counts) {
+            result = -1;
+        } else {
+            export_job_t job = {exp, frontier, links, link_counts};
+            thread_pool_parallel_for(count, read_tree, &job);
+            for (size_t i = 0; i < count; i++) {
+                if (result == 0 && exp->objects[frontier[i]].state == EXPORT_PENDING) {
+                    result = link_tree(exp, frontier[i], links[i], link_counts[i], &next, &next_count, &next_cap);
+                }
+                free(links[i]);
+            }
+        }
+        free(links);
+        free(link_counts);
+        free(frontier);
+        frontier = next;
+        count = next_count;
+    }
+    free(frontier);
+    return result;
+}
+
+static void report_object(const char* before, const export_object_t* obj, const char* after) {
+    char hex[AVC_OID_HEXSZ + 1];
+    oid_to_hex(&obj->avc_oid, hex);
+    printf("%s%s%s\n", before, hex, after);
+}
+
+// Read and hash a blob; loose objects are written here, packed ones later.
+// Blobs the LFS policy picks are replaced by their pointer file.
+static void hash_blob(void* ctx, size_t i) {
+    export_job_t* job = ctx;
+    export_t* exp = job->exp;
+    export_object_t* obj = &exp->objects[job->items[i]];
+    char type[16];
+    if (!obj->lfs && exp->lfs.threshold > 0) {
+        size_t size = 0;
+        obj->lfs = stream_object(&obj->avc_oid, type, &size, NULL, NULL) == 0 && size >= exp->lfs.threshold;
+    }
+    char* content;
+    if (obj->lfs) {
+        content = git_lfs_export_blob(&obj->avc_oid, &obj->size);
+        strcpy(type, "blob");
+    } else {
+        content = load_object(&obj->avc_oid, &obj->size, type);
+    }
+    if (!content) {
+        report_object("Warning: AVC blob ", obj, " not found");
+        obj->state = EXPORT_FAILED;
+        return;
+    }
+    if (strcmp(type, "blob") != 0) {
+        char hex[AVC_OID_HEXSZ + 1];
+        oid_to_hex(&obj->avc_oid, hex);
+        printf("Warning: Object %s is not a blob (type: %s)\n", hex, type);
+        free(content);
+        obj->state = EXPORT_FAILED;
+        return;
+    }
+
+    git_hash_object("blob", content, obj->size, obj->git_id);
+    if (!exp->pack) {
+        if (git_write_loose_object("blob", content, obj->size, obj->git_id) != 0) {
+            report_object("Failed to store Git blob for ", obj, "");
+            obj->state = EXPORT_FAILED;
+        }
+        free(content);
+    } else if (obj->size > EXPORT_KEEP_MAX) {
+        free(content);
+    } else {
+        obj->content = content;
+    }
+}
+
+// Hand a hashed blob to the pack writer, which takes its content
+static int pack_blob(export_t* exp, export_object_t* obj) {
+    char* content = obj->content;
+    obj->content = NULL;
+    if (git_exists(exp, obj->git_id)) {
+        free(content);
+        return 0;
+    }
+    if (obj->lfs) return git_pack_writer_queue(exp->pack, "blob", content, obj->size, obj->git_id);
+    if (!content) {
+        size_t size;
+        char type[16];
+        content = load_object(&obj->avc_oid, &size, type);
+        if (!content) return -1;
+    }
+    git_pack_base_t bases[GIT_PACK_MAX_WINDOW];
+    size_t base_count = collect_delta_bases(exp, obj, bases);
+    if (git_pack_writer_add_delta(exp->pack, content, obj->size, obj->git_id, bases, base_count) != 0) {
+        return -1;
+    }
+    remember_packed_blob(exp, obj);
+    return 0;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Leaves first, in the order of the commits that introduce them, so a
+// blob's previous version is already packed when it looks for a delta base
+static int convert_blobs(export_t* exp) {
+    size_t total = 0;
+    for (size_t i = 0; i < exp->count; i++) {
+        if (exp->objects[i].kind == EXPORT_BLOB && exp->objects[i].state == EXPORT_PENDING) total++;
+    }
+    if (total == 0) return 0;
+
+    uint64_t* keys = malloc(total * sizeof(uint64_t));
+    uint32_t* items = malloc(total * sizeof(uint32_t));
+    if (!keys || !items) {
+        free(keys);
+        free(items);
+        return -1;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < exp->count; i++) {
+        const export_object_t* obj = &exp->objects[i];
+        if (obj->kind == EXPORT_BLOB && obj->state == EXPORT_PENDING) keys[n++] = (uint64_t)obj->first << 32 | i;
+    }
+    qsort(keys, total, sizeof(uint64_t), compare_u64);
+    for (size_t i = 0; i < total; i++) items[i] = (uint32_t)keys[i];
+    free(keys);
+
+    int result = 0;
+    for (size_t start = 0; start < total && result == 0; start += EXPORT_BLOB_BATCH) {
+        size_t batch = total - start < EXPORT_BLOB_BATCH ? total - start : EXPORT_BLOB_BATCH;
+        export_job_t job = {exp, items + start, NULL, NULL};
+        thread_pool_parallel_for(batch, hash_blob, &job);
+
+        for (size_t i = start; i < start + batch; i++) {
+            export_object_t* obj = &exp->objects[items[i]];
+            if (result != 0 || obj->state == EXPORT_FAILED) {
+                free(obj->content);
+                obj->content = NULL;
+                continue;
+            }
+            if (exp->pack && pack_blob(exp, obj) != 0) {
+                report_object("Failed to store Git blob for ", obj, "");
+                obj->state = EXPORT_FAILED;
+                continue;
+            }
+            result = record_converted(exp, obj);
+        }
+    }
+    free(items);
+    return result;
+}
+
+static int32_t tree_height(export_t* exp, uint32_t index) {
+    export_object_t* obj = &exp->objects[index];
+    if (obj->height >= 0) return obj->height;
+    int32_t height = 0;
+    for (uint32_t e = 0; e < obj->child_count; e++) {
+        uint32_t child = obj->children[e];
+        const export_object_t* c = &exp->objects[child];
+        if (c->kind == EXPORT_TREE && c->state == EXPORT_PENDING) {
+            int32_t h = tree_height(exp, child) + 1;
+            if (h > height) height = h;
+        }
+    }
+    exp->objects[index].height = height;
+    return height;
+}
+
+typedef struct {
+    unsigned int mode;
+    const char* name;
+    const uint8_t* git_id;
+} git_entry_t;
+
+static int compare_git_entries(const void* a, const void* b) {
+    return strcmp(((const git_entry_t*)a)->name, ((const git_entry_t*)b)->name);
+}
+
+// Git tree from the converted entries (sorted by name); entries that failed
+// to convert are left out with a warning
+static void build_tree(void* ctx, size_t i) {
+    export_job_t* job = ctx;
+    export_t* exp = job->exp;
+    export_object_t* obj = &exp->objects[job->items[i]];
+    size_t count = 0;
+    tree_line_t* lines = load_tree_lines(&obj->avc_oid, &count);
+    git_entry_t* entries = lines ? malloc((count + 1) * sizeof(git_entry_t)) : NULL;
+    if (!entries || count != obj->child_count) {
+        free(lines);
+        free(entries);
+        obj->state = EXPORT_FAILED;
+        return;
+    }
+
+    size_t kept = 0, total_size = 0;
+    for (size_t k = 0; k < count; k++) {
+        const export_object_t* child = &exp->objects[obj->children[k]];
+        if (child->state != EXPORT_DONE) {
+            report_object(child->kind == EXPORT_TREE ? "Warning: Failed to convert sub-tree "
+                                                     : "Warning: Failed to convert blob ", child, ", skipping");
+            continue;
+        }
+        entries[kept] = (git_entry_t){git_canonical_mode(lines[k].mode), lines[k].path + lines[k].name,
+                                      child->git_id};
+        total_size += (size_t)snprintf(NULL, 0, "%o", entries[kept].mode) + 1 + strlen(entries[kept].name) + 1 + GIT_OID_RAWSZ;
+        kept++;
+    }
+    qsort(entries, kept, sizeof(git_entry_t), compare_git_entries);
+
+    // Format: "mode name\0" and the raw ID per entry
+    char* out = malloc(total_size + 1);
+    size_t len = 0;
+    for (size_t k = 0; out && k < kept; k++) {
+        len += (size_t)snprintf(out + len, total_size + 1 - len, "%o %s", entries[k].mode, entries[k].name);
+        out[len++] = '\0';
+        memcpy(out + len, entries[k].git_id, GIT_OID_RAWSZ);
+        len += GIT_OID_RAWSZ;
+    }
+    free(entries);
+    free(lines);
+    if (!out) {
+        obj->state = EXPORT_FAILED;
+        return;
+    }
+
+    git_hash_object("tree", out, len, obj->git_id);
+    if (!exp->pack) {
+        if (git_write_loose_object("tree", out, len, obj->git_id) != 0) obj->state = EXPORT_FAILED;
+        free(out);
+    } else {
+        obj->content = out;
+        obj->size = len;
+    }
+}
+
+// Subtrees first: every tree of one height only depends on lower ones
+static int convert_trees(export_t* exp) {
+    int32_t max_height = -1;
+    size_t total = 0;
+    for (size_t i = 0; i < exp->count; i++) {
+        if (exp->objects[i].kind != EXPORT_TREE || exp->objects[i].state != EXPORT_PENDING) continue;
+        int32_t h = tree_height(exp, (uint32_t)i);
+        if (h > max_height) max_height = h;
+        total++;
+    }
+    if (total == 0) return 0;
+
+    uint32_t* level = malloc(total * sizeof(uint32_t));
+    if (!level) return -1;
+    int result = 0;
+    for (int32_t h = 0; h <= max_height && result == 0; h++) {
+        size_t count = 0;
+        for (size_t i = 0; i < exp->count; i++) {
+            const export_object_t* obj = &exp->objects[i];
+            if (obj->kind == EXPORT_TREE && obj->state == EXPORT_PENDING && obj->height == h) {
+                level[count++] = (uint32_t)i;
+            }
+        }
+        for (size_t start = 0; start < count && result == 0; start += EXPORT_BATCH) {
+            size_t batch = count - start < EXPORT_BATCH ? count - start : EXPORT_BATCH;
+            export_job_t job = {exp, level + start, NULL, NULL};
+            thread_pool_parallel_for(batch, build_tree, &job);
+
+            for (size_t i = start; i < start + batch && result == 0; i++) {
+                export_object_t* obj = &exp->objects[level[i]];
+                if (obj->state == EXPORT_FAILED) continue;
+                if (obj->content) {
+                    char* content = obj->content;
+                    obj->content = NULL;
+                    if (git_exists(exp, obj->git_id)) {
+                        free(content);
+                    } else {
+                        result = git_pack_writer_queue(exp->pack, "tree", content, obj->size, obj->git_id);
+                    }
+                }
+                if (result == 0) result = record_converted(exp, obj);
+            }
+        }
+    }
+    free(level);
+    return result;
+}
+
+// Convert ISO 8601 datetime to epoch seconds (UTC)
+static long iso_to_epoch(const char *iso_str) {
+    struct tm tm = {0};
+
+    // Try multiple date formats
+    if (!strptime(iso_str, "%Y-%m-%d %H:%M:%S", &tm) &&
+        !strptime(iso_str, "%Y-%m-%d %H:%M", &tm) &&
+        !strptime(iso_str, "%Y-%m-%d", &tm)) {
+        // If all parsing fails, use current time
+        return time(NULL);
+    }
+    // Convert to epoch (try timegm for UTC, fall back to mktime which assumes local time)
+    #ifdef _GNU_SOURCE
+    return timegm(&tm);
+    #else
+    // For systems without timegm, mktime assumes local time, which is fine now
+    return mktime(&tm);
+    #endif
+}
+
+// "author"/"committer" line for Git: an email if missing, epoch date
+static size_t format_ident(char* out, size_t out_size, const char* key, const char* info) {
+    // Check if email is present
+    if (strchr(info, '@') == NULL) {
+        // Add default email if missing
+        return (size_t)snprintf(out, out_size, "%s %s <user@example.com>\n", key, info);
+    }
+    // Try to parse: "name <email> YYYY-MM-DD HH:MM:SS +0000"
+    char name[256], email[256], date_part[256];
+    if (sscanf(info, "%255[^<] <%255[^>]> %255s", name, email, date_part) == 3) {
+        // Remove trailing timezone from date_part if it ends with +0000
+        char* tz_pos = strrchr(date_part, '+');
+        if (tz_pos && strcmp(tz_pos, "+0000") == 0) {
+            *tz_pos = '\0';
+        }
+        long epoch = iso_to_epoch(date_part);
+        return (size_t)snprintf(out, out_size, "%s %s <%s> %ld +0000\n", key, name, email, epoch);
+    }
+    // Copy as-is if we can't parse it
+    return (size_t)snprintf(out, out_size, "%s %s\n", key, info);
+}
+
+// Git form of an AVC commit: converted tree and parents, epoch dates, and
+// the message as is. NULL if its tree or a parent was not converted.
+static char* format_commit(export_t* exp, export_object_t* obj, size_t* size_out) {
+    size_t cap = obj->size * 2 + 64;
+    char* out = malloc(cap);
+    char* headers = strdup(obj->content);
+    if (!out || !headers) {
+        free(out);
+        free(headers);
+        return NULL;
+    }
+    size_t len = 0;
+
+    // Find the empty line that separates headers from message
+    char* message_start = strstr(headers, "\n\n");
+    if (message_start) {
+        *message_start = '\0';
+        message_start = obj->content + (message_start - headers) + 2;
+    }
+
+    int failed = 0;
+    char* saveptr;
+    char git_hash[GIT_OID_HEXSZ + 1];
+    for (char* line = strtok_r(headers, "\n", &saveptr); line && !failed; line = strtok_r(NULL, "\n", &saveptr)) {
+        char hex[AVC_OID_HEXSZ + 1], info[512];
+        avc_oid_t oid;
+        if (strncmp(line, "tree ", 5) == 0 && sscanf(line, "tree %64s", hex) == 1) {
+            const export_object_t* tree = &exp->objects[obj->tree];
+            if (tree->state != EXPORT_DONE) {
+                printf("Failed to convert tree %s\n", hex);
+                failed = 1;
+            } else {
+                hex_encode(tree->git_id, GIT_OID_RAWSZ, git_hash);
+                len += (size_t)snprintf(out + len, cap - len, "tree %s\n", git_hash);
+            }
+        } else if (strncmp(line, "parent ", 7) == 0 && sscanf(line, "parent %64s", hex) == 1) {
+            uint32_t parent = oid_from_hex(hex, &oid) == 0 ? find_object(exp, &oid) : EXPORT_NONE;
+            if (parent == EXPORT_NONE || exp->objects[parent].state != EXPORT_DONE) {
+                printf("Failed to convert parent commit %s\n", hex);
+                failed = 1;
+            } else {
+                hex_encode(exp->objects[parent].git_id, GIT_OID_RAWSZ, git_hash);
+                len += (size_t)snprintf(out + len, cap - len, "parent %s\n", git_hash);
+            }
+        } else if (strncmp(line, "author ", 7) == 0 && sscanf(line, "author %511[^\n]", info) == 1) {
+            len += format_ident(out + len, cap - len, "author", info);
+        } else if (strncmp(line, "committer ", 10) == 0 && sscanf(line, "committer %511[^\n]", info) == 1) {
+            len += format_ident(out + len, cap - len, "committer", info);
+        }
+    }
+    free(headers);
+    if (failed) {
+        free(out);
+        return NULL;
+    }
+
+    len += (size_t)snprintf(out + len, cap - len, "\n");
+    if (message_start && *message_start) {
+        len += (size_t)snprintf(out + len, cap - len, "%s", message_start);
+    }
+    *size_out = len;
+    return out;
+}
+
+// Commits last and one at a time, parents before children
+static int convert_commits(export_t* exp, const uint32_t* order, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        export_object_t* obj = &exp->objects[order[i]];
+        size_t size;
+        char* content = format_commit(exp, obj, &size);
+        if (!content) return -1;
+        free(obj->content);
+        obj->content = NULL;
+
+        git_hash_object("commit", content, size, obj->git_id);
+        int result = 0;
+        if (!exp->pack) {
+            result = git_write_loose_object("commit", content, size, obj->git_id);
+            free(content);
+        } else if (git_exists(exp, obj->git_id)) {
+            free(content);
+        } else {
+            result = git_pack_writer_queue(exp->pack, "commit", content, size, obj->git_id);
+        }
+        if (result != 0 || record_converted(exp, obj) != 0) return -1;
+    }
+    return 0;
+}
+
+int git_export_commit(hash_map_t* map, git_pack_writer_t* pack, int delta_window,
+                      const git_export_mark_t* synced, const avc_oid_t* commit_oid,
+                      uint8_t git_id_out[GIT_OID_RAWSZ]) {
+    export_t exp;
+    memset(&exp, 0, sizeof(exp));
+    exp.map = map;
+    exp.pack = pack;
+    exp.lfs_enabled = git_lfs_policy_load(&exp.lfs);
+    if (pack && delta_window > 0) {
+        exp.recent = calloc((size_t)RECENT_NAME_BUCKETS * delta_window, sizeof(recent_blob_t));
+        if (exp.recent) exp.window = delta_window;
+    }
+
+    // The last synced commit ends the walk without being looked up
+    if (synced) {
+        uint32_t mark = add_object(&exp, &synced->avc_oid, EXPORT_COMMIT);
+        if (mark != EXPORT_NONE) {
+            memcpy(exp.objects[mark].git_id, synced->git_id, GIT_OID_RAWSZ);
+            exp.objects[mark].state = EXPORT_DONE;
+        }
+    }
+
+    uint32_t head = add_object(&exp, commit_oid, EXPORT_COMMIT);
+    int result = head == EXPORT_NONE ? -1 : walk_commits(&exp, head);
+
+    size_t count = 0;
+    uint32_t* order = NULL;
+    if (result == 0) {
+        order = sort_commits(&exp, head, &count);
+        if (!order) result = -1;
+    }
+    if (result == 0) result = walk_trees(&exp, order, count);
+    if (result == 0) result = convert_blobs(&exp);
+    if (result == 0) result = convert_trees(&exp);
+    if (result == 0) result = convert_commits(&exp, order, count);
+    if (result == 0) memcpy(git_id_out, exp.objects[head].git_id, GIT_OID_RAWSZ);
+
+    free(order);
+    for (size_t i = 0; i < exp.count; i++) {
+        free(exp.objects[i].children);
+        free(exp.objects[i].content);
+    }
+    free(exp.objects);
+    free(exp.slots);
+    free(exp.recent);
+    return result;
+}
+
+int git_export_load_mark(const char* branch, git_export_mark_t* mark_out) {
+    FILE* f = fopen(AGCL_SYNC_MARKS_PATH, "r");
+    if (!f) return -1;
+    char line[1024], name[512], avc_hex[AVC_OID_HEXSZ + 1], git_hex[GIT_OID_HEXSZ + 1];
+    int result = -1;
+    while (result != 0 && fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%511s %64s %40s", name, avc_hex, git_hex) == 3 && strcmp(name, branch) == 0 &&
+            oid_from_hex(avc_hex, &mark_out->avc_oid) == 0 &&
+            hex_decode(git_hex, mark_out->git_id, GIT_OID_RAWSZ) == 0) {
+            result = 0;
+        }
+    }
+    fclose(f);
+    return result;
+}
+
+int git_export_save_mark(const char* branch, const git_export_mark_t* mark) {
+    char tmp_path[64];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.%d", AGCL_SYNC_MARKS_PATH, (int)getpid());
+    FILE* out = fopen(tmp_path, "w");
+    if (!out) return -1;
+
+    // Other branches keep their lines
+    FILE* in = fopen(AGCL_SYNC_MARKS_PATH, "r");
+    char line[1024], name[512];
+    while (in && fgets(line, sizeof(line), in)) {
+        if (sscanf(line, "%511s", name) == 1 && strcmp(name, branch) != 0) fputs(line, out);
+    }
+    if (in) fclose(in);
+
+    char avc_hex[AVC_OID_HEXSZ + 1], git_hex[GIT_OID_HEXSZ + 1];
+    oid_to_hex(&mark->avc_oid, avc_hex);
+    hex_encode(mark->git_id, GIT_OID_RAWSZ, git_hex);
+    fprintf(out, "%s %s %s\n", branch, avc_hex, git_hex);
+    if (fclose(out) != 0 || rename(tmp_path, AGCL_SYNC_MARKS_PATH) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef GIT_EXPORT_H
+#define GIT_EXPORT_H
+
+#include <stdint.h>
+#include "fast_agcl.h"
+#include "git_pack.h"
+
+// AVC -> Git conversion for sync-to-git, run as a dependency-ordered task
+// graph. Commits missing from .git/avc-map are collected from the head down,
+// then the trees they reach breadth-first with each frontier read in
+// parallel. Blobs are the leaves and are hashed and compressed on every
+// core; trees are built one height level at a time once their entries are
+// done, and commits last, parents first. Objects already in the map and in
+// .git are reused without being read. A tree entry equal to the same path
+// in the parent commit, whose tree is already in .git, is taken from the
+// map without looking for it in .git.
+
+// A commit converted by an earlier sync: the last one of a branch
+typedef struct {
+    avc_oid_t avc_oid;
+    uint8_t git_id[GIT_OID_RAWSZ];
+} git_export_mark_t;
+
+// Per-branch watermarks, one "<branch ref> <avc_hash> <git_hash>" line each
+#define AGCL_SYNC_MARKS_PATH ".git/avc-synced"
+
+// The watermark of an AVC branch (e.g. "refs/heads/main"); 0 if found
+int git_export_load_mark(const char* branch, git_export_mark_t* mark_out);
+
+// Record the watermark of a branch, replacing its previous one
+int git_export_save_mark(const char* branch, const git_export_mark_t* mark);
+
+// Convert a commit and everything it reaches that .git lacks. New objects
+// go into pack (loose objects if pack is NULL); a blob may become a delta
+// against the same path in the parent commit or one of the last
+// delta_window blobs packed under its name. synced, if not NULL, is a
+// commit known to be in .git with its whole history: the walk stops there
+// without checking. Every converted pair is added to map. -1 on error.
+int git_export_commit(hash_map_t* map, git_pack_writer_t* pack, int delta_window,
+                      const git_export_mark_t* synced, const avc_oid_t* commit_oid,
+                      uint8_t git_id_out[GIT_OID_RAWSZ]);
+
+#endif // GIT_EXPORT_H
@@ -0,0 +1,806 @@
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+#include "git_import.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "fast_agcl.h"
+#include "git_lfs.h"
+#include "git_object.h"
+#include "objects.h"
+#include "thread_pool.h"
+
+// Converted objects between two appends to .git/avc-map
+#define IMPORT_BATCH 4096
+
+#define IMPORT_NONE UINT32_MAX
+#define GIT_MODE_TREE 040000
+#define GIT_MODE_GITLINK 0160000
+
+enum { IMPORT_COMMIT, IMPORT_TREE, IMPORT_BLOB, IMPORT_MAPPED };
+
+typedef struct {
+    uint8_t git_id[GIT_OID_RAWSZ];
+    avc_oid_t avc_oid;
+    uint8_t kind;
+    uint8_t done;              // avc_oid is valid
+    uint8_t mark;              // Topological sort state
+    int32_t height;            // Trees: 0 without unconverted subtrees
+    char* content;             // Commits: the Git commit, kept until converted
+    size_t size;
+    uint32_t* children;        // Trees: per entry (IMPORT_NONE for gitlinks); commits: tree, parents
+    uint32_t child_count;
+} import_object_t;
+
+typedef struct {
+    import_object_t* objects;
+    size_t count;
+    size_t capacity;
+    uint32_t* slots;           // Open addressing over objects, index + 1
+    size_t slot_mask;
+    hash_map_t* map;           // Pairs from earlier runs and sync-to-git
+    git_import_stats_t* stats;
+    git_lfs_policy_t lfs;      // Its store resolves LFS pointers
+    _Atomic size_t lfs_blobs;
+} import_t;
+
+typedef struct {
+    char name[256];
+    uint8_t git_id[GIT_OID_RAWSZ];
+} import_ref_t;
+
+typedef struct {
+    import_t* imp;
+    const uint32_t* items;
+    _Atomic int failed;
+    _Atomic size_t failed_item;
+} import_job_t;
+
+static uint64_t id_hash(const uint8_t id[GIT_OID_RAWSZ]) {
+    uint64_t h;
+    memcpy(&h, id, sizeof(h));
+    return h;
+}
+
+static uint32_t find_object(const import_t* imp, const uint8_t id[GIT_OID_RAWSZ]) {
+    for (size_t slot = id_hash(id) & imp->slot_mask; imp->slots[slot]; slot = (slot + 1) & imp->slot_mask) {
+        uint32_t index = imp->slots[slot] - 1;
+        if (memcmp(imp->objects[index].git_id, id, GIT_OID_RAWSZ) == 0) return index;
+    }
+    return IMPORT_NONE;
+}
+
+static int grow_slots(import_t* imp) {
+    size_t size = imp->slot_mask ? (imp->slot_mask + 1) * 2 : 1 << 16;
+    uint32_t* slots = calloc(size, sizeof(uint32_t));
+    if (!slots) return -1;
+    free(imp->slots);
+    imp->slots = slots;
+    imp->slot_mask = size - 1;
+    for (size_t i = 0; i < imp->count; i++) {
+        size_t slot = id_hash(imp->objects[i].git_id) & imp->slot_mask;
+        while (slots[slot]) slot = (slot + 1) & imp->slot_mask;
+        slots[slot] = (uint32_t)i + 1;
+    }
+    return 0;
+}
+
+// Index of the object, added if new; IMPORT_NONE on allocation failure.
+// Objects converted by earlier runs or by sync-to-git are reused as they are.
+static uint32_t add_object(import_t* imp, const uint8_t id[GIT_OID_RAWSZ], int kind) {
+    uint32_t index = find_object(imp, id);
+    if (index != IMPORT_NONE) return index;
+
+    if (imp->count >= IMPORT_NONE - 1) return IMPORT_NONE;
+    if ((imp->count + 1) * 2 > imp->slot_mask + 1 && grow_slots(imp) != 0) return IMPORT_NONE;
+    if (imp->count == imp->capacity) {
+        size_t capacity = imp->capacity ? imp->capacity * 2 : 1 << 15;
+        import_object_t* grown = realloc(imp->objects, capacity * sizeof(import_object_t));
+        if (!grown) return IMPORT_NONE;
+        imp->objects = grown;
+        imp->capacity = capacity;
+    }
+
+    index = (uint32_t)imp->count++;
+    import_object_t* obj = &imp->objects[index];
+    memset(obj, 0, sizeof(*obj));
+    memcpy(obj->git_id, id, GIT_OID_RAWSZ);
+    obj->kind = (uint8_t)kind;
+    obj->height = -1;
+    if (hash_map_get_avc(imp->map, id, &obj->avc_oid) == 0) {
+        obj->kind = IMPORT_MAPPED;
+        obj->done = 1;
+    }
+
+    size_t slot = id_hash(id) & imp->slot_mask;
+    while (imp->slots[slot]) slot = (slot + 1) & imp->slot_mask;
+    imp->slots[slot] = index + 1;
+    return index;
+}
+
+// Append the AVC -> Git pairs of converted objects to .git/avc-map
+static int record_converted(import_t* imp, const uint32_t* items, size_t count) {
+    avc_oid_t* avc_oids = malloc(count * sizeof(avc_oid_t));
+    uint8_t* git_ids = malloc(count * GIT_OID_RAWSZ);
+    int result = -1;
+    if (avc_oids && git_ids) {
+        for (size_t i = 0; i < count; i++) {
+            avc_oids[i] = imp->objects[items[i]].avc_oid;
+            memcpy(git_ids + i * GIT_OID_RAWSZ, imp->objects[items[i]].git_id, GIT_OID_RAWSZ);
+        }
+        result = hash_map_append_pairs(avc_oids, git_ids, count);
+    }
+    free(avc_oids);
+    free(git_ids);
+    return result;
+}
+
+static void job_fail(import_job_t* job, size_t i) {
+    atomic_store(&job->failed_item, i);
+    atomic_store(&job->failed, 1);
+}
+
+static void report_missing(const import_t* imp, uint32_t index, const char* what) {
+    char hex[GIT_OID_HEXSZ + 1];
+    hex_encode(imp->objects[index].git_id, GIT_OID_RAWSZ, hex);
+    fprintf(stderr, "Failed to %s Git object %s\n", what, hex);
+}
+
+// One "mode name\0id" tree entry; NULL if malformed
+static const char* next_tree_entry(const char* p, const char* end, unsigned int* mode,
+                                   const char** name, const uint8_t** id) {
+    *mode = 0;
+    while (p < end && *p >= '0' && *p <= '7') *mode = *mode * 8 + (unsigned int)(*p++ - '0');
+    if (p >= end || *p != ' ') return NULL;
+    *name = ++p;
+    const char* nul = memchr(p, '\0', (size_t)(end - p));
+    if (!nul || (size_t)(end - nul - 1) < GIT_OID_RAWSZ) return NULL;
+    *id = (const uint8_t*)nul + 1;
+    return nul + 1 + GIT_OID_RAWSZ;
+}
+
+static void read_frontier_object(void* ctx, size_t i) {
+    import_job_t* job = ctx;
+    import_object_t* obj = &job->imp->objects[job->items[i]];
+    char type[16];
+    obj->content = git_read_object(obj->git_id, &obj->size, type);
+    const char* expected = obj->kind == IMPORT_COMMIT ? "commit" : "tree";
+    if (!obj->content || strcmp(type, expected) != 0) job_fail(job, i);
+}
+
+// Record a reference from parent to id; new commits and trees join the next frontier
+static int link_child(import_t* imp, uint32_t parent, const uint8_t id[GIT_OID_RAWSZ], int kind,
+                      uint32_t** next, size_t* next_count, size_t* next_cap) {
+    uint32_t child = add_object(imp, id, kind);
+    if (child == IMPORT_NONE) return -1;
+    import_object_t* obj = &imp->objects[parent];
+    obj->children[obj->child_count++] = child;
+
+    import_object_t* c = &imp->objects[child];
+    if (c->kind == IMPORT_MAPPED) {
+        c->kind = (uint8_t)kind;
+        imp->stats->reused++;
+    }
+    if (c->done || c->mark || kind == IMPORT_BLOB) return 0;
+    c->mark = 1;
+    if (*next_count == *next_cap) {
+        size_t cap = *next_cap ? *next_cap * 2 : 1024;
+        uint32_t* grown = realloc(*next, cap * sizeof(uint32_t));
+        if (!grown) return -1;
+        *next = grown;
+        *next_cap = cap;
+    }
+    (*next)[(*next_count)++] = child;
+    return 0;
+}
+
+// Collect tree and parent references of a commit
+static int parse_commit_links(import_t* imp, uint32_t index, uint32_t** next, size_t* count, size_t* cap) {
+    import_object_t* obj = &imp->objects[index];
+    const char* p = obj->content;
+    const char* end = p + obj->size;
+    size_t lines = 0;
+    for (const char* q = p; q < end && (q = memchr(q, '\n', (size_t)(end - q))); q++) lines++;
+    obj->children = malloc((lines + 1) * sizeof(uint32_t));
+    if (!obj->children) return -1;
+
+    int has_tree = 0;
+    while (p < end && *p != '\n') {
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        uint8_t id[GIT_OID_RAWSZ];
+        if (!has_tree && eol - p == 5 + GIT_OID_HEXSZ && strncmp(p, "tree ", 5) == 0 &&
+            hex_decode(p + 5, id, GIT_OID_RAWSZ) == 0) {
+            if (link_child(imp, index, id, IMPORT_TREE, next, count, cap) != 0) return -1;
+            has_tree = 1;
+        } else if (has_tree && eol - p == 7 + GIT_OID_HEXSZ && strncmp(p, "parent ", 7) == 0 &&
+                   hex_decode(p + 7, id, GIT_OID_RAWSZ) == 0) {
+            if (link_child(imp, index, id, IMPORT_COMMIT, next, count, cap) != 0) return -1;
+        }
+        p = eol + 1;
+    }
+    return has_tree ? 0 : -1;
+}
+
+// Collect subtree and blob references; the tree is read again when converted
+static int parse_tree_links(import_t* imp, uint32_t index, uint32_t** next, size_t* count, size_t* cap) {
+    import_object_t* obj = &imp->objects[index];
+    char* content = obj->content;
+    const char* p = content;
+    const char* end = p + obj->size;
+    obj->content = NULL;
+
+    obj->children = malloc((obj->size / (GIT_OID_RAWSZ + 3) + 1) * sizeof(uint32_t));
+    int result = obj->children ? 0 : -1;
+    while (result == 0 && p < end) {
+        unsigned int mode;
+        const char* name;
+        const uint8_t* id;
+        p = next_tree_entry(p, end, &mode, &name, &id);
+        if (!p) {
+            result = -1;
+        } else if (mode == GIT_MODE_GITLINK) {
+            // Submodule commits live in another repository
+            obj = &imp->objects[index];
+            obj->children[obj->child_count++] = IMPORT_NONE;
+            imp->stats->gitlinks++;
+        } else {
+            int kind = mode == GIT_MODE_TREE ? IMPORT_TREE : IMPORT_BLOB;
+            result = link_child(imp, index, id, kind, next, count, cap);
+        }
+        obj = &imp->objects[index];
+    }
+    free(content);
+    return result;
+}
+
+// Breadth-first walk from the branch tips down to already converted objects
+static int walk_history(import_t* imp, const uint32_t* tips, size_t tip_count) {
+    uint32_t* frontier = NULL;
+    size_t count = 0, cap = 0;
+    for (size_t i = 0; i < tip_count; i++) {
+        import_object_t* tip = &imp->objects[tips[i]];
+        if (tip->done || tip->mark) continue;
+        tip->mark = 1;
+        if (count == cap) {
+            cap = cap ? cap * 2 : 64;
+            uint32_t* grown = realloc(frontier, cap * sizeof(uint32_t));
+            if (!grown) {
+                free(frontier);
+                return -1;
+            }
+            frontier = grown;
+        }
+        frontier[count++] = tips[i];
+    }
+
+    int result = 0;
+    while (count > 0 && result == 0) {
+        import_job_t job = {imp, frontier, 0, 0};
+        thread_pool_parallel_for(count, read_frontier_object, &job);
+        if (atomic_load(&job.failed)) {
+            report_missing(imp, frontier[atomic_load(&job.failed_item)], "read");
+            result = -1;
+        }
+
+        uint32_t* next = NULL;
+        size_t next_count = 0, next_cap = 0;
+        for (size_t i = 0; i < count && result == 0; i++) {
+            if (imp->objects[frontier[i]].kind == IMPORT_COMMIT) {
+                result = parse_commit_links(imp, frontier[i], &next, &next_count, &next_cap);
+            } else {
+                result = parse_tree_links(imp, frontier[i], &next, &next_count, &next_cap);
+            }
+            if (result != 0) report_missing(imp, frontier[i], "parse");
+        }
+        free(frontier);
+        frontier = next;
+        count = next_count;
+    }
+    free(frontier);
+
+    // The walk marked everything it queued; the commit sort reuses the mark
+    for (size_t i = 0; i < imp->count; i++) imp->objects[i].mark = 0;
+    return result;
+}
+
+static void convert_blob(void* ctx, size_t i) {
+    import_job_t* job = ctx;
+    import_object_t* obj = &job->imp->objects[job->items[i]];
+    size_t size;
+    char type[16];
+    char* content = git_read_object(obj->git_id, &size, type);
+    if (!content || strcmp(type, "blob") != 0) {
+        job_fail(job, i);
+        free(content);
+        return;
+    }
+
+    // An LFS pointer whose content is at hand becomes that content in AVC;
+    // sync-to-git maps it back to the pointer
+    char lfs_oid[GIT_LFS_OID_HEXSZ + 1], lfs_path[PATH_MAX];
+    uint64_t lfs_size;
+    int result;
+    if (git_lfs_parse_pointer(content, size, lfs_oid, &lfs_size) == 0 &&
+        git_lfs_fetch(&job->imp->lfs, lfs_oid, lfs_path, sizeof(lfs_path)) == 0) {
+        result = store_blob_from_file(lfs_path, &obj->avc_oid);
+        if (result == 0) atomic_fetch_add(&job->imp->lfs_blobs, 1);
+    } else {
+        result = store_object("blob", content, size, &obj->avc_oid);
+    }
+    free(content);
+    if (result != 0) job_fail(job, i);
+    else obj->done = 1;
+}
+
+typedef struct {
+    unsigned int mode;
+    const char* name;
+    const avc_oid_t* oid;
+} avc_entry_t;
+
+static int compare_avc_entries(const void* a, const void* b) {
+    return strcmp(((const avc_entry_t*)a)->name, ((const avc_entry_t*)b)->name);
+}
+
+// AVC tree: "mode name hash" lines sorted by name, as `avc commit` writes them
+static void convert_tree(void* ctx, size_t i) {
+    import_job_t* job = ctx;
+    import_t* imp = job->imp;
+    import_object_t* obj = &imp->objects[job->items[i]];
+    size_t size;
+    char type[16];
+    char* content = git_read_object(obj->git_id, &size, type);
+    avc_entry_t* entries = malloc((obj->child_count + 1) * sizeof(avc_entry_t));
+    char* out = malloc(size * 2 + obj->child_count * (AVC_OID_HEXSZ + 16) + 1);
+    if (!content || strcmp(type, "tree") != 0 || !entries || !out) {
+        free(content);
+        free(entries);
+        free(out);
+        job_fail(job, i);
+        return;
+    }
+
+    const char* p = content;
+    const char* end = content + size;
+    size_t count = 0;
+    int failed = 0;
+    for (uint32_t e = 0; e < obj->child_count && !failed; e++) {
+        unsigned int mode;
+        const char* name;
+        const uint8_t* id;
+        p = next_tree_entry(p, end, &mode, &name, &id);
+        if (!p) {
+            failed = 1;
+        } else if (obj->children[e] != IMPORT_NONE) {
+            const import_object_t* child = &imp->objects[obj->children[e]];
+            if (!child->done) failed = 1;
+            entries[count++] = (avc_entry_t){mode, name, &child->avc_oid};
+        }
+    }
+    qsort(entries, count, sizeof(avc_entry_t), compare_avc_entries);
+
+    size_t len = 0;
+    char hex[AVC_OID_HEXSZ + 1];
+    for (size_t e = 0; e < count && !failed; e++) {
+        oid_to_hex(entries[e].oid, hex);
+        len += (size_t)sprintf(out + len, "%o %s %s\n", entries[e].mode, entries[e].name, hex);
+    }
+    if (failed || store_object("tree", out, len, &obj->avc_oid) != 0) {
+        job_fail(job, i);
+    } else {
+        obj->done = 1;
+    }
+    free(content);
+    free(entries);
+    free(out);
+}
+
+// Run fn over items in IMPORT_BATCH slices, recording each slice in the map
+static int convert_in_batches(import_t* imp, const uint32_t* items, size_t count, thread_task_fn fn) {
+    for (size_t start = 0; start < count; start += IMPORT_BATCH) {
+        size_t n = count - start < IMPORT_BATCH ? count - start : IMPORT_BATCH;
+        import_job_t job = {imp, items + start, 0, 0};
+        thread_pool_parallel_for(n, fn, &job);
+        if (atomic_load(&job.failed)) {
+            report_missing(imp, items[start + atomic_load(&job.failed_item)], "convert");
+            return -1;
+        }
+        if (record_converted(imp, items + start, n) != 0) return -1;
+    }
+    return 0;
+}
+
+static int32_t tree_height(import_t* imp, uint32_t index) {
+    import_object_t* obj = &imp->objects[index];
+    if (obj->height >= 0) return obj->height;
+    int32_t height = 0;
+    for (uint32_t e = 0; e < obj->child_count; e++) {
+        uint32_t child = obj->children[e];
+        if (child == IMPORT_NONE) continue;
+        import_object_t* c = &imp->objects[child];
+        if (c->kind == IMPORT_TREE && !c->done) {
+            int32_t h = tree_height(imp, child) + 1;
+            if (h > height) height = h;
+        }
+    }
+    imp->objects[index].height = height;
+    return height;
+}
+
+// Subtrees first: every tree of one height only depends on lower ones
+static int convert_trees(import_t* imp) {
+    int32_t max_height = -1;
+    size_t total = 0;
+    for (size_t i = 0; i < imp->count; i++) {
+        if (imp->objects[i].kind != IMPORT_TREE || imp->objects[i].done) continue;
+        int32_t h = tree_height(imp, (uint32_t)i);
+        if (h > max_height) max_height = h;
+        total++;
+    }
+    if (total == 0) return 0;
+
+    uint32_t* level = malloc(total * sizeof(uint32_t));
+    if (!level) return -1;
+    int result = 0;
+    for (int32_t h = 0; h <= max_height && result == 0; h++) {
+        size_t count = 0;
+        for (size_t i = 0; i < imp->count; i++) {
+            const import_object_t* obj = &imp->objects[i];
+            if (obj->kind == IMPORT_TREE && !obj->done && obj->height == h) level[count++] = (uint32_t)i;
+        }
+        result = convert_in_batches(imp, level, count, convert_tree);
+    }
+    free(level);
+    imp->stats->trees = total;
+    return result;
+}
+
+// "Name <email> 1700000000 +0100" -> "Name <email> 2023-11-14 22:13:20 +0000"
+static int format_ident(char* out, size_t out_size, const char* ident, size_t len) {
+    const char* gt = NULL;
+    for (size_t i = len; i > 0; i--) {
+        if (ident[i - 1] == '>') {
+            gt = ident + i - 1;
+            break;
+        }
+    }
+    char* date_end;
+    long long epoch = gt ? strtoll(gt + 1, &date_end, 10) : 0;
+    struct tm tm;
+    time_t t = (time_t)epoch;
+    char date[32];
+    if (!gt || date_end == gt + 1 || !gmtime_r(&t, &tm) ||
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm) == 0) {
+        return snprintf(out, out_size, "%.*s", (int)len, ident);
+    }
+    return snprintf(out, out_size, "%.*s %s +0000", (int)(gt + 1 - ident), ident, date);
+}
+
+// Rebuild the commit in AVC form: converted tree and parents, UTC dates, and
+// the message as is. Signatures and other extra headers are left out.
+static int convert_commit(import_t* imp, uint32_t index) {
+    import_object_t* obj = &imp->objects[index];
+    const char* p = obj->content;
+    const char* end = p + obj->size;
+    size_t cap = obj->size + (obj->child_count + 2) * (AVC_OID_HEXSZ + 16) + 256;
+    char* out = malloc(cap);
+    if (!out) return -1;
+
+    size_t len = 0;
+    char hex[AVC_OID_HEXSZ + 1];
+    for (uint32_t c = 0; c < obj->child_count; c++) {
+        const import_object_t* child = &imp->objects[obj->children[c]];
+        if (!child->done) {
+            free(out);
+            return -1;
+        }
+        oid_to_hex(&child->avc_oid, hex);
+        len += (size_t)snprintf(out + len, cap - len, "%s %s\n", c == 0 ? "tree" : "parent", hex);
+    }
+
+    while (p < end && *p != '\n') {
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        if (strncmp(p, "author ", 7) == 0 || strncmp(p, "committer ", 10) == 0) {
+            size_t key = p[0] == 'a' ? 7 : 10;
+            len += (size_t)snprintf(out + len, cap - len, "%.*s", (int)key, p);
+            len += (size_t)format_ident(out + len, cap - len, p + key, (size_t)(eol - p - key));
+            out[len++] = '\n';
+        }
+        p = eol + 1;
+    }
+    out[len++] = '\n';
+    if (p < end) p++;
+    if (p < end) {
+        memcpy(out + len, p, (size_t)(end - p));
+        len += (size_t)(end - p);
+    }
+
+    int result = store_object("commit", out, len, &obj->avc_oid);
+    free(out);
+    if (result == 0) {
+        obj->done = 1;
+        free(obj->content);
+        obj->content = NULL;
+    }
+    return result;
+}
+
+// Unconverted commits, parents before children (iterative depth-first)
+static uint32_t* sort_commits(import_t* imp, const uint32_t* tips, size_t tip_count, size_t* count_out) {
+    size_t total = 0;
+    for (size_t i = 0; i < imp->count; i++) {
+        if (imp->objects[i].kind == IMPORT_COMMIT && !imp->objects[i].done) total++;
+    }
+    uint32_t* order = malloc((total + 1) * sizeof(uint32_t));
+    size_t stack_cap = total + tip_count + 1;
+    uint32_t* stack = malloc(stack_cap * sizeof(uint32_t));
+    if (!order || !stack) {
+        free(order);
+        free(stack);
+        return NULL;
+    }
+
+    size_t count = 0;
+    for (size_t t = 0; t < tip_count; t++) {
+        size_t depth = 0;
+        stack[depth++] = tips[t];
+        while (depth > 0) {
+            import_object_t* obj = &imp->objects[stack[depth - 1]];
+            if (obj->done || obj->mark == 2) {
+                depth--;
+            } else if (obj->mark == 1) {
+                obj->mark = 2;
+                order[count++] = stack[--depth];
+            } else {
+                obj->mark = 1;
+                uint32_t top = stack[depth - 1];
+                for (uint32_t c = 1; c < imp->objects[top].child_count; c++) {
+                    uint32_t parent = imp->objects[top].children[c];
+                    if (imp->objects[parent].done || imp->objects[parent].mark) continue;
+                    if (depth == stack_cap) {
+                        stack_cap *= 2;
+                        uint32_t* grown = realloc(stack, stack_cap * sizeof(uint32_t));
+                        if (!grown) {
+                            free(order);
+                            free(stack);
+                            return NULL;
+                        }
+                        stack = grown;
+                    }
+                    stack[depth++] = parent;
+                }
+            }
+        }
+    }
+    free(stack);
+    *count_out = count;
+    return order;
+}
+
+static int convert_commits(import_t* imp, const uint32_t* tips, size_t tip_count) {
+    size_t count;
+    uint32_t* order = sort_commits(imp, tips, tip_count, &count);
+    if (!order) return -1;
+
+    int result = 0;
+    size_t recorded = 0;
+    for (size_t i = 0; i < count && result == 0; i++) {
+        result = convert_commit(imp, order[i]);
+        if (result != 0) {
+            report_missing(imp, order[i], "convert");
+        } else if (i + 1 - recorded == IMPORT_BATCH || i + 1 == count) {
+            result = record_converted(imp, order + recorded, i + 1 - recorded);
+            recorded = i + 1;
+        }
+    }
+    free(order);
+    imp->stats->commits = count;
+    return result;
+}
+
+static int add_ref(import_ref_t** refs, size_t* count, const char* name, const char* hex) {
+    for (size_t i = 0; i < *count; i++) {
+        if (strcmp((*refs)[i].name, name) == 0) return 0;  // Loose refs win
+    }
+    uint8_t id[GIT_OID_RAWSZ];
+    if (strlen(name) >= sizeof((*refs)->name) || hex_decode(hex, id, GIT_OID_RAWSZ) != 0) return 0;
+    import_ref_t* grown = realloc(*refs, (*count + 1) * sizeof(import_ref_t));
+    if (!grown) return -1;
+    *refs = grown;
+    snprintf(grown[*count].name, sizeof(grown[*count].name), "%s", name);
+    memcpy(grown[*count].git_id, id, GIT_OID_RAWSZ);
+    (*count)++;
+    return 0;
+}
+
+// Loose branch refs, recursing into "feature/..." style directories
+static int read_loose_refs(const char* dir_path, const char* prefix, import_ref_t** refs, size_t* count) {
+    DIR* dir = opendir(dir_path);
+    if (!dir) return 0;
+    int result = 0;
+    struct dirent* e;
+    while (result == 0 && (e = readdir(dir))) {
+        if (e->d_name[0] == '.') continue;
+        char path[1024], name[512];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, e->d_name);
+        snprintf(name, sizeof(name), "%s%s", prefix, e->d_name);
+        struct stat st;
+        if (stat(path, &st) == -1) continue;
+        if (S_ISDIR(st.st_mode)) {
+            char sub[520];
+            snprintf(sub, sizeof(sub), "%s/", name);
+            result = read_loose_refs(path, sub, refs, count);
+            continue;
+        }
+        FILE* f = fopen(path, "r");
+        char hex[GIT_OID_HEXSZ + 2];
+        if (f && fgets(hex, sizeof(hex), f) && strlen(hex) >= GIT_OID_HEXSZ) {
+            hex[GIT_OID_HEXSZ] = '\0';
+            result = add_ref(refs, count, name, hex);
+        }
+        if (f) fclose(f);
+    }
+    closedir(dir);
+    return result;
+}
+
+static int read_branches(import_ref_t** refs, size_t* count) {
+    if (read_loose_refs(".git/refs/heads", "", refs, count) != 0) return -1;
+
+    FILE* f = fopen(".git/packed-refs", "r");
+    if (!f) return 0;
+    char line[1024];
+    int result = 0;
+    while (result == 0 && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (strlen(line) > GIT_OID_HEXSZ + 12 && strncmp(line + GIT_OID_HEXSZ, " refs/heads/", 12) == 0) {
+            line[GIT_OID_HEXSZ] = '\0';
+            result = add_ref(refs, count, line + GIT_OID_HEXSZ + 12, line);
+        }
+    }
+    fclose(f);
+    return result;
+}
+
+// mkdir -p for the directories of a branch ref path
+static void make_parent_dirs(char* path) {
+    for (char* slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+            *slash = '/';
+            return;
+        }
+        *slash = '/';
+    }
+}
+
+static int write_branch(const char* name, const avc_oid_t* oid) {
+    char path[512], hex[AVC_OID_HEXSZ + 1];
+    snprintf(path, sizeof(path), ".avc/refs/heads/%s", name);
+    make_parent_dirs(path);
+    oid_to_hex(oid, hex);
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "%s\n", hex);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// Branch Git's HEAD points at. A detached HEAD uses a branch at the same
+// commit if there is one, else becomes "main" (or "detached-head").
+static int read_head(import_ref_t** refs, size_t* count, char* branch_out, size_t branch_size) {
+    FILE* f = fopen(".git/HEAD", "r");
+    char line[512] = "";
+    if (f) {
+        if (!fgets(line, sizeof(line), f)) line[0] = '\0';
+        fclose(f);
+    }
+    line[strcspn(line, "\n")] = '\0';
+    if (strncmp(line, "ref: refs/heads/", 16) == 0) {
+        snprintf(branch_out, branch_size, "%s", line + 16);
+        return 0;
+    }
+
+    uint8_t id[GIT_OID_RAWSZ];
+    if (strlen(line) != GIT_OID_HEXSZ || hex_decode(line, id, GIT_OID_RAWSZ) != 0) {
+        snprintf(branch_out, branch_size, "main");
+        return 0;
+    }
+    const char* name = "main";
+    for (size_t i = 0; i < *count; i++) {
+        if (memcmp((*refs)[i].git_id, id, GIT_OID_RAWSZ) == 0) {
+            snprintf(branch_out, branch_size, "%s", (*refs)[i].name);
+            return 0;
+        }
+        if (strcmp((*refs)[i].name, "main") == 0) name = "detached-head";
+    }
+    snprintf(branch_out, branch_size, "%s", name);
+    return add_ref(refs, count, name, line);
+}
+
+static void free_import(import_t* imp) {
+    for (size_t i = 0; i < imp->count; i++) {
+        free(imp->objects[i].content);
+        free(imp->objects[i].children);
+    }
+    free(imp->objects);
+    free(imp->slots);
+    hash_map_free(imp->map);
+}
+
+int git_import_history(git_import_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    import_ref_t* refs = NULL;
+    size_t ref_count = 0;
+    if (read_branches(&refs, &ref_count) != 0 ||
+        read_head(&refs, &ref_count, stats->head_branch, sizeof(stats->head_branch)) != 0) {
+        free(refs);
+        return -1;
+    }
+    if (ref_count == 0) {
+        fprintf(stderr, "No branches to import\n");
+        free(refs);
+        return -1;
+    }
+
+    import_t imp;
+    memset(&imp, 0, sizeof(imp));
+    imp.stats = stats;
+    git_lfs_policy_load(&imp.lfs);
+    imp.map = hash_map_create();
+    uint32_t* tips = malloc(ref_count * sizeof(uint32_t));
+    int result = tips && imp.map && hash_map_load(imp.map) == 0 && grow_slots(&imp) == 0 ? 0 : -1;
+    for (size_t i = 0; i < ref_count && result == 0; i++) {
+        tips[i] = add_object(&imp, refs[i].git_id, IMPORT_COMMIT);
+        if (tips[i] == IMPORT_NONE) {
+            result = -1;
+        } else if (imp.objects[tips[i]].kind == IMPORT_MAPPED) {
+            imp.objects[tips[i]].kind = IMPORT_COMMIT;
+            stats->reused++;
+        }
+    }
+
+    if (result == 0) result = walk_history(&imp, tips, ref_count);
+
+    if (result == 0) {
+        size_t blob_count = 0;
+        uint32_t* blobs = malloc((imp.count + 1) * sizeof(uint32_t));
+        if (!blobs) result = -1;
+        for (size_t i = 0; blobs && i < imp.count; i++) {
+            if (imp.objects[i].kind == IMPORT_BLOB && !imp.objects[i].done) blobs[blob_count++] = (uint32_t)i;
+        }
+        if (result == 0) result = convert_in_batches(&imp, blobs, blob_count, convert_blob);
+        stats->blobs = blob_count;
+        stats->lfs = atomic_load(&imp.lfs_blobs);
+        free(blobs);
+    }
+    if (result == 0) result = convert_trees(&imp);
+    if (result == 0) result = convert_commits(&imp, tips, ref_count);
+
+    for (size_t i = 0; i < ref_count && result == 0; i++) {
+        result = write_branch(refs[i].name, &imp.objects[tips[i]].avc_oid);
+        stats->branches++;
+    }
+    if (result == 0) {
+        FILE* head = fopen(".avc/HEAD", "w");
+        if (!head) {
+            result = -1;
+        } else {
+            fprintf(head, "ref: refs/heads/%s\n", stats->head_branch);
+            if (fclose(head) != 0) result = -1;
+        }
+    }
+
+    free_import(&imp);
+    free(tips);
+    free(refs);
+    return result;
+}
@@ -0,0 +1,33 @@
+#ifndef GIT_IMPORT_H
+#define GIT_IMPORT_H
+
+#include <stddef.h>
+
+// History-preserving Git -> AVC import (`avc agcl migrate --history`).
+// Every commit reachable from a local branch is converted, reading objects
+// straight from .git (loose or packed). The DAG is walked breadth-first
+// with each frontier parsed in parallel, blobs are converted in parallel,
+// trees bottom-up one height level at a time, and commits in topological
+// order. Each converted object is appended to .git/avc-map in batches, so
+// an interrupted import picks up where it stopped, and sync-to-git maps
+// the result back to the original Git objects.
+
+// Present while an import is in progress; allows resuming into .avc
+#define GIT_IMPORT_MARKER ".avc/git-import"
+
+typedef struct {
+    size_t commits;       // Converted in this run
+    size_t trees;
+    size_t blobs;
+    size_t reused;        // Found in .git/avc-map from an earlier run
+    size_t gitlinks;      // Submodule entries left out of AVC trees
+    size_t lfs;           // LFS pointers replaced by their content
+    size_t branches;
+    char head_branch[256];
+} git_import_stats_t;
+
+// Import into the AVC repository in the current directory. Branches go to
+// .avc/refs/heads and HEAD follows Git's. -1 on error.
+int git_import_history(git_import_stats_t* stats);
+
+#endif // GIT_IMPORT_H
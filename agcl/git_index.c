@@ -0,0 +1,358 @@
+#define _XOPEN_SOURCE 700
+#include "git_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include "fast_index.h"
+#include "git_codec.h"
+#include "git_lfs.h"
+#include "git_object.h"
+#include "index.h"
+#include "objects.h"
+#include "sparse.h"
+#include "thread_pool.h"
+
+#define GIT_INDEX_PATH ".git/index"
+#define GIT_INDEX_LOCK ".git/index.lock"
+#define GIT_INDEX_VERSION 4
+#define GIT_INDEX_NAME_MASK 0xfff
+#define GIT_INDEX_EXTENDED 0x4000        // An extended flags field follows
+#define GIT_INDEX_SKIP_WORKTREE 0x4000   // In the extended flags
+#define AVC_MODE_TREE 040000
+
+typedef struct {
+    char* path;                // Full path from the work tree root
+    unsigned int mode;
+    avc_oid_t avc_oid;
+    const uint8_t* git_id;
+    struct stat st;
+    int clean;                 // st is valid and the file is unchanged
+    int lfs;                   // Exported as an LFS pointer
+    int skip_worktree;         // Outside the sparse checkout, so not in the work tree
+} index_file_t;
+
+// One cache-tree node; nodes are kept in pre-order
+typedef struct {
+    char name[256];
+    int32_t entry_count;       // Files below it
+    uint32_t subtree_count;
+    const uint8_t* git_id;
+} index_tree_t;
+
+typedef struct {
+    hash_map_t* map;
+    index_file_t* files;
+    size_t file_count;
+    size_t file_capacity;
+    index_tree_t* trees;
+    size_t tree_count;
+    size_t tree_capacity;
+    fast_index_t* staged;      // .avc/index
+    fast_index_t* cache;       // .avc/stat-cache
+    git_lfs_policy_t lfs;
+    int lfs_enabled;
+} index_build_t;
+
+typedef struct {
+    char* data;
+    size_t len;
+    size_t capacity;
+} index_buffer_t;
+
+static int buffer_add(index_buffer_t* buf, const void* data, size_t len) {
+    if (buf->len + len > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 64 * 1024;
+        while (capacity < buf->len + len) capacity *= 2;
+        char* grown = realloc(buf->data, capacity);
+        if (!grown) return -1;
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 0;
+}
+
+static int buffer_add_u32(index_buffer_t* buf, uint32_t value) {
+    uint32_t be = htonl(value);
+    return buffer_add(buf, &be, 4);
+}
+
+// Git's offset varint: 7 bits per byte, most significant first, each
+// continuation byte standing for one more than its bits
+static int buffer_add_varint(index_buffer_t* buf, size_t value) {
+    unsigned char varint[16];
+    size_t pos = sizeof(varint) - 1;
+    varint[pos] = value & 127;
+    while (value >>= 7) varint[--pos] = (unsigned char)(128 | (--value & 127));
+    return buffer_add(buf, varint + pos, sizeof(varint) - pos);
+}
+
+static int add_file(index_build_t* b, const char* path, unsigned int mode, const avc_oid_t* oid, int skip_worktree) {
+    const uint8_t* git_id = hash_map_get(b->map, oid);
+    if (!git_id) return -1;
+    if (b->file_count == b->file_capacity) {
+        size_t capacity = b->file_capacity ? b->file_capacity * 2 : 1024;
+        index_file_t* grown = realloc(b->files, capacity * sizeof(index_file_t));
+        if (!grown) return -1;
+        b->files = grown;
+        b->file_capacity = capacity;
+    }
+    index_file_t* file = &b->files[b->file_count];
+    memset(file, 0, sizeof(*file));
+    file->path = strdup(path);
+    if (!file->path) return -1;
+    file->mode = mode;
+    file->avc_oid = *oid;
+    file->git_id = git_id;
+    file->skip_worktree = skip_worktree;
+    b->file_count++;
+    return 0;
+}
+
+// Files and cache-tree nodes of the tree at prefix (empty for the root),
+// named name in its parent. Files of directories the sparse checkout
+// collapses are listed too, as git needs the whole tree, but marked
+// skip-worktree so that git does not look for them.
+static int walk_tree(index_build_t* b, const avc_oid_t* oid, const char* prefix, const char* name,
+                     int skip_worktree) {
+    const uint8_t* git_id = hash_map_get(b->map, oid);
+    if (!git_id) return -1;
+    if (b->tree_count == b->tree_capacity) {
+        size_t capacity = b->tree_capacity ? b->tree_capacity * 2 : 256;
+        index_tree_t* grown = realloc(b->trees, capacity * sizeof(index_tree_t));
+        if (!grown) return -1;
+        b->trees = grown;
+        b->tree_capacity = capacity;
+    }
+    size_t node = b->tree_count++;
+    snprintf(b->trees[node].name, sizeof(b->trees[node].name), "%s", name);
+    b->trees[node].subtree_count = 0;
+    b->trees[node].git_id = git_id;
+    size_t first_file = b->file_count;
+
+    size_t size;
+    char type[16];
+    char* content = load_object(oid, &size, type);
+    if (!content || strcmp(type, "tree") != 0) {
+        free(content);
+        return -1;
+    }
+
+    int result = 0;
+    char* line = content;
+    while (result == 0 && *line) {
+        char* end = strchr(line, '\n');
+        if (end) *end = '\0';
+
+        unsigned int mode;
+        char entry[256], hex[AVC_OID_HEXSZ + 1];
+        avc_oid_t child;
+        if (sscanf(line, "%o %255s %64s", &mode, entry, hex) == 3 && oid_from_hex(hex, &child) == 0) {
+            const char* entry_name = strncmp(entry, "./", 2) == 0 ? entry + 2 : entry;
+            char path[4096];
+            if (snprintf(path, sizeof(path), "%s%s", prefix, entry_name) >= (int)sizeof(path) - 1) {
+                result = -1;
+            } else if (mode == AVC_MODE_TREE) {
+                int skip = skip_worktree || sparse_classify_dir(path) == SPARSE_OUTSIDE;
+                strcat(path, "/");
+                b->trees[node].subtree_count++;
+                result = walk_tree(b, &child, path, entry_name, skip);
+            } else {
+                result = add_file(b, path, mode, &child, skip_worktree);
+            }
+        }
+        if (!end) break;
+        line = end + 1;
+    }
+    free(content);
+    b->trees[node].entry_count = (int32_t)(b->file_count - first_file);
+    return result;
+}
+
+static int compare_files(const void* a, const void* b) {
+    return strcmp(((const index_file_t*)a)->path, ((const index_file_t*)b)->path);
+}
+
+static int stat_unchanged(fast_index_t* idx, const index_file_t* file) {
+    const index_entry_t* entry = fast_index_get(idx, file->path);
+    return entry && oid_equal(&entry->oid, &file->avc_oid) && fast_index_stat_matches(entry, &file->st);
+}
+
+// Whether the export's LFS policy picks a file, by name or by size
+static int is_lfs_file(const index_build_t* b, const index_file_t* file) {
+    const char* slash = strrchr(file->path, '/');
+    if (git_lfs_matches_name(&b->lfs, slash ? slash + 1 : file->path)) return 1;
+    if (b->lfs.threshold == 0) return 0;
+    // A clean file has the blob's size
+    if (file->clean) return (uint64_t)file->st.st_size >= b->lfs.threshold;
+    char type[16];
+    size_t size = 0;
+    return stream_object(&file->avc_oid, type, &size, NULL, NULL) == 0 && size >= b->lfs.threshold;
+}
+
+// A file is clean if it still has the stat data it had when it was hashed
+// to the committed object. LFS files never are: the index holds their
+// pointer, so git must compare them through the LFS filter.
+static void check_file(void* ctx, size_t i) {
+    index_build_t* b = ctx;
+    index_file_t* file = &b->files[i];
+    if (file->skip_worktree) return;
+    if (lstat(file->path, &file->st) == 0) {
+        file->clean = stat_unchanged(b->staged, file) || stat_unchanged(b->cache, file);
+    }
+    file->lfs = b->lfs_enabled && is_lfs_file(b, file);
+    if (file->lfs) file->clean = 0;
+}
+
+// .gitattributes rules for the LFS files, so that git-lfs cleans them
+// into the pointers the index holds
+static int write_lfs_attributes(const index_build_t* b) {
+    const char** paths = malloc((b->file_count + 1) * sizeof(char*));
+    if (!paths) return -1;
+    size_t count = 0;
+    for (size_t i = 0; i < b->file_count; i++) {
+        const index_file_t* file = &b->files[i];
+        const char* slash = strrchr(file->path, '/');
+        // Files picked by name are covered by the pattern itself
+        if (file->lfs && !git_lfs_matches_name(&b->lfs, slash ? slash + 1 : file->path)) {
+            paths[count++] = file->path;
+        }
+    }
+    int result = git_lfs_write_attributes(&b->lfs, paths, count);
+    free(paths);
+    return result;
+}
+
+static int write_entries(const index_build_t* b, index_buffer_t* buf) {
+    int result = 0;
+    const char* previous = "";
+    for (size_t i = 0; i < b->file_count && result == 0; i++) {
+        const index_file_t* file = &b->files[i];
+        const struct stat* st = &file->st;
+        uint32_t fields[10] = {0};
+        if (file->clean) {
+            fields[0] = (uint32_t)st->st_ctim.tv_sec;
+            fields[1] = (uint32_t)st->st_ctim.tv_nsec;
+            fields[2] = (uint32_t)st->st_mtim.tv_sec;
+            fields[3] = (uint32_t)st->st_mtim.tv_nsec;
+            fields[4] = (uint32_t)st->st_dev;
+            fields[5] = (uint32_t)st->st_ino;
+            fields[7] = (uint32_t)st->st_uid;
+            fields[8] = (uint32_t)st->st_gid;
+            fields[9] = (uint32_t)st->st_size;
+        }
+        fields[6] = git_canonical_mode(file->mode);
+        for (int k = 0; k < 10; k++) result |= buffer_add_u32(buf, fields[k]);
+        result |= buffer_add(buf, file->git_id, GIT_OID_RAWSZ);
+
+        // Version 4 names: bytes to drop from the previous name, then the
+        // rest of this one
+        size_t len = strlen(file->path);
+        size_t common = 0;
+        while (previous[common] && previous[common] == file->path[common]) common++;
+        uint16_t flags = (uint16_t)(len < GIT_INDEX_NAME_MASK ? len : GIT_INDEX_NAME_MASK);
+        if (file->skip_worktree) flags |= GIT_INDEX_EXTENDED;
+        flags = htons(flags);
+        result |= buffer_add(buf, &flags, 2);
+        if (file->skip_worktree) {
+            uint16_t extended = htons(GIT_INDEX_SKIP_WORKTREE);
+            result |= buffer_add(buf, &extended, 2);
+        }
+        result |= buffer_add_varint(buf, strlen(previous) - common);
+        result |= buffer_add(buf, file->path + common, len - common + 1);
+        previous = file->path;
+    }
+    return result;
+}
+
+// "TREE" extension: per node in pre-order its name, entry and subtree
+// counts, and its ID
+static int write_cache_tree(const index_build_t* b, index_buffer_t* buf) {
+    index_buffer_t ext = {0};
+    int result = 0;
+    for (size_t i = 0; i < b->tree_count && result == 0; i++) {
+        const index_tree_t* tree = &b->trees[i];
+        char counts[32];
+        int n = snprintf(counts, sizeof(counts), "%d %u\n", tree->entry_count, tree->subtree_count);
+        result |= buffer_add(&ext, tree->name, strlen(tree->name) + 1);
+        result |= buffer_add(&ext, counts, (size_t)n);
+        result |= buffer_add(&ext, tree->git_id, GIT_OID_RAWSZ);
+    }
+    result |= buffer_add(buf, "TREE", 4);
+    result |= buffer_add_u32(buf, (uint32_t)ext.len);
+    if (ext.len > 0) result |= buffer_add(buf, ext.data, ext.len);
+    free(ext.data);
+    return result;
+}
+
+// Replace .git/index the way git does, through .git/index.lock
+static int write_index_file(const index_buffer_t* buf) {
+    int fd = open(GIT_INDEX_LOCK, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) {
+        if (errno == EEXIST) fprintf(stderr, "Warning: %s exists; is git running?\n", GIT_INDEX_LOCK);
+        return -1;
+    }
+    size_t written = 0;
+    while (written < buf->len) {
+        ssize_t n = write(fd, buf->data + written, buf->len - written);
+        if (n <= 0) break;
+        written += (size_t)n;
+    }
+    if (close(fd) != 0 || written != buf->len || rename(GIT_INDEX_LOCK, GIT_INDEX_PATH) != 0) {
+        unlink(GIT_INDEX_LOCK);
+        return -1;
+    }
+    return 0;
+}
+
+int git_index_write(hash_map_t* map, const avc_oid_t* commit_oid) {
+    size_t size;
+    char type[16];
+    char* commit = load_object(commit_oid, &size, type);
+    char hex[AVC_OID_HEXSZ + 1];
+    avc_oid_t tree_oid;
+    int found = commit && strcmp(type, "commit") == 0 && sscanf(commit, "tree %64s", hex) == 1 &&
+                oid_from_hex(hex, &tree_oid) == 0;
+    free(commit);
+    if (!found) return -1;
+
+    index_build_t b = {.map = map, .staged = fast_index_create(), .cache = fast_index_create()};
+    b.lfs_enabled = git_lfs_policy_load(&b.lfs);
+    int result = b.staged && b.cache && fast_index_load(b.staged) == 0 &&
+                 fast_index_load_file(b.cache, INDEX_STAT_CACHE_PATH) == 0 ? 0 : -1;
+    if (result == 0) result = walk_tree(&b, &tree_oid, "", "", 0);
+
+    index_buffer_t buf = {0};
+    if (result == 0) {
+        qsort(b.files, b.file_count, sizeof(index_file_t), compare_files);
+        thread_pool_parallel_for(b.file_count, check_file, &b);
+        if (b.lfs_enabled && write_lfs_attributes(&b) != 0) {
+            fprintf(stderr, "Warning: Could not add LFS rules to .gitattributes\n");
+        }
+
+        result |= buffer_add(&buf, "DIRC", 4);
+        result |= buffer_add_u32(&buf, GIT_INDEX_VERSION);
+        result |= buffer_add_u32(&buf, (uint32_t)b.file_count);
+        result |= write_entries(&b, &buf);
+        result |= write_cache_tree(&b, &buf);
+
+        uint8_t checksum[GIT_OID_RAWSZ];
+        if (result == 0) git_sha1(buf.data, buf.len, checksum);
+        if (result == 0) result = buffer_add(&buf, checksum, sizeof(checksum));
+    }
+    if (result == 0) result = write_index_file(&buf);
+
+    free(buf.data);
+    for (size_t i = 0; i < b.file_count; i++) free(b.files[i].path);
+    free(b.files);
+    free(b.trees);
+    fast_index_free(b.staged);
+    fast_index_free(b.cache);
+    return result;
+}
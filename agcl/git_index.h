@@ -0,0 +1,17 @@
+#ifndef GIT_INDEX_H
+#define GIT_INDEX_H
+
+#include "fast_agcl.h"
+
+// Write .git/index (version 4) for the tree of a synced commit, with a
+// cache-tree extension holding every converted tree. Files whose stat data
+// still matches what `avc add` recorded (in .avc/index or .avc/stat-cache)
+// get their current stat data, so git treats them as clean without reading
+// them; the others get none and git compares their content once. Files
+// exported to LFS never get stat data, and their rules are merged into
+// .gitattributes so that git compares them through git-lfs. Every object
+// of the commit must be in map. Files outside the sparse checkout are
+// marked skip-worktree. -1 on error or if git holds .git/index.lock.
+int git_index_write(hash_map_t* map, const avc_oid_t* commit_oid);
+
+#endif // GIT_INDEX_H
@@ -0,0 +1,406 @@
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+#include "git_lfs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+#include "config.h"
+#include "objects.h"
+
+#define LFS_SPEC_LINE "version https://git-lfs.github.com/spec/v1\n"
+#define LFS_TMP_DIR ".git/lfs/tmp"
+#define LFS_COPY_BUFFER (1024 * 1024)
+#define LFS_ATTRIBUTES_PATH ".gitattributes"
+#define LFS_ATTRIBUTES " filter=lfs diff=lfs merge=lfs -text"
+
+int git_lfs_policy_load(git_lfs_policy_t* policy) {
+    memset(policy, 0, sizeof(*policy));
+    policy->threshold = avc_config_get_size("agcl", "lfsthreshold", 0);
+    if (avc_config_get("agcl", "lfspatterns", policy->patterns, sizeof(policy->patterns)) != 0) {
+        policy->patterns[0] = '\0';
+    }
+    if (avc_config_get("agcl", "lfsstore", policy->store, sizeof(policy->store)) != 0) policy->store[0] = '\0';
+    return policy->threshold > 0 || policy->patterns[0];
+}
+
+int git_lfs_matches_name(const git_lfs_policy_t* policy, const char* name) {
+    char patterns[sizeof(policy->patterns)];
+    snprintf(patterns, sizeof(patterns), "%s", policy->patterns);
+    char* saveptr;
+    for (char* p = strtok_r(patterns, " ,\t", &saveptr); p; p = strtok_r(NULL, " ,\t", &saveptr)) {
+        if (fnmatch(p, name, 0) == 0) return 1;
+    }
+    return 0;
+}
+
+// <dir>/<aa>/<bb>/<oid>
+static void object_path(const char* dir, const char* oid, char* path_out, size_t path_size) {
+    snprintf(path_out, path_size, "%s/%.2s/%.2s/%s", dir, oid, oid + 2, oid);
+}
+
+// Create every directory of path up to its last component
+static int make_parent_dirs(const char* path) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char* slash = strchr(dir + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        int failed = mkdir(dir, 0755) == -1 && errno != EEXIST;
+        *slash = '/';
+        if (failed) return -1;
+    }
+    return 0;
+}
+
+static void digest_hex(EVP_MD_CTX* sha, char hex_out[GIT_LFS_OID_HEXSZ + 1]) {
+    unsigned char digest[32];
+    unsigned int len = 0;
+    EVP_DigestFinal_ex(sha, digest, &len);
+    for (unsigned int i = 0; i < 32; i++) snprintf(hex_out + i * 2, 3, "%02x", digest[i]);
+}
+
+static int write_all(int fd, const void* data, size_t len) {
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Move a finished temporary file to its object path; an existing object
+// (same content by definition) wins
+static int install_object(const char* tmp_path, const char* path) {
+    if (make_parent_dirs(path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    if (access(path, F_OK) == 0) {
+        unlink(tmp_path);
+        return 0;
+    }
+    if (rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    EVP_MD_CTX* sha;
+    int fd;
+} lfs_write_t;
+
+static int write_piece(void* ctx, const void* data, size_t len) {
+    lfs_write_t* w = ctx;
+    EVP_DigestUpdate(w->sha, data, len);
+    return write_all(w->fd, data, len);
+}
+
+char* git_lfs_export_blob(const avc_oid_t* oid, size_t* size_out) {
+    char tmp_path[] = LFS_TMP_DIR "/export-XXXXXX";
+    if (make_parent_dirs(tmp_path) != 0) return NULL;
+    lfs_write_t w = {EVP_MD_CTX_new(), mkstemp(tmp_path)};
+    if (!w.sha || w.fd == -1 || EVP_DigestInit_ex(w.sha, EVP_sha256(), NULL) != 1) {
+        if (w.fd != -1) {
+            close(w.fd);
+            unlink(tmp_path);
+        }
+        EVP_MD_CTX_free(w.sha);
+        return NULL;
+    }
+
+    char type[16];
+    size_t size = 0;
+    int result = stream_object(oid, type, &size, write_piece, &w) == 0 && strcmp(type, "blob") == 0 ? 0 : -1;
+    if (fchmod(w.fd, 0444) != 0 || close(w.fd) != 0) result = -1;
+    char hex[GIT_LFS_OID_HEXSZ + 1];
+    digest_hex(w.sha, hex);
+    EVP_MD_CTX_free(w.sha);
+    if (result != 0 || size == 0) {
+        unlink(tmp_path);
+        if (result != 0) return NULL;
+        *size_out = 0;
+        return calloc(1, 1);
+    }
+
+    char path[PATH_MAX];
+    object_path(GIT_LFS_OBJECTS_DIR, hex, path, sizeof(path));
+    if (install_object(tmp_path, path) != 0) return NULL;
+
+    char* pointer = malloc(GIT_LFS_POINTER_MAX);
+    if (!pointer) return NULL;
+    int len = snprintf(pointer, GIT_LFS_POINTER_MAX, LFS_SPEC_LINE "oid sha256:%s\nsize %zu\n", hex, size);
+    *size_out = (size_t)len;
+    return pointer;
+}
+
+int git_lfs_parse_pointer(const char* content, size_t size, char oid_out[GIT_LFS_OID_HEXSZ + 1],
+                          uint64_t* size_out) {
+    size_t spec_len = strlen(LFS_SPEC_LINE);
+    if (size < spec_len || size >= GIT_LFS_POINTER_MAX || memcmp(content, LFS_SPEC_LINE, spec_len) != 0) {
+        return -1;
+    }
+    char text[GIT_LFS_POINTER_MAX];
+    memcpy(text, content, size);
+    text[size] = '\0';
+
+    int have_oid = 0, have_size = 0;
+    char* saveptr;
+    for (char* line = strtok_r(text + spec_len, "\n", &saveptr); line; line = strtok_r(NULL, "\n", &saveptr)) {
+        unsigned long long n;
+        if (strncmp(line, "oid sha256:", 11) == 0 && strlen(line + 11) == GIT_LFS_OID_HEXSZ &&
+            strspn(line + 11, "0123456789abcdef") == GIT_LFS_OID_HEXSZ) {
+            memcpy(oid_out, line + 11, GIT_LFS_OID_HEXSZ + 1);
+            have_oid = 1;
+        } else if (sscanf(line, "size %llu", &n) == 1) {
+            *size_out = n;
+            have_size = 1;
+        }
+    }
+    return have_oid && have_size ? 0 : -1;
+}
+
+// Copy src to dst through a temporary file next to it, checking the
+// content against expect_oid if given
+static int copy_object(const char* src, const char* dst, const char* expect_oid) {
+    int in = open(src, O_RDONLY);
+    if (in == -1) return -1;
+    char tmp_path[PATH_MAX + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp-XXXXXX", dst);
+    int out = make_parent_dirs(dst) == 0 ? mkstemp(tmp_path) : -1;
+    char* buffer = malloc(LFS_COPY_BUFFER);
+    EVP_MD_CTX* sha = expect_oid ? EVP_MD_CTX_new() : NULL;
+    int result = out != -1 && buffer && (!expect_oid || (sha && EVP_DigestInit_ex(sha, EVP_sha256(), NULL) == 1))
+                     ? 0 : -1;
+
+    ssize_t n;
+    while (result == 0 && (n = read(in, buffer, LFS_COPY_BUFFER)) != 0) {
+        if (n < 0) {
+            if (errno != EINTR) result = -1;
+            continue;
+        }
+        if (sha) EVP_DigestUpdate(sha, buffer, (size_t)n);
+        result = write_all(out, buffer, (size_t)n);
+    }
+    if (result == 0 && sha) {
+        char hex[GIT_LFS_OID_HEXSZ + 1];
+        digest_hex(sha, hex);
+        if (strcmp(hex, expect_oid) != 0) {
+            fprintf(stderr, "Warning: LFS object %s is corrupt in %s\n", expect_oid, src);
+            result = -1;
+        }
+    }
+    close(in);
+    if (out != -1 && (fchmod(out, 0444) != 0 || close(out) != 0)) result = -1;
+    free(buffer);
+    EVP_MD_CTX_free(sha);
+    if (out == -1) return -1;
+    if (result != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return install_object(tmp_path, dst);
+}
+
+int git_lfs_fetch(const git_lfs_policy_t* policy, const char oid[GIT_LFS_OID_HEXSZ + 1],
+                  char* path_out, size_t path_size) {
+    object_path(GIT_LFS_OBJECTS_DIR, oid, path_out, path_size);
+    if (access(path_out, R_OK) == 0) return 0;
+    if (!policy->store[0]) return -1;
+
+    char src[PATH_MAX];
+    object_path(policy->store, oid, src, sizeof(src));
+    return copy_object(src, path_out, oid);
+}
+
+static int is_oid_name(const char* name) {
+    return strlen(name) == GIT_LFS_OID_HEXSZ && strspn(name, "0123456789abcdef") == GIT_LFS_OID_HEXSZ;
+}
+
+int git_lfs_push_objects(const char* objects_dir, size_t* copied_out) {
+    *copied_out = 0;
+    DIR* top = opendir(GIT_LFS_OBJECTS_DIR);
+    if (!top) return errno == ENOENT ? 0 : -1;
+
+    int result = 0;
+    struct dirent* a;
+    while (result == 0 && (a = readdir(top)) != NULL) {
+        if (strlen(a->d_name) != 2) continue;
+        char dir_a[sizeof(GIT_LFS_OBJECTS_DIR) + 3];
+        snprintf(dir_a, sizeof(dir_a), "%s/%.2s", GIT_LFS_OBJECTS_DIR, a->d_name);
+        DIR* mid = opendir(dir_a);
+        struct dirent* b;
+        while (result == 0 && mid && (b = readdir(mid)) != NULL) {
+            if (strlen(b->d_name) != 2) continue;
+            char dir_b[sizeof(dir_a) + 3];
+            snprintf(dir_b, sizeof(dir_b), "%s/%.2s", dir_a, b->d_name);
+            DIR* leaf = opendir(dir_b);
+            struct dirent* entry;
+            while (result == 0 && leaf && (entry = readdir(leaf)) != NULL) {
+                if (!is_oid_name(entry->d_name)) continue;
+                char src[sizeof(dir_b) + GIT_LFS_OID_HEXSZ + 1], dst[PATH_MAX];
+                snprintf(src, sizeof(src), "%s/%.*s", dir_b, GIT_LFS_OID_HEXSZ, entry->d_name);
+                object_path(objects_dir, entry->d_name, dst, sizeof(dst));
+                if (access(dst, F_OK) == 0) continue;
+                result = copy_object(src, dst, NULL);
+                if (result == 0) (*copied_out)++;
+            }
+            if (leaf) closedir(leaf);
+        }
+        if (mid) closedir(mid);
+    }
+    closedir(top);
+    return result;
+}
+
+// Nonzero if attributes (NUL-terminated) has a line for rule
+static int has_attribute_rule(const char* attributes, const char* rule) {
+    size_t len = strlen(rule);
+    for (const char* line = attributes; *line;) {
+        while (*line == ' ' || *line == '\t') line++;
+        if (strncmp(line, rule, len) == 0 && (line[len] == ' ' || line[len] == '\t')) return 1;
+        const char* end = strchr(line, '\n');
+        if (!end) break;
+        line = end + 1;
+    }
+    return 0;
+}
+
+static int append_attribute_rule(char** attributes, size_t* len, const char* rule) {
+    if (has_attribute_rule(*attributes, rule)) return 0;
+    char line[PATH_MAX + 64];
+    int n = snprintf(line, sizeof(line), "%s%s" LFS_ATTRIBUTES "\n",
+                     *len > 0 && (*attributes)[*len - 1] != '\n' ? "\n" : "", rule);
+    if (n < 0 || n >= (int)sizeof(line)) return -1;
+    char* grown = realloc(*attributes, *len + (size_t)n + 1);
+    if (!grown) return -1;
+    memcpy(grown + *len, line, (size_t)n + 1);
+    *attributes = grown;
+    *len += (size_t)n;
+    return 0;
+}
+
+int git_lfs_write_attributes(const git_lfs_policy_t* policy, const char* const* paths, size_t count) {
+    size_t len = 0;
+    char* attributes = NULL;
+    FILE* in = fopen(LFS_ATTRIBUTES_PATH, "rb");
+    if (in) {
+        struct stat st;
+        attributes = fstat(fileno(in), &st) == 0 ? malloc((size_t)st.st_size + 1) : NULL;
+        if (attributes) len = fread(attributes, 1, (size_t)st.st_size, in);
+        fclose(in);
+    } else if (errno == ENOENT) {
+        attributes = malloc(1);
+    }
+    if (!attributes) return -1;
+    attributes[len] = '\0';
+    size_t original_len = len;
+
+    // Patterns match file names, as they do in .gitattributes
+    char patterns[sizeof(policy->patterns)];
+    snprintf(patterns, sizeof(patterns), "%s", policy->patterns);
+    char* saveptr;
+    int result = 0;
+    for (char* p = strtok_r(patterns, " ,\t", &saveptr); p && result == 0; p = strtok_r(NULL, " ,\t", &saveptr)) {
+        result = append_attribute_rule(&attributes, &len, p);
+    }
+    for (size_t i = 0; i < count && result == 0; i++) {
+        char rule[PATH_MAX];
+        if (strpbrk(paths[i], " \t\n") || snprintf(rule, sizeof(rule), "/%s", paths[i]) >= (int)sizeof(rule)) {
+            continue;   // Not expressible as a plain pattern
+        }
+        result = append_attribute_rule(&attributes, &len, rule);
+    }
+
+    if (result == 0 && len != original_len) {
+        char tmp_path[] = LFS_ATTRIBUTES_PATH ".tmp-XXXXXX";
+        int fd = mkstemp(tmp_path);
+        result = fd == -1 ? -1 : write_all(fd, attributes, len);
+        if (fd != -1 && (fchmod(fd, 0644) != 0 || close(fd) != 0)) result = -1;
+        if (fd != -1 && (result != 0 || rename(tmp_path, LFS_ATTRIBUTES_PATH) != 0)) {
+            unlink(tmp_path);
+            result = -1;
+        }
+    }
+    free(attributes);
+    return result;
+}
+
+// Rewrite one file with the content of the LFS object at path, keeping its mode
+static int smudge_file(const char* file, const struct stat* st, const char* object) {
+    char tmp_path[PATH_MAX + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.lfs-XXXXXX", file);
+    int out = mkstemp(tmp_path);
+    if (out == -1) return -1;
+    int in = open(object, O_RDONLY);
+    char* buffer = malloc(LFS_COPY_BUFFER);
+    int result = in != -1 && buffer ? 0 : -1;
+    ssize_t n;
+    while (result == 0 && (n = read(in, buffer, LFS_COPY_BUFFER)) != 0) {
+        if (n < 0) {
+            if (errno != EINTR) result = -1;
+            continue;
+        }
+        result = write_all(out, buffer, (size_t)n);
+    }
+    if (in != -1) close(in);
+    free(buffer);
+    if (fchmod(out, st->st_mode & 07777) != 0 || close(out) != 0) result = -1;
+    if (result == 0 && rename(tmp_path, file) == 0) return 0;
+    unlink(tmp_path);
+    return -1;
+}
+
+static void smudge_dir(const git_lfs_policy_t* policy, const char* dir, size_t* replaced) {
+    DIR* d = opendir(dir);
+    if (!d) return;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 || strcmp(name, ".git") == 0 ||
+            strcmp(name, ".avc") == 0) {
+            continue;
+        }
+        char path[PATH_MAX];
+        if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) continue;
+        struct stat st;
+        if (lstat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            smudge_dir(policy, path, replaced);
+            continue;
+        }
+        if (!S_ISREG(st.st_mode) || st.st_size == 0 || st.st_size >= GIT_LFS_POINTER_MAX) continue;
+
+        char content[GIT_LFS_POINTER_MAX];
+        FILE* f = fopen(path, "rb");
+        if (!f) continue;
+        size_t size = fread(content, 1, sizeof(content), f);
+        fclose(f);
+        char oid[GIT_LFS_OID_HEXSZ + 1], object[PATH_MAX];
+        uint64_t object_size;
+        if (git_lfs_parse_pointer(content, size, oid, &object_size) != 0) continue;
+        if (git_lfs_fetch(policy, oid, object, sizeof(object)) != 0) {
+            fprintf(stderr, "Warning: LFS object %s for %s is not available\n", oid, path + 2);
+        } else if (smudge_file(path, &st, object) == 0) {
+            (*replaced)++;
+        }
+    }
+    closedir(d);
+}
+
+int git_lfs_smudge_work_tree(const git_lfs_policy_t* policy, size_t* replaced_out) {
+    *replaced_out = 0;
+    smudge_dir(policy, ".", replaced_out);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef GIT_LFS_H
+#define GIT_LFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "oid.h"
+
+// Git LFS export of large blobs. Blobs picked by the policy in .avc/config
+//
+//   [agcl]
+//       lfsthreshold = 50M        # blobs at least this large (k/M/G suffixes)
+//       lfspatterns = *.psd *.bin # or with a matching file name
+//       lfsstore = /mnt/lfs       # optional stand-in for the LFS server
+//
+// go to Git as LFS pointer files. Their content is streamed from the AVC
+// object into .git/lfs/objects/<aa>/<bb>/<sha256>, the layout git-lfs uses.
+// Push copies those objects to the store; import and pull read pointers
+// back into AVC blobs from the local objects or the store.
+
+#define GIT_LFS_OBJECTS_DIR ".git/lfs/objects"
+#define GIT_LFS_OID_HEXSZ 64
+// Pointer files are about 130 bytes; anything larger is content
+#define GIT_LFS_POINTER_MAX 512
+
+typedef struct {
+    uint64_t threshold;        // 0: no size rule
+    char patterns[1024];       // Space- or comma-separated fnmatch patterns
+    char store[4096];          // "" without a store
+} git_lfs_policy_t;
+
+// Read the policy; nonzero if it exports anything
+int git_lfs_policy_load(git_lfs_policy_t* policy);
+
+// Nonzero if a file name matches one of the patterns
+int git_lfs_matches_name(const git_lfs_policy_t* policy, const char* name);
+
+// Write an AVC blob's content to .git/lfs/objects and return its pointer
+// file (malloc'ed; an empty blob stays empty, as with git-lfs). NULL on
+// error. Thread-safe.
+char* git_lfs_export_blob(const avc_oid_t* oid, size_t* size_out);
+
+// 0 if content is an LFS pointer; its SHA-256 goes to oid_out
+int git_lfs_parse_pointer(const char* content, size_t size, char oid_out[GIT_LFS_OID_HEXSZ + 1],
+                          uint64_t* size_out);
+
+// Path of the content of an LFS object, copied from the store into
+// .git/lfs/objects (and checked) if only the store has it. 0 if available.
+int git_lfs_fetch(const git_lfs_policy_t* policy, const char oid[GIT_LFS_OID_HEXSZ + 1],
+                  char* path_out, size_t path_size);
+
+// Copy the local LFS objects that objects_dir (same layout) lacks; the
+// number copied goes to copied_out. -1 on error.
+int git_lfs_push_objects(const char* objects_dir, size_t* copied_out);
+
+// Make git run exported files through git-lfs: merge a
+// "<rule> filter=lfs diff=lfs merge=lfs -text" line into .gitattributes
+// for each pattern of the policy and each of paths (files picked by size),
+// unless the file already has a line for that rule. -1 on error.
+int git_lfs_write_attributes(const git_lfs_policy_t* policy, const char* const* paths, size_t count);
+
+// Replace pointer files in the work tree with their content, for the
+// objects that can be fetched; the number replaced goes to replaced_out
+int git_lfs_smudge_work_tree(const git_lfs_policy_t* policy, size_t* replaced_out);
+
+#endif // GIT_LFS_H
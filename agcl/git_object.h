@@ -0,0 +1,29 @@
+#ifndef GIT_OBJECT_H
+#define GIT_OBJECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fast_agcl.h"
+
+// Git object ID: SHA-1 of "type size\0content"
+void git_hash_object(const char* type, const char* content, size_t size,
+                     uint8_t git_id_out[GIT_OID_RAWSZ]);
+
+// The mode git allows for an AVC tree entry mode (st_mode as added): trees,
+// symlinks and gitlinks as they are, files 100755 if any execute bit is
+// set, else 100644
+unsigned int git_canonical_mode(unsigned int mode);
+
+// Write a zlib loose object under .git/objects unless it already exists
+int git_write_loose_object(const char* type, const char* content, size_t size,
+                           const uint8_t git_id[GIT_OID_RAWSZ]);
+
+// Read a loose object with a streaming inflate. Returns the malloc'ed
+// content (NUL-terminated past size_out) and its type in type_out (at
+// least 16 bytes), or NULL if it is missing or corrupt.
+char* git_read_loose_object(const uint8_t git_id[GIT_OID_RAWSZ], size_t* size_out, char* type_out);
+
+// Read an object from the loose store or any pack
+char* git_read_object(const uint8_t git_id[GIT_OID_RAWSZ], size_t* size_out, char* type_out);
+
+#endif // GIT_OBJECT_H
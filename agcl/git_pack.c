@@ -0,0 +1,593 @@
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+#include "git_pack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+#include "git_codec.h"
+#include "git_delta.h"
+#include "objects.h"
+#include "thread_pool.h"
+
+#define PACK_SIGNATURE "PACK"
+#define PACK_VERSION 2
+#define PACK_HEADER_LEN 12
+#define IDX_SIGNATURE "\377tOc"
+#define IDX_VERSION 2
+#define IDX_HEADER_LEN 8
+#define IDX_FANOUT_LEN (256 * 4)
+#define IDX_LARGE_OFFSET 0x80000000u
+
+#define PACK_IO_BUFFER (256 * 1024)
+
+// Queued objects are encoded once either limit is reached
+#define PACK_DELTA_BATCH 256
+#define PACK_DELTA_BATCH_BYTES (64 * 1024 * 1024)
+// Larger entries are deflated straight into the file rather than queued
+// (or, for delta candidates, compressed in memory on the pool)
+#define PACK_QUEUE_MAX_SIZE (16 * 1024 * 1024)
+// Like git's core.bigFileThreshold: larger blobs are never deltified
+#define PACK_DELTA_MAX_SIZE (512 * 1024 * 1024)
+
+typedef struct {
+    uint8_t id[GIT_OID_RAWSZ];
+    uint64_t offset;
+    uint32_t crc;
+    uint32_t depth;           // Delta chain length (an upper bound while queued)
+} pack_entry_t;
+
+// An object waiting for the parallel delta and deflate pass
+typedef struct {
+    size_t entry;
+    int code;
+    char* content;
+    size_t size;
+    git_pack_base_t bases[GIT_PACK_MAX_WINDOW];
+    size_t base_entries[GIT_PACK_MAX_WINDOW];
+    size_t base_count;
+    unsigned char* delta;     // Best delta found, if any
+    size_t delta_size;
+    size_t delta_base;        // Entry index the delta applies to
+    unsigned char* packed;    // Deflated delta or content, unless too large
+    size_t packed_size;
+} pending_delta_t;
+
+struct git_pack_writer {
+    FILE* file;
+    char dir[PATH_MAX];
+    char tmp_path[PATH_MAX + 32];
+    uint64_t offset;          // Bytes written so far
+    pack_entry_t* entries;
+    size_t count;
+    size_t capacity;
+    uint32_t* slots;          // Open addressing over entries, index + 1
+    size_t slot_mask;
+    unsigned char* zbuf;
+    int window;
+    int depth;
+    pending_delta_t* pending;
+    size_t pending_count;
+    size_t pending_bytes;
+};
+
+static int pack_type_code(const char* type) {
+    if (strcmp(type, "commit") == 0) return GIT_PACK_COMMIT;
+    if (strcmp(type, "tree") == 0) return GIT_PACK_TREE;
+    if (strcmp(type, "blob") == 0) return GIT_PACK_BLOB;
+    if (strcmp(type, "tag") == 0) return GIT_PACK_TAG;
+    return -1;
+}
+
+static size_t id_slot(const uint8_t id[GIT_OID_RAWSZ], size_t mask) {
+    uint64_t h;
+    memcpy(&h, id, sizeof(h));
+    return (size_t)h & mask;
+}
+
+static int grow_slots(git_pack_writer_t* w) {
+    size_t size = w->slots ? (w->slot_mask + 1) * 2 : 1024;
+    uint32_t* slots = calloc(size, sizeof(uint32_t));
+    if (!slots) return -1;
+    for (size_t i = 0; i < w->count; i++) {
+        size_t s = id_slot(w->entries[i].id, size - 1);
+        while (slots[s]) s = (s + 1) & (size - 1);
+        slots[s] = (uint32_t)(i + 1);
+    }
+    free(w->slots);
+    w->slots = slots;
+    w->slot_mask = size - 1;
+    return 0;
+}
+
+// Entry index of an object in this pack, or -1
+static long find_entry(const git_pack_writer_t* w, const uint8_t id[GIT_OID_RAWSZ]) {
+    if (!w || !w->slots) return -1;
+    size_t s = id_slot(id, w->slot_mask);
+    while (w->slots[s]) {
+        if (memcmp(w->entries[w->slots[s] - 1].id, id, GIT_OID_RAWSZ) == 0) return (long)w->slots[s] - 1;
+        s = (s + 1) & w->slot_mask;
+    }
+    return -1;
+}
+
+int git_pack_writer_has(const git_pack_writer_t* w, const uint8_t git_id[GIT_OID_RAWSZ]) {
+    return find_entry(w, git_id) >= 0;
+}
+
+size_t git_pack_writer_count(const git_pack_writer_t* w) {
+    return w ? w->count : 0;
+}
+
+git_pack_writer_t* git_pack_writer_open(void) {
+    return git_pack_writer_open_in(GIT_PACK_DIR);
+}
+
+git_pack_writer_t* git_pack_writer_open_in(const char* pack_dir) {
+    if (strlen(pack_dir) >= PATH_MAX) return NULL;
+    if (mkdir(pack_dir, 0755) == -1 && errno != EEXIST) return NULL;
+
+    git_pack_writer_t* w = calloc(1, sizeof(git_pack_writer_t));
+    if (!w) return NULL;
+    snprintf(w->dir, sizeof(w->dir), "%s", pack_dir);
+    w->zbuf = malloc(PACK_IO_BUFFER);
+    w->window = GIT_PACK_DEFAULT_WINDOW;
+    w->depth = GIT_PACK_DEFAULT_DEPTH;
+    w->pending = malloc(PACK_DELTA_BATCH * sizeof(pending_delta_t));
+    snprintf(w->tmp_path, sizeof(w->tmp_path), "%s/tmp_pack_XXXXXX", w->dir);
+    int fd = w->zbuf && w->pending ? mkstemp(w->tmp_path) : -1;
+    if (fd == -1) {
+        free(w->zbuf);
+        free(w->pending);
+        free(w);
+        return NULL;
+    }
+    w->file = fdopen(fd, "w+b");
+    if (!w->file) {
+        close(fd);
+        unlink(w->tmp_path);
+        free(w->zbuf);
+        free(w->pending);
+        free(w);
+        return NULL;
+    }
+    setvbuf(w->file, NULL, _IOFBF, PACK_IO_BUFFER);
+
+    // Object count is patched in by finish
+    unsigned char header[PACK_HEADER_LEN];
+    memcpy(header, PACK_SIGNATURE, 4);
+    uint32_t version = htonl(PACK_VERSION), zero = 0;
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &zero, 4);
+    if (fwrite(header, 1, sizeof(header), w->file) != sizeof(header)) {
+        git_pack_writer_abort(w);
+        return NULL;
+    }
+    w->offset = PACK_HEADER_LEN;
+    return w;
+}
+
+// Write bytes and fold them into the entry's CRC
+static int pack_write(git_pack_writer_t* w, const void* data, size_t len, uint32_t* crc) {
+    if (fwrite(data, 1, len, w->file) != len) return -1;
+    *crc = (uint32_t)crc32(*crc, data, (uInt)len);
+    w->offset += len;
+    return 0;
+}
+
+void git_pack_writer_set_delta(git_pack_writer_t* w, int window, int depth) {
+    if (!w) return;
+    w->window = window < 0 ? 0 : window > GIT_PACK_MAX_WINDOW ? GIT_PACK_MAX_WINDOW : window;
+    w->depth = depth < 1 ? 1 : depth;
+}
+
+// Register an object in the entry table (offset is set when it is written)
+static long new_entry(git_pack_writer_t* w, const uint8_t git_id[GIT_OID_RAWSZ]) {
+    if (w->count == w->capacity) {
+        size_t capacity = w->capacity ? w->capacity * 2 : 1024;
+        pack_entry_t* entries = realloc(w->entries, capacity * sizeof(pack_entry_t));
+        if (!entries) return -1;
+        w->entries = entries;
+        w->capacity = capacity;
+    }
+    if (!w->slots || (w->count + 1) * 2 > w->slot_mask + 1) {
+        if (grow_slots(w) != 0) return -1;
+    }
+
+    size_t index = w->count++;
+    pack_entry_t* entry = &w->entries[index];
+    memcpy(entry->id, git_id, GIT_OID_RAWSZ);
+    entry->offset = 0;
+    entry->crc = 0;
+    entry->depth = 0;
+
+    size_t s = id_slot(git_id, w->slot_mask);
+    while (w->slots[s]) s = (s + 1) & w->slot_mask;
+    w->slots[s] = (uint32_t)(index + 1);
+    return (long)index;
+}
+
+// Entry header: type and inflated size, then the base offset for OFS_DELTA
+static int write_header(git_pack_writer_t* w, size_t index, int code, size_t size, size_t base) {
+    pack_entry_t* entry = &w->entries[index];
+    entry->offset = w->offset;
+    entry->crc = (uint32_t)crc32(0, Z_NULL, 0);
+
+    // Entry header: type and size, 4 bits then 7 bits per byte
+    unsigned char header[32];
+    size_t n = 0, rest = size >> 4;
+    header[n] = (unsigned char)((code << 4) | (size & 0x0f));
+    while (rest) {
+        header[n++] |= 0x80;
+        header[n] = rest & 0x7f;
+        rest >>= 7;
+    }
+    n++;
+
+    // Distance back to the base, big-endian 7-bit groups with an implicit +1
+    if (code == GIT_PACK_OFS_DELTA) {
+        uint64_t distance = entry->offset - w->entries[base].offset;
+        unsigned char ofs[16];
+        size_t pos = sizeof(ofs) - 1;
+        ofs[pos] = distance & 0x7f;
+        while (distance >>= 7) {
+            ofs[--pos] = 0x80 | (--distance & 0x7f);
+        }
+        memcpy(header + n, ofs + pos, sizeof(ofs) - pos);
+        n += sizeof(ofs) - pos;
+    }
+    return pack_write(w, header, n, &entry->crc);
+}
+
+// Whole-buffer deflate with the codec's backend; NULL for entries too large
+// to hold compressed in memory
+static unsigned char* deflate_payload(const void* data, size_t size, size_t* size_out) {
+    if (size > PACK_QUEUE_MAX_SIZE) return NULL;
+    return git_codec_deflate(NULL, 0, data, size, size_out);
+}
+
+// Write one entry: header, then the data deflated in memory or, for large
+// entries, streamed through zlib straight into the pack
+static int write_entry(git_pack_writer_t* w, size_t index, int code,
+                       const void* data, size_t size, size_t base) {
+    pack_entry_t* entry = &w->entries[index];
+    if (write_header(w, index, code, size, base) != 0) return -1;
+
+    size_t packed_size;
+    unsigned char* packed = deflate_payload(data, size, &packed_size);
+    if (packed) {
+        int result = pack_write(w, packed, packed_size, &entry->crc);
+        free(packed);
+        return result;
+    }
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit(&zs, git_codec_level()) != Z_OK) return -1;
+    const char* p = data;
+    size_t left = size;
+    int ret;
+    do {
+        uInt slice = left > (1u << 30) ? (1u << 30) : (uInt)left;
+        zs.next_in = (Bytef*)p;
+        zs.avail_in = slice;
+        int flush = slice == left ? Z_FINISH : Z_NO_FLUSH;
+        do {
+            zs.next_out = w->zbuf;
+            zs.avail_out = PACK_IO_BUFFER;
+            ret = deflate(&zs, flush);
+            size_t produced = PACK_IO_BUFFER - zs.avail_out;
+            if (ret == Z_STREAM_ERROR || pack_write(w, w->zbuf, produced, &entry->crc) != 0) {
+                deflateEnd(&zs);
+                return -1;
+            }
+        } while (zs.avail_out == 0);
+        p += slice;
+        left -= slice;
+    } while (left > 0);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END ? 0 : -1;
+}
+
+int git_pack_writer_add(git_pack_writer_t* w, const char* type,
+                        const char* content, size_t size, const uint8_t git_id[GIT_OID_RAWSZ]) {
+    int code = pack_type_code(type);
+    if (!w || code < 0) return -1;
+    if (git_pack_writer_has(w, git_id)) return 0;
+
+    long index = new_entry(w, git_id);
+    if (index < 0) return -1;
+    return write_entry(w, (size_t)index, code, content, size, 0);
+}
+
+// Try every candidate base and keep the smallest delta, then deflate
+// whichever form will be written (runs on the pool)
+static void encode_pending(void* ctx, size_t i) {
+    pending_delta_t* job = &((pending_delta_t*)ctx)[i];
+
+    // Not worth it unless the delta is well under half the blob
+    size_t limit = job->size / 2 > 20 ? job->size / 2 - 20 : 0;
+    for (size_t b = 0; b < job->base_count && limit > 0; b++) {
+        size_t base_size;
+        char base_type[16];
+        char* base = load_object(&job->bases[b].avc_oid, &base_size, base_type);
+        if (!base) continue;
+
+        size_t delta_size;
+        unsigned char* delta = git_delta_create((const unsigned char*)base, base_size,
+                                                (const unsigned char*)job->content, job->size,
+                                                limit, &delta_size);
+        free(base);
+        if (!delta) continue;
+
+        free(job->delta);
+        job->delta = delta;
+        job->delta_size = delta_size;
+        job->delta_base = job->base_entries[b];
+        limit = delta_size - 1;
+    }
+
+    if (job->delta) {
+        job->packed = deflate_payload(job->delta, job->delta_size, &job->packed_size);
+    } else {
+        job->packed = deflate_payload(job->content, job->size, &job->packed_size);
+    }
+}
+
+// Encode queued objects in parallel, then write them in queue order so
+// every base lands in the file before the deltas that point back at it
+static int flush_pending(git_pack_writer_t* w) {
+    if (w->pending_count == 0) return 0;
+    thread_pool_parallel_for(w->pending_count, encode_pending, w->pending);
+
+    int result = 0;
+    for (size_t i = 0; i < w->pending_count; i++) {
+        pending_delta_t* job = &w->pending[i];
+        int code = job->delta ? GIT_PACK_OFS_DELTA : job->code;
+        const void* data = job->delta ? (const void*)job->delta : job->content;
+        size_t size = job->delta ? job->delta_size : job->size;
+        w->entries[job->entry].depth = job->delta ? w->entries[job->delta_base].depth + 1 : 0;
+        if (result == 0 && job->packed) {
+            uint32_t* crc = &w->entries[job->entry].crc;
+            result = write_header(w, job->entry, code, size, job->delta_base);
+            if (result == 0) result = pack_write(w, job->packed, job->packed_size, crc);
+        } else if (result == 0) {
+            result = write_entry(w, job->entry, code, data, size, job->delta_base);
+        }
+        free(job->packed);
+        free(job->delta);
+        free(job->content);
+    }
+    w->pending_count = 0;
+    w->pending_bytes = 0;
+    return result;
+}
+
+// Queue an object for flush_pending, keeping the usable delta bases
+static int queue_object(git_pack_writer_t* w, int code, char* content, size_t size,
+                        const uint8_t git_id[GIT_OID_RAWSZ],
+                        const git_pack_base_t* bases, size_t base_count) {
+    if (!w || code < 0) {
+        free(content);
+        return -1;
+    }
+    if (git_pack_writer_has(w, git_id)) {
+        free(content);
+        return 0;
+    }
+
+    // Keep bases in this pack whose chains still have room
+    pending_delta_t* job = &w->pending[w->pending_count];
+    job->base_count = 0;
+    uint32_t depth = 0;
+    for (size_t b = 0; b < base_count && job->base_count < (size_t)w->window; b++) {
+        if (size > PACK_DELTA_MAX_SIZE) break;
+        long base = find_entry(w, bases[b].git_id);
+        if (base < 0 || w->entries[base].depth >= (uint32_t)w->depth) continue;
+        int seen = 0;
+        for (size_t k = 0; k < job->base_count; k++) seen |= job->base_entries[k] == (size_t)base;
+        if (seen) continue;
+        job->bases[job->base_count] = bases[b];
+        job->base_entries[job->base_count++] = (size_t)base;
+        if (w->entries[base].depth + 1 > depth) depth = w->entries[base].depth + 1;
+    }
+
+    long index = new_entry(w, git_id);
+    if (index < 0) {
+        free(content);
+        return -1;
+    }
+
+    if (job->base_count == 0 && size > PACK_QUEUE_MAX_SIZE) {
+        int result = write_entry(w, (size_t)index, code, content, size, 0);
+        free(content);
+        return result;
+    }
+
+    w->entries[index].depth = depth;
+    job->entry = (size_t)index;
+    job->code = code;
+    job->content = content;
+    job->size = size;
+    job->delta = NULL;
+    job->delta_base = 0;
+    job->packed = NULL;
+    w->pending_count++;
+    w->pending_bytes += size;
+    if (w->pending_count == PACK_DELTA_BATCH || w->pending_bytes >= PACK_DELTA_BATCH_BYTES) {
+        return flush_pending(w);
+    }
+    return 0;
+}
+
+int git_pack_writer_add_delta(git_pack_writer_t* w, char* content, size_t size,
+                              const uint8_t git_id[GIT_OID_RAWSZ],
+                              const git_pack_base_t* bases, size_t base_count) {
+    return queue_object(w, GIT_PACK_BLOB, content, size, git_id, bases, base_count);
+}
+
+int git_pack_writer_queue(git_pack_writer_t* w, const char* type, char* content, size_t size,
+                          const uint8_t git_id[GIT_OID_RAWSZ]) {
+    return queue_object(w, pack_type_code(type), content, size, git_id, NULL, 0);
+}
+
+static void free_writer(git_pack_writer_t* w) {
+    for (size_t i = 0; i < w->pending_count; i++) {
+        free(w->pending[i].content);
+        free(w->pending[i].delta);
+        free(w->pending[i].packed);
+    }
+    free(w->pending);
+    free(w->entries);
+    free(w->slots);
+    free(w->zbuf);
+    free(w);
+}
+
+void git_pack_writer_abort(git_pack_writer_t* w) {
+    if (!w) return;
+    if (w->file) fclose(w->file);
+    unlink(w->tmp_path);
+    free_writer(w);
+}
+
+static int compare_entry_ids(const void* a, const void* b) {
+    return memcmp(((const pack_entry_t*)a)->id, ((const pack_entry_t*)b)->id, GIT_OID_RAWSZ);
+}
+
+// Buffered index output that keeps the running SHA-1 for the trailer
+typedef struct {
+    FILE* file;
+    git_sha1_t sha;
+    int failed;
+} idx_out_t;
+
+static void idx_write(idx_out_t* out, const void* data, size_t len) {
+    git_sha1_update(&out->sha, data, len);
+    if (fwrite(data, 1, len, out->file) != len) out->failed = 1;
+}
+
+static void idx_write_u32(idx_out_t* out, uint32_t value) {
+    uint32_t be = htonl(value);
+    idx_write(out, &be, 4);
+}
+
+static int write_index(const char* path, pack_entry_t* entries, size_t count,
+                       const uint8_t pack_sha[GIT_OID_RAWSZ]) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0444);
+    if (fd == -1) return -1;
+    idx_out_t out = { fdopen(fd, "wb"), {0}, 0 };
+    if (!out.file) {
+        close(fd);
+        return -1;
+    }
+    setvbuf(out.file, NULL, _IOFBF, PACK_IO_BUFFER);
+    if (git_sha1_init(&out.sha) != 0) out.failed = 1;
+
+    idx_write(&out, IDX_SIGNATURE, 4);
+    idx_write_u32(&out, IDX_VERSION);
+
+    size_t at = 0;
+    for (int byte = 0; byte < 256; byte++) {
+        while (at < count && entries[at].id[0] == byte) at++;
+        idx_write_u32(&out, (uint32_t)at);
+    }
+    for (size_t i = 0; i < count; i++) idx_write(&out, entries[i].id, GIT_OID_RAWSZ);
+    for (size_t i = 0; i < count; i++) idx_write_u32(&out, entries[i].crc);
+
+    // Offsets past 2 GiB go to a 64-bit table referenced from the 32-bit one
+    uint32_t large = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].offset < IDX_LARGE_OFFSET) {
+            idx_write_u32(&out, (uint32_t)entries[i].offset);
+        } else {
+            idx_write_u32(&out, IDX_LARGE_OFFSET | large++);
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].offset >= IDX_LARGE_OFFSET) {
+            idx_write_u32(&out, (uint32_t)(entries[i].offset >> 32));
+            idx_write_u32(&out, (uint32_t)entries[i].offset);
+        }
+    }
+
+    idx_write(&out, pack_sha, GIT_OID_RAWSZ);
+    uint8_t idx_sha[GIT_OID_RAWSZ];
+    git_sha1_final(&out.sha, idx_sha);
+    if (fwrite(idx_sha, 1, GIT_OID_RAWSZ, out.file) != GIT_OID_RAWSZ) out.failed = 1;
+
+    if (fclose(out.file) != 0 || out.failed) {
+        unlink(path);
+        return -1;
+    }
+    return 0;
+}
+
+int git_pack_writer_finish(git_pack_writer_t* w, char name_out[GIT_OID_HEXSZ + 1]) {
+    name_out[0] = '\0';
+    if (!w) return -1;
+    if (w->count == 0) {
+        git_pack_writer_abort(w);
+        return 0;
+    }
+    if (flush_pending(w) != 0) {
+        git_pack_writer_abort(w);
+        return -1;
+    }
+
+    // Patch the object count, then checksum the whole file for the trailer
+    uint32_t count = htonl((uint32_t)w->count);
+    if (fseeko(w->file, 8, SEEK_SET) != 0 || fwrite(&count, 1, 4, w->file) != 4 ||
+        fflush(w->file) != 0 || fseeko(w->file, 0, SEEK_SET) != 0) {
+        git_pack_writer_abort(w);
+        return -1;
+    }
+    git_sha1_t sha;
+    int failed = git_sha1_init(&sha) != 0;
+    size_t n;
+    while ((n = fread(w->zbuf, 1, PACK_IO_BUFFER, w->file)) > 0) {
+        git_sha1_update(&sha, w->zbuf, n);
+    }
+    uint8_t pack_sha[GIT_OID_RAWSZ];
+    git_sha1_final(&sha, pack_sha);
+    if (failed || fseeko(w->file, 0, SEEK_END) != 0 ||
+        fwrite(pack_sha, 1, GIT_OID_RAWSZ, w->file) != GIT_OID_RAWSZ ||
+        fflush(w->file) != 0 || fchmod(fileno(w->file), 0444) != 0) {
+        git_pack_writer_abort(w);
+        return -1;
+    }
+    fclose(w->file);
+    w->file = NULL;
+
+    char hex[GIT_OID_HEXSZ + 1];
+    hex_encode(pack_sha, GIT_OID_RAWSZ, hex);
+    char pack_path[PATH_MAX + 64], idx_path[PATH_MAX + 64], idx_tmp[PATH_MAX + 64];
+    snprintf(pack_path, sizeof(pack_path), "%s/pack-%s.pack", w->dir, hex);
+    snprintf(idx_path, sizeof(idx_path), "%s/pack-%s.idx", w->dir, hex);
+    snprintf(idx_tmp, sizeof(idx_tmp), "%s/tmp_idx_%s", w->dir, hex);
+
+    // The pack goes into place first: an .idx without its pack is invalid
+    qsort(w->entries, w->count, sizeof(pack_entry_t), compare_entry_ids);
+    unlink(idx_tmp);
+    int result = -1;
+    if (write_index(idx_tmp, w->entries, w->count, pack_sha) == 0) {
+        if (rename(w->tmp_path, pack_path) == 0 && rename(idx_tmp, idx_path) == 0) {
+            result = 0;
+        }
+    }
+    if (result != 0) {
+        unlink(idx_tmp);
+        unlink(w->tmp_path);
+    } else {
+        snprintf(name_out, GIT_OID_HEXSZ + 1, "%s", hex);
+        if (strcmp(w->dir, GIT_PACK_DIR) == 0) git_pack_forget_indexes();
+    }
+    free_writer(w);
+    return result;
+}
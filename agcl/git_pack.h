@@ -0,0 +1,94 @@
+#ifndef GIT_PACK_H
+#define GIT_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fast_agcl.h"
+
+#define GIT_PACK_DIR ".git/objects/pack"
+
+// Pack object types (the 3-bit type field of each entry header)
+#define GIT_PACK_COMMIT    1
+#define GIT_PACK_TREE      2
+#define GIT_PACK_BLOB      3
+#define GIT_PACK_TAG       4
+#define GIT_PACK_OFS_DELTA 6
+#define GIT_PACK_REF_DELTA 7
+
+// Streams objects into a single .pack under GIT_PACK_DIR and writes its
+// v2 .idx on finish, so git can use the result without repacking. Not
+// thread-safe (delta encoding and deflate of queued objects run on the
+// thread pool internally).
+typedef struct git_pack_writer git_pack_writer_t;
+
+// Start a new pack in a temporary file; NULL on error
+git_pack_writer_t* git_pack_writer_open(void);
+
+// Same, in another repository's pack directory (e.g. "<bare>/objects/pack")
+git_pack_writer_t* git_pack_writer_open_in(const char* pack_dir);
+
+// Append an object unless this pack already holds it
+int git_pack_writer_add(git_pack_writer_t* writer, const char* type,
+                        const char* content, size_t size, const uint8_t git_id[GIT_OID_RAWSZ]);
+
+// Like git_pack_writer_add, but takes ownership of the malloc'ed content and
+// deflates it on the thread pool with the next batch of queued objects.
+// Queued objects are written in the order they were added.
+int git_pack_writer_queue(git_pack_writer_t* writer, const char* type, char* content, size_t size,
+                          const uint8_t git_id[GIT_OID_RAWSZ]);
+
+// Delta settings: candidate bases tried per object, and the longest delta
+// chain allowed. A window of 0 turns deltas off.
+#define GIT_PACK_DEFAULT_WINDOW 10
+#define GIT_PACK_DEFAULT_DEPTH 50
+#define GIT_PACK_MAX_WINDOW 64
+
+// A possible delta base: an object already added to this pack, and the AVC
+// object holding the same content (its bytes are read through load_object)
+typedef struct {
+    uint8_t git_id[GIT_OID_RAWSZ];
+    avc_oid_t avc_oid;
+} git_pack_base_t;
+
+// Configure deltas (defaults: GIT_PACK_DEFAULT_WINDOW/DEPTH)
+void git_pack_writer_set_delta(git_pack_writer_t* writer, int window, int depth);
+
+// Append a blob, stored as an OFS_DELTA against the best of `bases` when
+// that is clearly smaller. Bases not in this pack or already at the depth
+// limit are ignored. Takes ownership of the malloc'ed content. Queued like
+// git_pack_writer_queue; the delta search runs in the same parallel pass.
+int git_pack_writer_add_delta(git_pack_writer_t* writer, char* content, size_t size,
+                              const uint8_t git_id[GIT_OID_RAWSZ],
+                              const git_pack_base_t* bases, size_t base_count);
+
+// Nonzero if the object was added to this pack
+int git_pack_writer_has(const git_pack_writer_t* writer, const uint8_t git_id[GIT_OID_RAWSZ]);
+
+// Number of objects added so far
+size_t git_pack_writer_count(const git_pack_writer_t* writer);
+
+// Write the trailer and index and move both into place as
+// pack-<checksum>.{pack,idx}. An empty pack is discarded and name_out is
+// set to "". Frees the writer either way.
+int git_pack_writer_finish(git_pack_writer_t* writer, char name_out[GIT_OID_HEXSZ + 1]);
+
+// Drop the pack being written and free the writer
+void git_pack_writer_abort(git_pack_writer_t* writer);
+
+// Reading: the .idx files in GIT_PACK_DIR (or its multi-pack-index) and
+// their packs are mapped on first use. Lookups and reads are thread-safe;
+// recently used delta bases are kept in a shared cache.
+
+// Nonzero if any pack in GIT_PACK_DIR holds the object
+int git_pack_has_object(const uint8_t git_id[GIT_OID_RAWSZ]);
+
+// Read a packed object, resolving OFS_DELTA/REF_DELTA chains. Returns the
+// malloc'ed content (NUL-terminated past size_out) and its type in type_out
+// (at least 16 bytes), or NULL if no pack holds it or it is corrupt.
+char* git_pack_read_object(const uint8_t git_id[GIT_OID_RAWSZ], size_t* size_out, char* type_out);
+
+// Make the next lookup rescan GIT_PACK_DIR. Reads already in progress keep
+// the packs they started with, which are unmapped when the last one ends.
+void git_pack_forget_indexes(void);
+
+#endif // GIT_PACK_H
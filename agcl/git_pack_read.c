@@ -0,0 +1,665 @@
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+#include "git_pack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+#include "git_delta.h"
+#include "git_object.h"
+
+#define PACK_SIGNATURE "PACK"
+#define PACK_HEADER_LEN 12
+#define PACK_TRAILER_LEN GIT_OID_RAWSZ
+#define IDX_SIGNATURE "\377tOc"
+#define IDX_VERSION 2
+#define IDX_HEADER_LEN 8
+#define IDX_FANOUT_LEN (256 * 4)
+#define IDX_LARGE_OFFSET 0x80000000u
+
+// multi-pack-index v1: a header, a chunk table, then the chunks
+#define MIDX_FILE GIT_PACK_DIR "/multi-pack-index"
+#define MIDX_SIGNATURE "MIDX"
+#define MIDX_VERSION 1
+#define MIDX_HASH_SHA1 1
+#define MIDX_HEADER_LEN 12
+#define MIDX_CHUNK_ENTRY_LEN 12
+#define MIDX_CHUNK_PACK_NAMES   0x504e414du  // "PNAM"
+#define MIDX_CHUNK_FANOUT       0x4f494446u  // "OIDF"
+#define MIDX_CHUNK_NAMES        0x4f49444cu  // "OIDL"
+#define MIDX_CHUNK_OFFSETS      0x4f4f4646u  // "OOFF"
+#define MIDX_CHUNK_LARGE_OFFSET 0x4c4f4646u  // "LOFF"
+
+// Longest delta chain followed; also stops REF_DELTA cycles in bad packs
+#define PACK_MAX_CHAIN 10000
+
+// Recently used delta bases, like git's core.deltaBaseCacheLimit
+#define BASE_CACHE_SLOTS 1024
+#define BASE_CACHE_LIMIT (96 * 1024 * 1024)
+
+// zlib counts in uInt, so large buffers are fed in slices
+#define INFLATE_SLICE (1u << 30)
+
+typedef struct {
+    const unsigned char* map;  // The .pack
+    size_t size;
+    const unsigned char* idx;  // Its .idx, or NULL when the multi-pack-index covers it
+    size_t idx_size;
+    uint32_t count;
+} pack_file_t;
+
+typedef struct {
+    const unsigned char* map;
+    size_t size;
+    uint32_t count;
+    const unsigned char* fanout;
+    const unsigned char* names;
+    const unsigned char* offsets;
+    const unsigned char* large;
+    size_t large_count;
+    const char* pack_names;    // NUL-separated .idx names
+    size_t pack_names_len;
+    uint32_t pack_count;
+    size_t* packs;             // Pack id -> g_packs index, SIZE_MAX if unusable
+} midx_t;
+
+// The packs mapped by one scan of GIT_PACK_DIR. Readers hold a reference
+// while they use its maps; a rescan publishes a new set and the old one is
+// unmapped when its last reader lets go.
+typedef struct {
+    pack_file_t* packs;
+    size_t pack_count;
+    midx_t midx;
+    uint64_t generation;       // Distinguishes pack indexes of earlier sets in the cache
+    size_t users;              // Readers, plus one while current; under g_pack_lock
+} pack_set_t;
+
+typedef struct {
+    uint64_t generation;
+    size_t pack;
+    uint64_t offset;
+    char* data;
+    size_t size;
+    int type;
+    uint64_t used;
+} base_cache_entry_t;
+
+// A delta entry waiting for its base to be read
+typedef struct {
+    size_t pack;
+    uint64_t offset;
+    uint64_t data;             // Start of the deflated delta
+    size_t size;               // Inflated delta size
+} chain_link_t;
+
+static pthread_mutex_t g_pack_lock = PTHREAD_MUTEX_INITIALIZER;
+static pack_set_t* g_packs = NULL;   // Current set, NULL until first use
+static uint64_t g_pack_generation = 0;
+
+static pthread_mutex_t g_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static base_cache_entry_t g_cache[BASE_CACHE_SLOTS];
+static size_t g_cache_bytes = 0;
+static uint64_t g_cache_tick = 0;
+
+static const char* g_type_names[] = {NULL, "commit", "tree", "blob", "tag"};
+
+static uint32_t read_be32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+static uint64_t read_be64(const unsigned char* p) {
+    return ((uint64_t)read_be32(p) << 32) | read_be32(p + 4);
+}
+
+static int map_file(const char* path, const unsigned char** map_out, size_t* size_out, size_t min_size) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return -1;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < min_size) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    *map_out = map;
+    *size_out = (size_t)st.st_size;
+    return 0;
+}
+
+// Map pack-<sha>.pack given its .idx name; returns its index in the set
+static size_t add_pack(pack_set_t* set, const char* idx_name, const unsigned char* idx, size_t idx_size,
+                       uint32_t count) {
+    size_t len = strlen(idx_name);
+    if (len < 4 || strcmp(idx_name + len - 4, ".idx") != 0) return SIZE_MAX;
+
+    char path[512];
+    snprintf(path, sizeof(path), GIT_PACK_DIR "/%.*s.pack", (int)(len - 4), idx_name);
+    pack_file_t pack = {0};
+    if (map_file(path, &pack.map, &pack.size, PACK_HEADER_LEN + PACK_TRAILER_LEN) != 0) return SIZE_MAX;
+    uint32_t version = read_be32(pack.map + 4);
+    if (memcmp(pack.map, PACK_SIGNATURE, 4) != 0 || (version != 2 && version != 3)) {
+        munmap((void*)pack.map, pack.size);
+        return SIZE_MAX;
+    }
+
+    pack_file_t* grown = realloc(set->packs, (set->pack_count + 1) * sizeof(pack_file_t));
+    if (!grown) {
+        munmap((void*)pack.map, pack.size);
+        return SIZE_MAX;
+    }
+    pack.idx = idx;
+    pack.idx_size = idx_size;
+    pack.count = count;
+    set->packs = grown;
+    set->packs[set->pack_count] = pack;
+    return set->pack_count++;
+}
+
+static int map_index(const char* path, const unsigned char** map_out, size_t* size_out, uint32_t* count_out) {
+    const unsigned char* p;
+    size_t size;
+    if (map_file(path, &p, &size, IDX_HEADER_LEN + IDX_FANOUT_LEN + 2 * GIT_OID_RAWSZ) != 0) return -1;
+
+    uint32_t count = read_be32(p + IDX_HEADER_LEN + IDX_FANOUT_LEN - 4);
+    if (memcmp(p, IDX_SIGNATURE, 4) != 0 || read_be32(p + 4) != IDX_VERSION ||
+        size < IDX_HEADER_LEN + IDX_FANOUT_LEN + (size_t)count * (GIT_OID_RAWSZ + 8) + 2 * GIT_OID_RAWSZ) {
+        munmap((void*)p, size);
+        return -1;
+    }
+    *map_out = p;
+    *size_out = size;
+    *count_out = count;
+    return 0;
+}
+
+static int midx_lists(const midx_t* midx, const char* idx_name) {
+    const char* name = midx->pack_names;
+    const char* end = name + midx->pack_names_len;
+    for (uint32_t i = 0; i < midx->pack_count && name < end; i++) {
+        if (strcmp(name, idx_name) == 0) return midx->packs[i] != SIZE_MAX;
+        name += strlen(name) + 1;
+    }
+    return 0;
+}
+
+static void load_midx(pack_set_t* set) {
+    midx_t* midx = &set->midx;
+    memset(midx, 0, sizeof(*midx));
+    const unsigned char* p;
+    size_t size;
+    if (map_file(MIDX_FILE, &p, &size, MIDX_HEADER_LEN + MIDX_CHUNK_ENTRY_LEN) != 0) return;
+
+    // Incremental chains (a base count above zero) are not supported
+    unsigned chunks = p[6];
+    midx->map = p;
+    midx->size = size;
+    midx->pack_count = read_be32(p + 8);
+    if (memcmp(p, MIDX_SIGNATURE, 4) != 0 || p[4] != MIDX_VERSION || p[5] != MIDX_HASH_SHA1 ||
+        p[7] != 0 || size < MIDX_HEADER_LEN + (chunks + 1) * MIDX_CHUNK_ENTRY_LEN + GIT_OID_RAWSZ) {
+        munmap((void*)p, size);
+        memset(midx, 0, sizeof(*midx));
+        return;
+    }
+
+    size_t names_len = 0, offsets_len = 0, large_len = 0, fanout_len = 0;
+    for (unsigned i = 0; i < chunks; i++) {
+        const unsigned char* entry = p + MIDX_HEADER_LEN + i * MIDX_CHUNK_ENTRY_LEN;
+        uint64_t start = read_be64(entry + 4);
+        uint64_t end = read_be64(entry + MIDX_CHUNK_ENTRY_LEN + 4);
+        if (start > end || end > size) continue;
+        const unsigned char* chunk = p + start;
+        size_t len = (size_t)(end - start);
+        switch (read_be32(entry)) {
+        case MIDX_CHUNK_PACK_NAMES:   midx->pack_names = (const char*)chunk; midx->pack_names_len = len; break;
+        case MIDX_CHUNK_FANOUT:       midx->fanout = chunk; fanout_len = len; break;
+        case MIDX_CHUNK_NAMES:        midx->names = chunk; names_len = len; break;
+        case MIDX_CHUNK_OFFSETS:      midx->offsets = chunk; offsets_len = len; break;
+        case MIDX_CHUNK_LARGE_OFFSET: midx->large = chunk; large_len = len; break;
+        }
+    }
+    if (midx->fanout && fanout_len >= IDX_FANOUT_LEN) {
+        midx->count = read_be32(midx->fanout + IDX_FANOUT_LEN - 4);
+    }
+    midx->large_count = large_len / 8;
+    if (!midx->pack_names || !midx->fanout || fanout_len < IDX_FANOUT_LEN || !midx->names ||
+        !midx->offsets || names_len < (size_t)midx->count * GIT_OID_RAWSZ ||
+        offsets_len < (size_t)midx->count * 8 ||
+        memchr(midx->pack_names, '\0', midx->pack_names_len) == NULL) {
+        munmap((void*)p, size);
+        memset(midx, 0, sizeof(*midx));
+        return;
+    }
+
+    midx->packs = malloc(midx->pack_count * sizeof(size_t));
+    if (!midx->packs) {
+        munmap((void*)p, size);
+        memset(midx, 0, sizeof(*midx));
+        return;
+    }
+    const char* name = midx->pack_names;
+    const char* names_end = name + midx->pack_names_len;
+    for (uint32_t i = 0; i < midx->pack_count; i++) {
+        midx->packs[i] = SIZE_MAX;
+        if (name >= names_end || !memchr(name, '\0', (size_t)(names_end - name))) continue;
+        midx->packs[i] = add_pack(set, name, NULL, 0, 0);
+        name += strlen(name) + 1;
+    }
+}
+
+static pack_set_t* load_packs(void) {
+    pack_set_t* set = calloc(1, sizeof(pack_set_t));
+    if (!set) return NULL;
+    set->generation = ++g_pack_generation;
+    load_midx(set);
+
+    DIR* dir = opendir(GIT_PACK_DIR);
+    if (!dir) return set;
+
+    // Packs the multi-pack-index already covers need no .idx of their own
+    struct dirent* e;
+    while ((e = readdir(dir))) {
+        size_t len = strlen(e->d_name);
+        if (len < 4 || strcmp(e->d_name + len - 4, ".idx") != 0 || midx_lists(&set->midx, e->d_name)) continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), GIT_PACK_DIR "/%s", e->d_name);
+        const unsigned char* idx;
+        size_t idx_size;
+        uint32_t count;
+        if (map_index(path, &idx, &idx_size, &count) != 0) continue;
+        if (add_pack(set, e->d_name, idx, idx_size, count) == SIZE_MAX) {
+            munmap((void*)idx, idx_size);
+        }
+    }
+    closedir(dir);
+    return set;
+}
+
+static void unmap_packs(pack_set_t* set) {
+    for (size_t i = 0; i < set->pack_count; i++) {
+        munmap((void*)set->packs[i].map, set->packs[i].size);
+        if (set->packs[i].idx) munmap((void*)set->packs[i].idx, set->packs[i].idx_size);
+    }
+    free(set->packs);
+    if (set->midx.map) munmap((void*)set->midx.map, set->midx.size);
+    free(set->midx.packs);
+    free(set);
+}
+
+// The current set, scanned on first use, with a reference for the caller
+static pack_set_t* acquire_packs(void) {
+    pthread_mutex_lock(&g_pack_lock);
+    if (!g_packs && (g_packs = load_packs()) != NULL) g_packs->users = 1;
+    pack_set_t* set = g_packs;
+    if (set) set->users++;
+    pthread_mutex_unlock(&g_pack_lock);
+    return set;
+}
+
+static void release_packs(pack_set_t* set) {
+    pthread_mutex_lock(&g_pack_lock);
+    int last = --set->users == 0;
+    pthread_mutex_unlock(&g_pack_lock);
+    if (last) unmap_packs(set);
+}
+
+// Binary search within the fanout bucket of the first byte
+static int find_name(const unsigned char* fanout, const unsigned char* names, uint32_t count,
+                     const uint8_t id[GIT_OID_RAWSZ], uint32_t* pos_out) {
+    uint32_t lo = id[0] ? read_be32(fanout + (id[0] - 1) * 4) : 0;
+    uint32_t hi = read_be32(fanout + id[0] * 4);
+    if (hi > count) hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(names + (size_t)mid * GIT_OID_RAWSZ, id, GIT_OID_RAWSZ);
+        if (cmp == 0) {
+            *pos_out = mid;
+            return 0;
+        }
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return -1;
+}
+
+static int find_in_index(const pack_file_t* pack, const uint8_t id[GIT_OID_RAWSZ], uint64_t* offset_out) {
+    const unsigned char* fanout = pack->idx + IDX_HEADER_LEN;
+    const unsigned char* names = fanout + IDX_FANOUT_LEN;
+    uint32_t pos;
+    if (find_name(fanout, names, pack->count, id, &pos) != 0) return -1;
+
+    // Name table, CRC table, then 32-bit offsets and the 64-bit overflow
+    const unsigned char* offsets = names + (size_t)pack->count * (GIT_OID_RAWSZ + 4);
+    const unsigned char* large = offsets + (size_t)pack->count * 4;
+    uint32_t offset = read_be32(offsets + (size_t)pos * 4);
+    if (!(offset & IDX_LARGE_OFFSET)) {
+        *offset_out = offset;
+        return 0;
+    }
+    size_t slot = offset & ~IDX_LARGE_OFFSET;
+    if ((size_t)(large - pack->idx) + (slot + 1) * 8 > pack->idx_size - 2 * GIT_OID_RAWSZ) return -1;
+    *offset_out = read_be64(large + slot * 8);
+    return 0;
+}
+
+static int find_in_midx(const midx_t* midx, const uint8_t id[GIT_OID_RAWSZ], size_t* pack_out,
+                        uint64_t* offset_out) {
+    uint32_t pos;
+    if (!midx->map || find_name(midx->fanout, midx->names, midx->count, id, &pos) != 0) return -1;
+
+    const unsigned char* entry = midx->offsets + (size_t)pos * 8;
+    uint32_t pack_id = read_be32(entry);
+    uint32_t offset = read_be32(entry + 4);
+    if (pack_id >= midx->pack_count || midx->packs[pack_id] == SIZE_MAX) return -1;
+    if (offset & IDX_LARGE_OFFSET) {
+        size_t slot = offset & ~IDX_LARGE_OFFSET;
+        if (slot >= midx->large_count) return -1;
+        *offset_out = read_be64(midx->large + slot * 8);
+    } else {
+        *offset_out = offset;
+    }
+    *pack_out = midx->packs[pack_id];
+    return 0;
+}
+
+// Locate an object in a set; the set never changes once published
+static int locate(const pack_set_t* set, const uint8_t id[GIT_OID_RAWSZ], size_t* pack_out,
+                  uint64_t* offset_out) {
+    int result = find_in_midx(&set->midx, id, pack_out, offset_out);
+    for (size_t i = 0; i < set->pack_count && result != 0; i++) {
+        if (set->packs[i].idx && find_in_index(&set->packs[i], id, offset_out) == 0) {
+            *pack_out = i;
+            result = 0;
+        }
+    }
+    return result;
+}
+
+// Entry header: 3-bit type and a varint of the inflated size
+static int parse_entry(const pack_file_t* pack, uint64_t offset, int* type_out,
+                       size_t* size_out, uint64_t* data_out) {
+    uint64_t end = pack->size - PACK_TRAILER_LEN;
+    if (offset < PACK_HEADER_LEN || offset >= end) return -1;
+
+    unsigned char c = pack->map[offset++];
+    uint64_t size = c & 0x0f;
+    int shift = 4;
+    *type_out = (c >> 4) & 7;
+    while (c & 0x80) {
+        if (offset >= end || shift > 57) return -1;
+        c = pack->map[offset++];
+        size |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    }
+    if (size > SIZE_MAX - 1) return -1;
+    *size_out = (size_t)size;
+    *data_out = offset;
+    return 0;
+}
+
+// OFS_DELTA base: a big-endian varint where each continuation adds one
+static int parse_ofs_base(const pack_file_t* pack, uint64_t* pos, uint64_t entry_offset, uint64_t* base_out) {
+    uint64_t end = pack->size - PACK_TRAILER_LEN;
+    if (*pos >= end) return -1;
+    unsigned char c = pack->map[(*pos)++];
+    uint64_t distance = c & 0x7f;
+    while (c & 0x80) {
+        if (*pos >= end || distance >> 56) return -1;
+        c = pack->map[(*pos)++];
+        distance = ((distance + 1) << 7) | (c & 0x7f);
+    }
+    if (distance == 0 || distance > entry_offset) return -1;
+    *base_out = entry_offset - distance;
+    return 0;
+}
+
+// Inflate exactly size bytes from the mapped pack (plus a NUL past the end)
+static char* inflate_at(const pack_file_t* pack, uint64_t offset, size_t size) {
+    char* out = malloc(size + 1);
+    if (!out) return NULL;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK) {
+        free(out);
+        return NULL;
+    }
+
+    const unsigned char* in = pack->map + offset;
+    size_t in_left = pack->size - PACK_TRAILER_LEN - offset;
+    size_t out_len = 0;
+    unsigned char spare;  // Catches streams longer than the header said
+    int ret = Z_OK;
+    while (ret == Z_OK) {
+        uInt in_slice = in_left > INFLATE_SLICE ? INFLATE_SLICE : (uInt)in_left;
+        size_t out_left = size - out_len;
+        uInt out_slice = out_left > INFLATE_SLICE ? INFLATE_SLICE : (uInt)out_left;
+        zs.next_in = (Bytef*)in;
+        zs.avail_in = in_slice;
+        zs.next_out = out_slice ? (Bytef*)out + out_len : &spare;
+        zs.avail_out = out_slice ? out_slice : 1;
+        uInt avail_out = zs.avail_out;
+
+        ret = inflate(&zs, Z_NO_FLUSH);
+        in += in_slice - zs.avail_in;
+        in_left -= in_slice - zs.avail_in;
+        size_t produced = avail_out - zs.avail_out;
+        if (!out_slice && produced) ret = Z_DATA_ERROR;
+        out_len += out_slice ? produced : 0;
+    }
+    inflateEnd(&zs);
+
+    if (ret != Z_STREAM_END || out_len != size) {
+        free(out);
+        return NULL;
+    }
+    out[size] = '\0';
+    return out;
+}
+
+static size_t cache_slot(size_t pack, uint64_t offset) {
+    return (size_t)(((offset ^ ((uint64_t)pack << 48)) * 0x9e3779b97f4a7c15ull) >> 54) % BASE_CACHE_SLOTS;
+}
+
+static void cache_evict(base_cache_entry_t* e) {
+    g_cache_bytes -= e->size;
+    free(e->data);
+    e->data = NULL;
+    e->size = 0;
+}
+
+static int cache_holds(const base_cache_entry_t* e, const pack_set_t* set, size_t pack, uint64_t offset) {
+    return e->data && e->generation == set->generation && e->pack == pack && e->offset == offset;
+}
+
+// Copy of a cached base, or NULL
+static char* cache_get(const pack_set_t* set, size_t pack, uint64_t offset, size_t* size_out, int* type_out) {
+    char* copy = NULL;
+    pthread_mutex_lock(&g_cache_lock);
+    base_cache_entry_t* e = &g_cache[cache_slot(pack, offset)];
+    if (cache_holds(e, set, pack, offset)) {
+        copy = malloc(e->size + 1);
+        if (copy) {
+            memcpy(copy, e->data, e->size + 1);
+            *size_out = e->size;
+            *type_out = e->type;
+            e->used = ++g_cache_tick;
+        }
+    }
+    pthread_mutex_unlock(&g_cache_lock);
+    return copy;
+}
+
+// Takes ownership of data; the least recently used bases go when over budget
+static void cache_put(const pack_set_t* set, size_t pack, uint64_t offset, char* data, size_t size, int type) {
+    if (size > BASE_CACHE_LIMIT / 4) {
+        free(data);
+        return;
+    }
+    pthread_mutex_lock(&g_cache_lock);
+    base_cache_entry_t* e = &g_cache[cache_slot(pack, offset)];
+    if (cache_holds(e, set, pack, offset)) {
+        e->used = ++g_cache_tick;
+        pthread_mutex_unlock(&g_cache_lock);
+        free(data);
+        return;
+    }
+    if (e->data) cache_evict(e);
+    while (g_cache_bytes + size > BASE_CACHE_LIMIT) {
+        base_cache_entry_t* oldest = NULL;
+        for (size_t i = 0; i < BASE_CACHE_SLOTS; i++) {
+            if (g_cache[i].data && (!oldest || g_cache[i].used < oldest->used)) oldest = &g_cache[i];
+        }
+        if (!oldest) break;
+        cache_evict(oldest);
+    }
+    e->generation = set->generation;
+    e->pack = pack;
+    e->offset = offset;
+    e->data = data;
+    e->size = size;
+    e->type = type;
+    e->used = ++g_cache_tick;
+    g_cache_bytes += size;
+    pthread_mutex_unlock(&g_cache_lock);
+}
+
+static int type_from_name(const char* name) {
+    for (int i = GIT_PACK_COMMIT; i <= GIT_PACK_TAG; i++) {
+        if (strcmp(name, g_type_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Read the object at offset: walk its delta chain down to a full object or
+// a cached base, then apply the deltas back up, caching each base used
+static char* read_packed(const pack_set_t* set, size_t pack, uint64_t offset, size_t* size_out, int* type_out) {
+    chain_link_t* chain = NULL;
+    size_t depth = 0, capacity = 0;
+    char* data = NULL;
+    size_t size = 0;
+    int type = 0;
+    int cacheable = 1;  // Loose REF_DELTA bases are not cached
+
+    while (!data && depth <= PACK_MAX_CHAIN) {
+        data = cache_get(set, pack, offset, &size, &type);
+        if (data) break;
+
+        const pack_file_t* file = &set->packs[pack];
+        int entry_type;
+        size_t entry_size;
+        uint64_t pos;
+        if (parse_entry(file, offset, &entry_type, &entry_size, &pos) != 0) break;
+
+        if (entry_type != GIT_PACK_OFS_DELTA && entry_type != GIT_PACK_REF_DELTA) {
+            if (entry_type < GIT_PACK_COMMIT || entry_type > GIT_PACK_TAG) break;
+            data = inflate_at(file, pos, entry_size);
+            size = entry_size;
+            type = entry_type;
+            break;
+        }
+
+        size_t base_pack = pack;
+        uint64_t base_offset = 0;
+        const uint8_t* base_id = NULL;
+        if (entry_type == GIT_PACK_OFS_DELTA) {
+            if (parse_ofs_base(file, &pos, offset, &base_offset) != 0) break;
+        } else {
+            if (pos + GIT_OID_RAWSZ > file->size - PACK_TRAILER_LEN) break;
+            base_id = file->map + pos;
+            pos += GIT_OID_RAWSZ;
+        }
+
+        if (depth == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            chain_link_t* grown = realloc(chain, capacity * sizeof(chain_link_t));
+            if (!grown) break;
+            chain = grown;
+        }
+        chain[depth++] = (chain_link_t){pack, offset, pos, entry_size};
+
+        if (base_id && locate(set, base_id, &base_pack, &base_offset) != 0) {
+            char type_name[16];
+            data = git_read_loose_object(base_id, &size, type_name);
+            type = data ? type_from_name(type_name) : -1;
+            cacheable = 0;
+            break;
+        }
+        pack = base_pack;
+        offset = base_offset;
+    }
+
+    while (data && type > 0 && depth > 0) {
+        const chain_link_t* link = &chain[--depth];
+        char* delta = inflate_at(&set->packs[link->pack], link->data, link->size);
+        size_t result_size = 0;
+        char* result = delta ? (char*)git_delta_apply((unsigned char*)data, size,
+                                                      (unsigned char*)delta, link->size,
+                                                      &result_size) : NULL;
+        free(delta);
+        if (cacheable) cache_put(set, pack, offset, data, size, type);
+        else free(data);
+        cacheable = 1;
+        data = result;
+        size = result_size;
+        pack = link->pack;
+        offset = link->offset;
+    }
+    free(chain);
+
+    if (!data || type <= 0 || depth > 0) {
+        free(data);
+        return NULL;
+    }
+    *size_out = size;
+    *type_out = type;
+    return data;
+}
+
+int git_pack_has_object(const uint8_t git_id[GIT_OID_RAWSZ]) {
+    pack_set_t* set = acquire_packs();
+    if (!set) return 0;
+    size_t pack;
+    uint64_t offset;
+    int found = locate(set, git_id, &pack, &offset) == 0;
+    release_packs(set);
+    return found;
+}
+
+char* git_pack_read_object(const uint8_t git_id[GIT_OID_RAWSZ], size_t* size_out, char* type_out) {
+    pack_set_t* set = acquire_packs();
+    if (!set) return NULL;
+    size_t pack;
+    uint64_t offset;
+    int type;
+    char* content = locate(set, git_id, &pack, &offset) == 0 ? read_packed(set, pack, offset, size_out, &type)
+                                                              : NULL;
+    if (content) snprintf(type_out, 16, "%s", g_type_names[type]);
+    release_packs(set);
+    return content;
+}
+
+void git_pack_forget_indexes(void) {
+    pthread_mutex_lock(&g_pack_lock);
+    pack_set_t* set = g_packs;
+    g_packs = NULL;
+    pthread_mutex_unlock(&g_pack_lock);
+    if (set) release_packs(set);
+
+    // Bases of the old set can no longer be hit; free their memory
+    pthread_mutex_lock(&g_cache_lock);
+    for (size_t i = 0; i < BASE_CACHE_SLOTS; i++) {
+        if (g_cache[i].data) cache_evict(&g_cache[i]);
+    }
+    pthread_mutex_unlock(&g_cache_lock);
+}
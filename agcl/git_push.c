@@ -0,0 +1,678 @@
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE
+#include "git_push.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "git_lfs.h"
+#include "git_object.h"
+#include "git_pack.h"
+#include "objects.h"
+
+#define AVC_MODE_TREE 040000
+
+enum { PUSH_COMMIT, PUSH_TREE, PUSH_BLOB };
+
+// Open-addressing set of Git IDs; the all-zero ID marks an empty slot
+typedef struct {
+    uint8_t (*ids)[GIT_OID_RAWSZ];
+    size_t count;
+    size_t mask;
+} id_set_t;
+
+// An object the target lacks, in the order it goes into the pack
+typedef struct {
+    avc_oid_t avc_oid;
+    avc_oid_t base;            // Blobs: the same path in the parent commit
+    uint8_t git_id[GIT_OID_RAWSZ];
+    uint8_t kind;
+    uint8_t has_base;
+} push_object_t;
+
+// A commit to send, with what its tree is compared against
+typedef struct {
+    avc_oid_t oid;
+    avc_oid_t tree;
+    avc_oid_t parent_tree;     // First parent's tree
+    int has_parent_tree;
+} push_commit_t;
+
+typedef struct {
+    hash_map_t* map;
+    id_set_t seen;             // Sent or known to be in the target
+    id_set_t refs;             // Every ref of the target
+    push_object_t* objects;
+    size_t count;
+    size_t capacity;
+    push_commit_t* commits;    // Newest first
+    size_t commit_count;
+    size_t commit_capacity;
+    int lfs;                   // .git has LFS objects, so blobs may be pointers
+    id_set_t pointers;         // Blobs sent as LFS pointers
+} push_t;
+
+// One "mode name hash" line of an AVC tree, "./" dropped from the name
+typedef struct {
+    unsigned int mode;
+    char name[256];
+    avc_oid_t oid;
+} push_line_t;
+
+static const uint8_t zero_id[GIT_OID_RAWSZ];
+
+static size_t id_slot(const uint8_t id[GIT_OID_RAWSZ], size_t mask) {
+    uint64_t h;
+    memcpy(&h, id, sizeof(h));
+    return (size_t)h & mask;
+}
+
+static int id_set_has(const id_set_t* set, const uint8_t id[GIT_OID_RAWSZ]) {
+    if (!set->ids) return 0;
+    size_t s = id_slot(id, set->mask);
+    while (memcmp(set->ids[s], zero_id, GIT_OID_RAWSZ) != 0) {
+        if (memcmp(set->ids[s], id, GIT_OID_RAWSZ) == 0) return 1;
+        s = (s + 1) & set->mask;
+    }
+    return 0;
+}
+
+// 1 if added, 0 if already there, -1 on error
+static int id_set_add(id_set_t* set, const uint8_t id[GIT_OID_RAWSZ]) {
+    if (memcmp(id, zero_id, GIT_OID_RAWSZ) == 0) return -1;
+    if (!set->ids || (set->count + 1) * 2 > set->mask + 1) {
+        size_t size = set->ids ? (set->mask + 1) * 2 : 1024;
+        uint8_t (*ids)[GIT_OID_RAWSZ] = calloc(size, GIT_OID_RAWSZ);
+        if (!ids) return -1;
+        for (size_t i = 0; set->ids && i <= set->mask; i++) {
+            if (memcmp(set->ids[i], zero_id, GIT_OID_RAWSZ) == 0) continue;
+            size_t s = id_slot(set->ids[i], size - 1);
+            while (memcmp(ids[s], zero_id, GIT_OID_RAWSZ) != 0) s = (s + 1) & (size - 1);
+            memcpy(ids[s], set->ids[i], GIT_OID_RAWSZ);
+        }
+        free(set->ids);
+        set->ids = ids;
+        set->mask = size - 1;
+    }
+    size_t s = id_slot(id, set->mask);
+    while (memcmp(set->ids[s], zero_id, GIT_OID_RAWSZ) != 0) {
+        if (memcmp(set->ids[s], id, GIT_OID_RAWSZ) == 0) return 0;
+        s = (s + 1) & set->mask;
+    }
+    memcpy(set->ids[s], id, GIT_OID_RAWSZ);
+    set->count++;
+    return 1;
+}
+
+// Reading the target's refs
+
+static int parse_ref_value(const char* line, uint8_t id_out[GIT_OID_RAWSZ]) {
+    return strlen(line) >= GIT_OID_HEXSZ && hex_decode(line, id_out, GIT_OID_RAWSZ) == 0 ? 0 : -1;
+}
+
+// Value of ref in the repository at git_dir: its loose file, else its line
+// in packed-refs. 1 if found, 0 if not, -1 if unreadable.
+static int read_ref(const char* git_dir, const char* ref, uint8_t id_out[GIT_OID_RAWSZ]) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", git_dir, ref);
+    FILE* f = fopen(path, "r");
+    if (f) {
+        char line[256] = "";
+        int ok = fgets(line, sizeof(line), f) && parse_ref_value(line, id_out) == 0;
+        fclose(f);
+        return ok ? 1 : -1;
+    }
+    if (errno != ENOENT && errno != ENOTDIR) return -1;
+
+    snprintf(path, sizeof(path), "%s/packed-refs", git_dir);
+    f = fopen(path, "r");
+    if (!f) return errno == ENOENT ? 0 : -1;
+    char line[1024];
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (line[0] == '#' || line[0] == '^' || strlen(line) < GIT_OID_HEXSZ + 2) continue;
+        if (strcmp(line + GIT_OID_HEXSZ + 1, ref) == 0) found = parse_ref_value(line, id_out) == 0 ? 1 : -1;
+    }
+    fclose(f);
+    return found;
+}
+
+// Every loose ref below dir (relative to git_dir) into the set
+static void collect_loose_refs(const char* git_dir, const char* dir, id_set_t* refs) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", git_dir, dir);
+    DIR* d = opendir(path);
+    if (!d) return;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        const char* name = entry->d_name;
+        size_t len = strlen(name);
+        if (name[0] == '.' || (len > 5 && strcmp(name + len - 5, ".lock") == 0)) continue;
+        char ref[PATH_MAX];
+        if (snprintf(ref, sizeof(ref), "%s/%s", dir, name) >= (int)sizeof(ref) ||
+            snprintf(path, sizeof(path), "%s/%s", git_dir, ref) >= (int)sizeof(path)) {
+            continue;
+        }
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        uint8_t id[GIT_OID_RAWSZ];
+        if (S_ISDIR(st.st_mode)) {
+            collect_loose_refs(git_dir, ref, refs);
+        } else if (read_ref(git_dir, ref, id) == 1) {
+            id_set_add(refs, id);
+        }
+    }
+    closedir(d);
+}
+
+static void collect_refs(const char* git_dir, id_set_t* refs) {
+    collect_loose_refs(git_dir, "refs", refs);
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/packed-refs", git_dir);
+    FILE* f = fopen(path, "r");
+    if (!f) return;
+    char line[1024];
+    uint8_t id[GIT_OID_RAWSZ];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] != '#' && line[0] != '^' && parse_ref_value(line, id) == 0) id_set_add(refs, id);
+    }
+    fclose(f);
+}
+
+static int is_dir(const char* git_dir, const char* name) {
+    char path[PATH_MAX];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", git_dir, name);
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Walking the AVC objects
+
+static int add_object(push_t* p, int kind, const avc_oid_t* oid, const uint8_t git_id[GIT_OID_RAWSZ],
+                      const avc_oid_t* base) {
+    if (p->count == p->capacity) {
+        size_t capacity = p->capacity ? p->capacity * 2 : 1024;
+        push_object_t* grown = realloc(p->objects, capacity * sizeof(push_object_t));
+        if (!grown) return -1;
+        p->objects = grown;
+        p->capacity = capacity;
+    }
+    push_object_t* obj = &p->objects[p->count++];
+    memset(obj, 0, sizeof(*obj));
+    obj->avc_oid = *oid;
+    memcpy(obj->git_id, git_id, GIT_OID_RAWSZ);
+    obj->kind = (uint8_t)kind;
+    if (base) {
+        obj->base = *base;
+        obj->has_base = 1;
+    }
+    return 0;
+}
+
+static int compare_lines(const void* a, const void* b) {
+    return strcmp(((const push_line_t*)a)->name, ((const push_line_t*)b)->name);
+}
+
+// Entries of an AVC tree sorted by name; NULL on error
+static push_line_t* load_tree_lines(const avc_oid_t* oid, size_t* count_out) {
+    size_t size;
+    char type[16];
+    char* content = load_object(oid, &size, type);
+    if (!content || strcmp(type, "tree") != 0) {
+        free(content);
+        return NULL;
+    }
+    size_t count = 0, capacity = 16;
+    push_line_t* lines = malloc(capacity * sizeof(push_line_t));
+    char* line = content;
+    while (lines && *line) {
+        char* end = strchr(line, '\n');
+        if (end) *end = '\0';
+
+        push_line_t entry;
+        char name[256], hex[AVC_OID_HEXSZ + 1];
+        if (sscanf(line, "%o %255s %64s", &entry.mode, name, hex) == 3 && oid_from_hex(hex, &entry.oid) == 0) {
+            snprintf(entry.name, sizeof(entry.name), "%s", strncmp(name, "./", 2) == 0 ? name + 2 : name);
+            if (count == capacity) {
+                capacity *= 2;
+                push_line_t* grown = realloc(lines, capacity * sizeof(push_line_t));
+                if (!grown) {
+                    free(lines);
+                    lines = NULL;
+                    break;
+                }
+                lines = grown;
+            }
+            lines[count++] = entry;
+        }
+        if (!end) break;
+        line = end + 1;
+    }
+    free(content);
+    if (lines) qsort(lines, count, sizeof(push_line_t), compare_lines);
+    *count_out = count;
+    return lines;
+}
+
+static int read_commit_tree(const avc_oid_t* commit_oid, avc_oid_t* tree_out) {
+    size_t size;
+    char type[16];
+    char* content = load_object(commit_oid, &size, type);
+    char hex[AVC_OID_HEXSZ + 1];
+    int result = -1;
+    if (content && strcmp(type, "commit") == 0 && sscanf(content, "tree %64s", hex) == 1) {
+        result = oid_from_hex(hex, tree_out);
+    }
+    free(content);
+    return result;
+}
+
+// Mark a tree the target has, and everything below it, as seen
+static void mark_tree(push_t* p, const avc_oid_t* oid) {
+    const uint8_t* git_id = hash_map_get(p->map, oid);
+    if (!git_id || id_set_add(&p->seen, git_id) != 1) return;
+    size_t count;
+    push_line_t* lines = load_tree_lines(oid, &count);
+    for (size_t i = 0; lines && i < count; i++) {
+        if (lines[i].mode == AVC_MODE_TREE) {
+            mark_tree(p, &lines[i].oid);
+        } else {
+            const uint8_t* id = hash_map_get(p->map, &lines[i].oid);
+            if (id) id_set_add(&p->seen, id);
+        }
+    }
+    free(lines);
+}
+
+// Queue a new tree and whatever below it is not seen yet. base is the tree
+// at the same path in the parent commit, for blob delta bases.
+static int walk_tree(push_t* p, const avc_oid_t* oid, const avc_oid_t* base) {
+    const uint8_t* git_id = hash_map_get(p->map, oid);
+    if (!git_id) return -1;
+    int added = id_set_add(&p->seen, git_id);
+    if (added <= 0) return added;
+    if (add_object(p, PUSH_TREE, oid, git_id, NULL) != 0) return -1;
+
+    size_t count, base_count = 0;
+    push_line_t* lines = load_tree_lines(oid, &count);
+    if (!lines) return -1;
+    push_line_t* base_lines = base ? load_tree_lines(base, &base_count) : NULL;
+
+    int result = 0;
+    for (size_t i = 0; i < count && result == 0; i++) {
+        const push_line_t* line = &lines[i];
+        const push_line_t* old = base_lines ? bsearch(line, base_lines, base_count, sizeof(push_line_t),
+                                                      compare_lines) : NULL;
+        int is_tree = line->mode == AVC_MODE_TREE;
+        if (old && ((old->mode == AVC_MODE_TREE) != is_tree || oid_equal(&old->oid, &line->oid))) old = NULL;
+
+        if (is_tree) {
+            result = walk_tree(p, &line->oid, old ? &old->oid : NULL);
+            continue;
+        }
+        const uint8_t* blob_id = hash_map_get(p->map, &line->oid);
+        if (!blob_id) {
+            result = -1;
+        } else if ((added = id_set_add(&p->seen, blob_id)) == 1) {
+            result = add_object(p, PUSH_BLOB, &line->oid, blob_id, old ? &old->oid : NULL);
+        } else {
+            result = added;
+        }
+    }
+    free(lines);
+    free(base_lines);
+    return result;
+}
+
+// Commits from head down to the target's refs; sets *found_old if old_id
+// was one of the commits reached (if not, it may still be an ancestor)
+static int walk_commits(push_t* p, const avc_oid_t* head, const uint8_t old_id[GIT_OID_RAWSZ], int* found_old) {
+    size_t queue_count = 0, queue_capacity = 64, next = 0;
+    avc_oid_t* queue = malloc(queue_capacity * sizeof(avc_oid_t));
+    if (!queue) return -1;
+    queue[queue_count++] = *head;
+
+    int result = 0;
+    while (result == 0 && next < queue_count) {
+        avc_oid_t oid = queue[next++];
+        const uint8_t* git_id = hash_map_get(p->map, &oid);
+        if (!git_id) {
+            char hex[AVC_OID_HEXSZ + 1];
+            oid_to_hex(&oid, hex);
+            fprintf(stderr, "Commit %s has not been synced to Git\n", hex);
+            result = -1;
+            break;
+        }
+        int added = id_set_add(&p->seen, git_id);
+        if (added < 0) result = -1;
+        if (added <= 0) continue;
+
+        // Already in the target: its tree is what new trees are compared with
+        if (id_set_has(&p->refs, git_id)) {
+            if (memcmp(git_id, old_id, GIT_OID_RAWSZ) == 0) *found_old = 1;
+            avc_oid_t tree;
+            if (read_commit_tree(&oid, &tree) == 0) mark_tree(p, &tree);
+            continue;
+        }
+
+        size_t size;
+        char type[16];
+        char* content = load_object(&oid, &size, type);
+        if (!content || strcmp(type, "commit") != 0) {
+            free(content);
+            result = -1;
+            break;
+        }
+        if (p->commit_count == p->commit_capacity) {
+            size_t capacity = p->commit_capacity ? p->commit_capacity * 2 : 64;
+            push_commit_t* grown = realloc(p->commits, capacity * sizeof(push_commit_t));
+            if (!grown) {
+                free(content);
+                result = -1;
+                break;
+            }
+            p->commits = grown;
+            p->commit_capacity = capacity;
+        }
+        push_commit_t* commit = &p->commits[p->commit_count++];
+        memset(commit, 0, sizeof(*commit));
+        commit->oid = oid;
+        result = add_object(p, PUSH_COMMIT, &oid, git_id, NULL);
+
+        int has_tree = 0, first_parent = 1;
+        char* line = content;
+        while (result == 0 && *line && *line != '\n') {
+            char* end = strchr(line, '\n');
+            if (end) *end = '\0';
+            char hex[AVC_OID_HEXSZ + 1];
+            avc_oid_t ref_oid;
+            if (sscanf(line, "tree %64s", hex) == 1 && oid_from_hex(hex, &ref_oid) == 0) {
+                commit->tree = ref_oid;
+                has_tree = 1;
+            } else if (sscanf(line, "parent %64s", hex) == 1 && oid_from_hex(hex, &ref_oid) == 0) {
+                if (first_parent) {
+                    commit->has_parent_tree = read_commit_tree(&ref_oid, &commit->parent_tree) == 0;
+                    first_parent = 0;
+                }
+                if (queue_count == queue_capacity) {
+                    queue_capacity *= 2;
+                    avc_oid_t* grown = realloc(queue, queue_capacity * sizeof(avc_oid_t));
+                    if (!grown) {
+                        result = -1;
+                        break;
+                    }
+                    queue = grown;
+                }
+                queue[queue_count++] = ref_oid;
+            }
+            if (!end) break;
+            line = end + 1;
+        }
+        free(content);
+        if (result == 0 && !has_tree) result = -1;
+    }
+    free(queue);
+    return result;
+}
+
+// 1 if old_id is head or one of its ancestors, 0 if not, -1 on error. Unlike
+// walk_commits this goes past commits the target has: another of its refs
+// may point between old_id and head.
+static int is_ancestor(hash_map_t* map, const avc_oid_t* head, const uint8_t old_id[GIT_OID_RAWSZ]) {
+    avc_oid_t old;
+    if (hash_map_get_avc(map, old_id, &old) != 0) return 0;   // Not synced from here
+
+    size_t queue_count = 0, queue_capacity = 64, next = 0;
+    avc_oid_t* queue = malloc(queue_capacity * sizeof(avc_oid_t));
+    if (!queue) return -1;
+    queue[queue_count++] = *head;
+
+    id_set_t visited = {0};
+    int result = 0;
+    while (result == 0 && next < queue_count) {
+        avc_oid_t oid = queue[next++];
+        if (oid_equal(&oid, &old)) {
+            result = 1;
+            break;
+        }
+        const uint8_t* git_id = hash_map_get(map, &oid);
+        int added = git_id ? id_set_add(&visited, git_id) : -1;
+        if (added < 0) result = -1;
+        if (added <= 0) continue;
+
+        size_t size;
+        char type[16];
+        char* content = load_object(&oid, &size, type);
+        if (!content || strcmp(type, "commit") != 0) {
+            free(content);
+            result = -1;
+            break;
+        }
+        char* line = content;
+        while (result == 0 && *line && *line != '\n') {
+            char* end = strchr(line, '\n');
+            if (end) *end = '\0';
+            char hex[AVC_OID_HEXSZ + 1];
+            avc_oid_t parent;
+            if (sscanf(line, "parent %64s", hex) == 1 && oid_from_hex(hex, &parent) == 0) {
+                if (queue_count == queue_capacity) {
+                    queue_capacity *= 2;
+                    avc_oid_t* grown = realloc(queue, queue_capacity * sizeof(avc_oid_t));
+                    if (!grown) {
+                        result = -1;
+                        break;
+                    }
+                    queue = grown;
+                }
+                queue[queue_count++] = parent;
+            }
+            if (!end) break;
+            line = end + 1;
+        }
+        free(content);
+    }
+    free(visited.ids);
+    free(queue);
+    return result;
+}
+
+// Writing the pack
+
+static int pack_object(push_t* p, git_pack_writer_t* pack, const push_object_t* obj) {
+    size_t size;
+    char type[16];
+    if (obj->kind != PUSH_BLOB) {
+        // Git trees and commits differ from AVC's; .git has them since the sync
+        char* content = git_read_object(obj->git_id, &size, type);
+        if (!content) return -1;
+        return git_pack_writer_queue(pack, type, content, size, obj->git_id);
+    }
+
+    char* content = load_object(&obj->avc_oid, &size, type);
+    if (!content) return -1;
+    if (p->lfs) {
+        // An LFS pointer in Git: sent as is, never as or against a delta
+        uint8_t id[GIT_OID_RAWSZ];
+        git_hash_object("blob", content, size, id);
+        if (memcmp(id, obj->git_id, GIT_OID_RAWSZ) != 0) {
+            free(content);
+            content = git_read_object(obj->git_id, &size, type);
+            if (!content || id_set_add(&p->pointers, obj->git_id) < 0) {
+                free(content);
+                return -1;
+            }
+            return git_pack_writer_queue(pack, "blob", content, size, obj->git_id);
+        }
+    }
+    git_pack_base_t base;
+    size_t base_count = 0;
+    const uint8_t* base_id = obj->has_base ? hash_map_get(p->map, &obj->base) : NULL;
+    if (base_id && id_set_has(&p->pointers, base_id)) base_id = NULL;
+    if (base_id) {
+        memcpy(base.git_id, base_id, GIT_OID_RAWSZ);
+        base.avc_oid = obj->base;
+        base_count = 1;
+    }
+    return git_pack_writer_add_delta(pack, content, size, obj->git_id, &base, base_count);
+}
+
+// Push the pack's bytes to stable storage before a ref points into it
+static void sync_path(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return;
+    fsync(fd);
+    close(fd);
+}
+
+static int write_pack(push_t* p, const char* git_dir, char name_out[GIT_OID_HEXSZ + 1]) {
+    char pack_dir[PATH_MAX];
+    snprintf(pack_dir, sizeof(pack_dir), "%s/objects/pack", git_dir);
+    git_pack_writer_t* pack = git_pack_writer_open_in(pack_dir);
+    if (!pack) return -1;
+    int window = avc_config_get_int("agcl", "deltawindow", GIT_PACK_DEFAULT_WINDOW);
+    int depth = avc_config_get_int("agcl", "deltadepth", GIT_PACK_DEFAULT_DEPTH);
+    git_pack_writer_set_delta(pack, window > GIT_PACK_MAX_WINDOW ? GIT_PACK_MAX_WINDOW : window, depth);
+
+    // Commits, then trees, then blobs from the oldest commit up so that a
+    // blob's parent version is already packed when it is delta-encoded
+    int result = 0;
+    for (int kind = PUSH_COMMIT; kind <= PUSH_BLOB && result == 0; kind++) {
+        for (size_t i = 0; i < p->count && result == 0; i++) {
+            if (p->objects[i].kind == kind) result = pack_object(p, pack, &p->objects[i]);
+        }
+    }
+    if (result != 0) {
+        git_pack_writer_abort(pack);
+        return -1;
+    }
+    if (git_pack_writer_finish(pack, name_out) != 0) return -1;
+    if (name_out[0]) {
+        char path[PATH_MAX + 64];
+        snprintf(path, sizeof(path), "%s/pack-%s.pack", pack_dir, name_out);
+        sync_path(path);
+        snprintf(path, sizeof(path), "%s/pack-%s.idx", pack_dir, name_out);
+        sync_path(path);
+    }
+    return 0;
+}
+
+// Updating the ref
+
+static int make_parent_dirs(const char* git_dir, const char* ref) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", git_dir, ref);
+    for (char* slash = path + strlen(git_dir) + 1; (slash = strchr(slash, '/')) != NULL; slash++) {
+        *slash = '\0';
+        int failed = mkdir(path, 0755) == -1 && errno != EEXIST;
+        *slash = '/';
+        if (failed) return -1;
+    }
+    return 0;
+}
+
+// Compare-and-swap through <ref>.lock, the way git itself updates refs:
+// whoever creates the lock owns the ref until the rename
+static int update_ref(const char* git_dir, const char* ref, const uint8_t old_id[GIT_OID_RAWSZ],
+                      const uint8_t new_id[GIT_OID_RAWSZ]) {
+    char path[PATH_MAX], lock[PATH_MAX + 8];
+    snprintf(path, sizeof(path), "%s/%s", git_dir, ref);
+    snprintf(lock, sizeof(lock), "%s.lock", path);
+    if (make_parent_dirs(git_dir, ref) != 0) return GIT_PUSH_ERROR;
+    int fd = open(lock, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) return errno == EEXIST ? GIT_PUSH_STALE : GIT_PUSH_ERROR;
+
+    uint8_t current[GIT_OID_RAWSZ] = {0};
+    int found = read_ref(git_dir, ref, current);
+    if (found < 0 || memcmp(current, old_id, GIT_OID_RAWSZ) != 0) {
+        close(fd);
+        unlink(lock);
+        return found < 0 ? GIT_PUSH_ERROR : GIT_PUSH_STALE;
+    }
+
+    char line[GIT_OID_HEXSZ + 2];
+    hex_encode(new_id, GIT_OID_RAWSZ, line);
+    line[GIT_OID_HEXSZ] = '\n';
+    line[GIT_OID_HEXSZ + 1] = '\0';
+    int ok = write(fd, line, GIT_OID_HEXSZ + 1) == GIT_OID_HEXSZ + 1 && fsync(fd) == 0;
+    if (close(fd) != 0) ok = 0;
+    if (!ok || rename(lock, path) != 0) {
+        unlink(lock);
+        return GIT_PUSH_ERROR;
+    }
+    return GIT_PUSH_OK;
+}
+
+int git_push_local(hash_map_t* map, const uint8_t git_id[GIT_OID_RAWSZ], const char* target,
+                   const char* ref, int force, git_push_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!is_dir(target, "objects") || !is_dir(target, "refs") || is_dir(target, ".git")) {
+        return GIT_PUSH_NOT_BARE;
+    }
+
+    avc_oid_t head;
+    if (hash_map_get_avc(map, git_id, &head) != 0) return GIT_PUSH_ERROR;
+
+    int found = read_ref(target, ref, stats->old_id);
+    if (found < 0) return GIT_PUSH_ERROR;
+    if (found && memcmp(stats->old_id, git_id, GIT_OID_RAWSZ) == 0) {
+        stats->up_to_date = 1;
+        return GIT_PUSH_OK;
+    }
+
+    push_t p = {.map = map, .lfs = access(GIT_LFS_OBJECTS_DIR, F_OK) == 0};
+    collect_refs(target, &p.refs);
+    int found_old = 0;
+    int result = walk_commits(&p, &head, stats->old_id, &found_old) == 0 ? GIT_PUSH_OK : GIT_PUSH_ERROR;
+    if (result == GIT_PUSH_OK && found && !found_old && !force) {
+        // The walk stops at the first commit any target ref holds, which
+        // may be a descendant of the old value
+        int ancestor = is_ancestor(map, &head, stats->old_id);
+        if (ancestor < 0) result = GIT_PUSH_ERROR;
+        else if (!ancestor) result = GIT_PUSH_NON_FAST_FORWARD;
+    }
+
+    // Oldest commit first, each tree compared with its first parent's
+    for (size_t i = p.commit_count; i > 0 && result == GIT_PUSH_OK; i--) {
+        const push_commit_t* commit = &p.commits[i - 1];
+        if (walk_tree(&p, &commit->tree, commit->has_parent_tree ? &commit->parent_tree : NULL) < 0) {
+            result = GIT_PUSH_ERROR;
+        }
+    }
+
+    if (result == GIT_PUSH_OK) {
+        for (size_t i = 0; i < p.count; i++) {
+            if (p.objects[i].kind == PUSH_COMMIT) stats->commits++;
+            else if (p.objects[i].kind == PUSH_TREE) stats->trees++;
+            else stats->blobs++;
+        }
+        if (write_pack(&p, target, stats->pack_name) != 0) result = GIT_PUSH_ERROR;
+    }
+    // LFS content goes first, so that no clone sees a pointer it cannot resolve
+    if (result == GIT_PUSH_OK && p.pointers.count > 0) {
+        git_lfs_policy_t policy;
+        git_lfs_policy_load(&policy);
+        char objects_dir[PATH_MAX];
+        if (policy.store[0]) snprintf(objects_dir, sizeof(objects_dir), "%s", policy.store);
+        else snprintf(objects_dir, sizeof(objects_dir), "%s/lfs/objects", target);
+        if (git_lfs_push_objects(objects_dir, &stats->lfs_objects) != 0) {
+            fprintf(stderr, "Error: Could not copy LFS objects to %s\n", objects_dir);
+            result = GIT_PUSH_ERROR;
+        }
+    }
+    if (result == GIT_PUSH_OK) result = update_ref(target, ref, stats->old_id, git_id);
+
+    free(p.seen.ids);
+    free(p.refs.ids);
+    free(p.pointers.ids);
+    free(p.objects);
+    free(p.commits);
+    return result;
+}
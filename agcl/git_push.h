@@ -0,0 +1,42 @@
+#ifndef GIT_PUSH_H
+#define GIT_PUSH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fast_agcl.h"
+
+// Push to a bare Git repository on a local or mounted file system without
+// running git. The target's refs (loose and packed) tell which synced
+// commits it already has; the objects reachable from the pushed commit but
+// not from those go into one new pack in its objects/pack, and the ref is
+// then moved with git's own lock-file protocol, only if it still holds the
+// value read at the start.
+
+enum {
+    GIT_PUSH_OK = 0,
+    GIT_PUSH_ERROR = -1,
+    GIT_PUSH_NOT_BARE = -2,      // Target is not a bare repository
+    GIT_PUSH_NON_FAST_FORWARD = -3,
+    GIT_PUSH_STALE = -4,         // The ref moved (or is locked) while pushing
+};
+
+typedef struct {
+    size_t commits;
+    size_t trees;
+    size_t blobs;
+    size_t lfs_objects;          // LFS content copied for pointers sent
+    int up_to_date;              // The ref already held the commit
+    char pack_name[GIT_OID_HEXSZ + 1];  // "" if nothing was sent
+    uint8_t old_id[GIT_OID_RAWSZ];      // Previous value of the ref (zero if new)
+} git_push_stats_t;
+
+// Push the synced commit git_id to ref (e.g. "refs/heads/main") of the bare
+// repository at target. Every object the commit reaches must be in map and
+// in .git. A ref that is not an ancestor of the commit is only replaced
+// with force. The content of LFS pointers sent goes to the lfsstore of
+// .avc/config, or the target's lfs/objects, before the ref moves. Returns
+// GIT_PUSH_OK or one of the errors above.
+int git_push_local(hash_map_t* map, const uint8_t git_id[GIT_OID_RAWSZ], const char* target,
+                   const char* ref, int force, git_push_stats_t* stats);
+
+#endif // GIT_PUSH_H
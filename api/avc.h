@@ -12,6 +12,8 @@
 
 // Constants
 #define AVC_HASH_SIZE 64
+#define AVC_OID_RAWSZ 32
+#define AVC_OID_HEXSZ 64
 #define AVC_MAX_PATH 256
 #define AVC_MAX_MESSAGE 1024
 #define AVC_FAST_INDEX_SIZE 8192
@@ -40,24 +42,42 @@ int cmd_repo_migrate(int argc, char* argv[]);
 // Check if current directory is an AVC repository
 int check_repo(void);
 
+// =============================================================================
+// OBJECT ID API
+// =============================================================================
+
+// Raw 32-byte BLAKE3 object ID; hex only at the I/O edges
+#ifndef AVC_OID_T_DEFINED
+#define AVC_OID_T_DEFINED
+typedef struct {
+    uint8_t bytes[AVC_OID_RAWSZ];
+} avc_oid_t;
+#endif
+
+// Parse a 64-digit hex object ID (-1 if malformed)
+int oid_from_hex(const char* hex, avc_oid_t* oid_out);
+
+// Format an object ID as 64 lowercase hex digits plus NUL
+void oid_to_hex(const avc_oid_t* oid, char hex_out[AVC_OID_HEXSZ + 1]);
+
 // =============================================================================
 // OBJECT STORAGE API
 // =============================================================================
 
 // Store a blob object from a file
-int store_blob_from_file(const char* filepath, char* hash_out);
+int store_blob_from_file(const char* filepath, avc_oid_t* oid_out);
 
 // Store an object with given type and content
-int store_object(const char* type, const char* content, size_t size, char* hash_out);
+int store_object(const char* type, const char* content, size_t size, avc_oid_t* oid_out);
 
-// Load an object by hash
-char* load_object(const char* hash, size_t* size_out, char* type_out);
+// Load an object by ID
+char* load_object(const avc_oid_t* oid, size_t* size_out, char* type_out);
 
 // Enable/disable fast compression mode (level 0)
 void objects_set_fast_mode(int fast);
 
-// Calculate hash of a file using BLAKE3
-int blake3_file_hex(const char* filepath, char hash_out[65]);
+// Calculate the blob ID of a file using BLAKE3
+int blake3_file_oid(const char* filepath, avc_oid_t* oid_out);
 
 
 
@@ -71,11 +91,11 @@ int blake3_file_hex(const char* filepath, char hash_out[65]);
 
 // Transactional index updates (load once, write once)
 int index_load(void);
-int index_upsert_entry(const char* filepath, const char* hash, unsigned int mode, int* unchanged_out);
+int index_upsert_entry(const char* filepath, const avc_oid_t* oid, unsigned int mode, int* unchanged_out);
 int index_commit(void);
 
-// Returns pointer to hash string for given path if present, else NULL
-const char* index_get_hash(const char* filepath);
+// Returns pointer to the object ID for given path if present, else NULL
+const avc_oid_t* index_get_oid(const char* filepath);
 
 
 
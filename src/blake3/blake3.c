@@ -248,6 +248,33 @@ INLINE size_t compress_parents_parallel(const uint8_t *child_chaining_values,
   }
 }
 
+// Optional fork-join backend installed by the embedding application.
+static blake3_join_fn g_join_hook = NULL;
+static size_t g_join_min_len = SIZE_MAX;
+
+void blake3_set_join_hook(blake3_join_fn join, size_t min_subtree_len) {
+  g_join_hook = join;
+  g_join_min_len = min_subtree_len < BLAKE3_CHUNK_LEN ? BLAKE3_CHUNK_LEN
+                                                       : min_subtree_len;
+}
+
+typedef struct {
+  const uint8_t *input;
+  size_t input_len;
+  const uint32_t *key;
+  uint64_t chunk_counter;
+  uint8_t flags;
+  uint8_t *out;
+  size_t n;
+} subtree_job;
+
+static void compress_subtree_job(void *arg) {
+  subtree_job *job = (subtree_job *)arg;
+  job->n = blake3_compress_subtree_wide(job->input, job->input_len, job->key,
+                                        job->chunk_counter, job->flags,
+                                        job->out, true);
+}
+
 // The wide helper function returns (writes out) an array of chaining values
 // and returns the length of that array. The number of chaining values returned
 // is the dynamically detected SIMD degree, at most MAX_SIMD_DEGREE. Or fewer,
@@ -314,11 +341,21 @@ size_t blake3_compress_subtree_wide(const uint8_t *input, size_t input_len,
       // right-hand side
       right_input, right_input_len, right_chunk_counter, right_cvs, &right_n);
 #else
-  left_n = blake3_compress_subtree_wide(
-      input, left_input_len, key, chunk_counter, flags, cv_array, use_tbb);
-  right_n = blake3_compress_subtree_wide(right_input, right_input_len, key,
-                                         right_chunk_counter, flags, right_cvs,
-                                         use_tbb);
+  if (use_tbb && g_join_hook != NULL && right_input_len >= g_join_min_len) {
+    subtree_job left = {input, left_input_len, key, chunk_counter,
+                        flags, cv_array, 0};
+    subtree_job right = {right_input, right_input_len, key, right_chunk_counter,
+                         flags, right_cvs, 0};
+    g_join_hook(compress_subtree_job, &left, &right);
+    left_n = left.n;
+    right_n = right.n;
+  } else {
+    left_n = blake3_compress_subtree_wide(
+        input, left_input_len, key, chunk_counter, flags, cv_array, use_tbb);
+    right_n = blake3_compress_subtree_wide(right_input, right_input_len, key,
+                                           right_chunk_counter, flags, right_cvs,
+                                           use_tbb);
+  }
 #endif // BLAKE3_USE_TBB
 
   // The special case again. If simd_degree=1, then we'll have left_n=1 and
@@ -595,6 +632,182 @@ void blake3_hasher_update_tbb(blake3_hasher *self, const void *input,
 }
 #endif // BLAKE3_USE_TBB
 
+void blake3_hasher_update_parallel(blake3_hasher *self, const void *input,
+                                   size_t input_len) {
+#if defined(BLAKE3_USE_TBB)
+  blake3_hasher_update_tbb(self, input, input_len);
+#else
+  // In non-TBB builds the use_tbb flag enables the join hook instead.
+  blake3_hasher_update_base(self, input, input_len, g_join_hook != NULL);
+#endif
+}
+
+// Messages per hash_many call in blake3_hash_short_many. A multiple of every
+// SIMD degree, so only the last group of each block count has empty lanes.
+#define SHORT_BATCH_LEN 64
+
+// Full blocks before the final (possibly partial) block of a short message.
+INLINE size_t short_prefix_blocks(size_t len) {
+  return len == 0 ? 0 : (len - 1) / BLAKE3_BLOCK_LEN;
+}
+
+static void hash_short_group(const uint8_t *const *batch,
+                             const size_t *batch_idx, size_t n,
+                             size_t prefix_blocks, const size_t *input_lens,
+                             uint8_t *out) {
+  uint8_t cvs[SHORT_BATCH_LEN * BLAKE3_OUT_LEN];
+  if (prefix_blocks > 0) {
+    blake3_hash_many(batch, n, prefix_blocks, IV, 0, false, 0, CHUNK_START, 0,
+                     cvs);
+  }
+
+  // The final block carries CHUNK_END | ROOT and its real length, which
+  // differs per message, so it is compressed one message at a time.
+  size_t offset = prefix_blocks * BLAKE3_BLOCK_LEN;
+  for (size_t j = 0; j < n; j++) {
+    uint32_t cv[8];
+    if (prefix_blocks > 0) {
+      load_key_words(&cvs[j * BLAKE3_OUT_LEN], cv);
+    } else {
+      memcpy(cv, IV, BLAKE3_KEY_LEN);
+    }
+    uint8_t block[BLAKE3_BLOCK_LEN] = {0};
+    size_t last_len = input_lens[batch_idx[j]] - offset;
+    memcpy(block, &batch[j][offset], last_len);
+    uint8_t flags = CHUNK_END | ROOT | (prefix_blocks == 0 ? CHUNK_START : 0);
+    blake3_compress_in_place(cv, block, (uint8_t)last_len, 0, flags);
+    store_cv_words(&out[batch_idx[j] * BLAKE3_OUT_LEN], cv);
+  }
+}
+
+void blake3_hash_short_many(const uint8_t *const *inputs,
+                            const size_t *input_lens, size_t num_inputs,
+                            uint8_t *out) {
+  const uint8_t *batch[SHORT_BATCH_LEN];
+  size_t batch_idx[SHORT_BATCH_LEN];
+
+  // Group messages by block count so every lane in a hash_many call runs
+  // the same number of blocks.
+  for (size_t k = 0; k < BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN; k++) {
+    size_t n = 0;
+    for (size_t i = 0; i < num_inputs; i++) {
+      assert(input_lens[i] <= BLAKE3_CHUNK_LEN);
+      if (short_prefix_blocks(input_lens[i]) != k) {
+        continue;
+      }
+      batch[n] = inputs[i];
+      batch_idx[n] = i;
+      n++;
+      if (n == SHORT_BATCH_LEN) {
+        hash_short_group(batch, batch_idx, n, k, input_lens, out);
+        n = 0;
+      }
+    }
+    if (n > 0) {
+      hash_short_group(batch, batch_idx, n, k, input_lens, out);
+    }
+  }
+}
+
+// Chaining value of a complete, non-root subtree of a power-of-2 number of
+// chunks starting at chunk_counter.
+static void subtree_cv(const uint8_t *input, size_t input_len,
+                       uint64_t chunk_counter, bool use_tbb,
+                       uint8_t out[BLAKE3_OUT_LEN]) {
+  if (input_len == BLAKE3_CHUNK_LEN) {
+    blake3_chunk_state chunk_state;
+    chunk_state_init(&chunk_state, IV, 0);
+    chunk_state.chunk_counter = chunk_counter;
+    chunk_state_update(&chunk_state, input, input_len);
+    output_t output = chunk_state_output(&chunk_state);
+    output_chaining_value(&output, out);
+    return;
+  }
+  uint8_t cv_pair[2 * BLAKE3_OUT_LEN];
+  compress_subtree_to_parent_node(input, input_len, IV, chunk_counter, 0,
+                                  cv_pair, use_tbb);
+  output_t output = parent_output(cv_pair, IV, 0);
+  output_chaining_value(&output, out);
+}
+
+INLINE void parent_cv(const uint8_t left[BLAKE3_OUT_LEN],
+                      const uint8_t right[BLAKE3_OUT_LEN],
+                      uint8_t out[BLAKE3_OUT_LEN]) {
+  uint8_t block[BLAKE3_BLOCK_LEN];
+  memcpy(block, left, BLAKE3_OUT_LEN);
+  memcpy(&block[BLAKE3_OUT_LEN], right, BLAKE3_OUT_LEN);
+  output_t output = parent_output(block, IV, 0);
+  output_chaining_value(&output, out);
+}
+
+void blake3_resume_init(blake3_resume_state *state) {
+  state->chunks = 1;
+  state->spine_len = 0;
+  state->stack_len = 0;
+}
+
+// Same popcount rule as hasher_merge_cv_stack(), except that the leftmost
+// subtree is never materialized: whatever completes it becomes a spine entry.
+static void resume_push(blake3_resume_state *state,
+                        const uint8_t cv[BLAKE3_OUT_LEN], uint64_t chunks) {
+  memcpy(state->stack[state->stack_len], cv, BLAKE3_OUT_LEN);
+  state->stack_len += 1;
+  state->chunks += chunks;
+
+  size_t post_merge_len = (size_t)popcnt(state->chunks) - 1;
+  while (state->stack_len > post_merge_len) {
+    if (state->stack_len == 1) {
+      memcpy(state->spine[state->spine_len], state->stack[0], BLAKE3_OUT_LEN);
+      state->spine_len += 1;
+      state->stack_len = 0;
+      break;
+    }
+    uint8_t *left = state->stack[state->stack_len - 2];
+    parent_cv(left, state->stack[state->stack_len - 1], left);
+    state->stack_len -= 1;
+  }
+}
+
+void blake3_resume_update(blake3_resume_state *state, const void *input,
+                          size_t input_len, int parallel) {
+  assert(input_len % BLAKE3_CHUNK_LEN == 0);
+  const uint8_t *input_bytes = (const uint8_t *)input;
+  bool use_tbb = parallel && g_join_hook != NULL;
+
+  // Largest aligned power-of-2 subtrees, as in blake3_hasher_update_base()
+  while (input_len > 0) {
+    size_t subtree_len = round_down_to_power_of_2(input_len);
+    uint64_t count_so_far = state->chunks * BLAKE3_CHUNK_LEN;
+    while ((((uint64_t)(subtree_len - 1)) & count_so_far) != 0) {
+      subtree_len /= 2;
+    }
+    uint8_t cv[BLAKE3_OUT_LEN];
+    subtree_cv(input_bytes, subtree_len, state->chunks, use_tbb, cv);
+    resume_push(state, cv, subtree_len / BLAKE3_CHUNK_LEN);
+    input_bytes += subtree_len;
+    input_len -= subtree_len;
+  }
+}
+
+void blake3_resume_hasher(const blake3_resume_state *state,
+                          const uint8_t first_chunk[BLAKE3_CHUNK_LEN],
+                          blake3_hasher *self) {
+  blake3_hasher_init(self);
+
+  // Chunk 0 is never the root here: more input always follows
+  uint8_t cv[BLAKE3_OUT_LEN];
+  subtree_cv(first_chunk, BLAKE3_CHUNK_LEN, 0, false, cv);
+  for (size_t j = 0; j < state->spine_len; j++) {
+    parent_cv(cv, state->spine[j], cv);
+  }
+
+  memcpy(self->cv_stack, cv, BLAKE3_OUT_LEN);
+  memcpy(&self->cv_stack[BLAKE3_OUT_LEN], state->stack,
+         (size_t)state->stack_len * BLAKE3_OUT_LEN);
+  self->cv_stack_len = (uint8_t)(1 + state->stack_len);
+  self->chunk.chunk_counter = state->chunks;
+}
+
 void blake3_hasher_finalize(const blake3_hasher *self, uint8_t *out,
                             size_t out_len) {
   blake3_hasher_finalize_seek(self, 0, out, out_len);
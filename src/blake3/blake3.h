@@ -61,6 +61,8 @@ typedef struct {
 } blake3_hasher;
 
 BLAKE3_API const char *blake3_version(void);
+// SIMD kernel chosen by runtime CPU detection ("avx512", "avx2", ...)
+BLAKE3_API const char *blake3_kernel_name(void);
 BLAKE3_API void blake3_hasher_init(blake3_hasher *self);
 BLAKE3_API void blake3_hasher_init_keyed(blake3_hasher *self,
                                          const uint8_t key[BLAKE3_KEY_LEN]);
@@ -73,6 +75,45 @@ BLAKE3_API void blake3_hasher_update(blake3_hasher *self, const void *input,
 BLAKE3_API void blake3_hasher_update_tbb(blake3_hasher *self, const void *input,
                                          size_t input_len);
 #endif // BLAKE3_USE_TBB
+
+// Fork-join hook for parallel subtree hashing. `join` must run task(left) and
+// task(right), possibly concurrently, and return once both have finished.
+// Subtrees shorter than `min_subtree_len` bytes are hashed serially.
+typedef void (*blake3_join_fn)(void (*task)(void *arg), void *left, void *right);
+BLAKE3_API void blake3_set_join_hook(blake3_join_fn join, size_t min_subtree_len);
+// Like blake3_hasher_update, but splits large inputs through the join hook.
+// Falls back to a serial update when no hook is installed.
+BLAKE3_API void blake3_hasher_update_parallel(blake3_hasher *self, const void *input,
+                                              size_t input_len);
+// Hash many independent messages of at most BLAKE3_CHUNK_LEN bytes each,
+// writing one BLAKE3_OUT_LEN digest per message to out. Messages share SIMD
+// lanes instead of going through a hasher one at a time.
+BLAKE3_API void blake3_hash_short_many(const uint8_t *const *inputs,
+                                       const size_t *input_lens,
+                                       size_t num_inputs, uint8_t *out);
+// Resumable hashing for inputs whose first chunk may change while the rest
+// only grows (a "blob <size>" header in front of an append-only file). The
+// state holds the chaining values of every complete subtree that does not
+// contain chunk 0, so a longer input needs only chunk 0 and the new tail.
+typedef struct {
+  uint64_t chunks;    // Complete chunks covered, counting chunk 0
+  uint8_t spine_len;  // spine[j] covers chunks [2^j, 2^(j+1))
+  uint8_t stack_len;  // Subtrees after [0, 2^spine_len), largest first
+  uint8_t spine[BLAKE3_MAX_DEPTH][BLAKE3_OUT_LEN];
+  uint8_t stack[BLAKE3_MAX_DEPTH][BLAKE3_OUT_LEN];
+} blake3_resume_state;
+
+// Start an empty state (covering only chunk 0)
+BLAKE3_API void blake3_resume_init(blake3_resume_state *state);
+// Append whole chunks that start at chunk `state->chunks`. input_len must be
+// a multiple of BLAKE3_CHUNK_LEN. `parallel` uses the join hook if installed.
+BLAKE3_API void blake3_resume_update(blake3_resume_state *state, const void *input,
+                                     size_t input_len, int parallel);
+// Set up a default-key hasher as if it had consumed `first_chunk` followed
+// by the chunks in the state. At least one more byte must follow.
+BLAKE3_API void blake3_resume_hasher(const blake3_resume_state *state,
+                                     const uint8_t first_chunk[BLAKE3_CHUNK_LEN],
+                                     blake3_hasher *self);
 BLAKE3_API void blake3_hasher_finalize(const blake3_hasher *self, uint8_t *out,
                                        size_t out_len);
 BLAKE3_API void blake3_hasher_finalize_seek(const blake3_hasher *self, uint64_t seek,
@@ -299,6 +299,38 @@ void blake3_hash_many(const uint8_t *const *inputs, size_t num_inputs,
                             out);
 }
 
+// Name of the hash_many kernel selected for this CPU, for diagnostics.
+const char *blake3_kernel_name(void) {
+#if defined(IS_X86)
+  const enum cpu_feature features = get_cpu_features();
+  MAYBE_UNUSED(features);
+#if !defined(BLAKE3_NO_AVX512)
+  if ((features & (AVX512F|AVX512VL)) == (AVX512F|AVX512VL)) {
+    return "avx512";
+  }
+#endif
+#if !defined(BLAKE3_NO_AVX2)
+  if (features & AVX2) {
+    return "avx2";
+  }
+#endif
+#if !defined(BLAKE3_NO_SSE41)
+  if (features & SSE41) {
+    return "sse4.1";
+  }
+#endif
+#if !defined(BLAKE3_NO_SSE2)
+  if (features & SSE2) {
+    return "sse2";
+  }
+#endif
+#endif
+#if BLAKE3_USE_NEON == 1
+  return "neon";
+#endif
+  return "portable";
+}
+
 // The dynamically detected SIMD degree of the current platform.
 size_t blake3_simd_degree(void) {
 #if defined(IS_X86)
@@ -5,14 +5,22 @@
 #include "commands.h"
 #include "repository.h"
 #include "index.h"
+#include "fast_index.h"
 #include "objects.h"
+#include "hash.h"
+#include "object_set.h"
+#include "dual_hash.h"
+#include "sparse.h"
+#include "tree_flatten.h"
+#include "thread_pool.h"
 #include "file_utils.h"
 #include "arg_parser.h"
 #include "tui.h"
 #include <dirent.h>
 #include <sys/stat.h>
 #include <string.h>
-#include <omp.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 
 // Check if path matches .avcignore patterns
@@ -81,10 +89,25 @@ static int should_skip_path(const char* path) {
     return 0;
 }
 
-static void collect_files(const char* path, char*** paths, size_t* count, size_t* cap, int preserve_empty_dirs) {
+// Append a path and its size, growing both arrays together
+static void append_file(char*** paths, size_t** sizes, size_t* count, size_t* cap, const char* path, size_t size) {
+    // Grow array more aggressively
+    if (*count >= *cap) {
+        *cap = *cap ? *cap * 2 : 2048;  // Start larger
+        *paths = realloc(*paths, *cap * sizeof(char*));
+        *sizes = realloc(*sizes, *cap * sizeof(size_t));
+    }
+    (*paths)[*count] = strdup2(path);
+    (*sizes)[*count] = size;
+    (*count)++;
+}
+
+static void collect_files(const char* path, char*** paths, size_t** sizes, size_t* count, size_t* cap, int preserve_empty_dirs) {
     if (should_skip_path(path)) return;
     struct stat st;
     if (stat(path, &st) == -1) return;  // Use stat to match find behavior
+    // Outside the sparse checkout: the index keeps the directory collapsed
+    if (sparse_excludes(path, S_ISDIR(st.st_mode))) return;
     
     if (S_ISDIR(st.st_mode)) {
         DIR* d = opendir(path);
@@ -108,7 +131,7 @@ static void collect_files(const char* path, char*** paths, size_t* count, size_t
             if (should_skip_path(child_buf)) continue;
             
             has_children = 1;
-            collect_files(child_buf, paths, count, cap, preserve_empty_dirs);
+            collect_files(child_buf, paths, sizes, count, cap, preserve_empty_dirs);
         }
         
         // If directory is empty and preservation is enabled, create a placeholder .avckeep file
@@ -119,6 +142,7 @@ static void collect_files(const char* path, char*** paths, size_t* count, size_t
             // Check if .avckeep file already exists
             struct stat keep_st;
             if (stat(keep_file_path, &keep_st) == -1) {
+                keep_st.st_size = 0;
                 // Create the .avckeep file if it doesn't exist
                 FILE* keep_file = fopen(keep_file_path, "w");
                 if (keep_file) {
@@ -131,24 +155,240 @@ static void collect_files(const char* path, char*** paths, size_t* count, size_t
             }
             
             // Add the .avckeep file to the collection (whether new or existing)
-            if (*count >= *cap) {
-                *cap = *cap ? *cap * 2 : 2048;
-                *paths = realloc(*paths, *cap * sizeof(char*));
-            }
-            (*paths)[*count] = strdup2(keep_file_path);
-            (*count)++;
+            append_file(paths, sizes, count, cap, keep_file_path, (size_t)keep_st.st_size);
         }
         
         closedir(d);
     } else if (S_ISREG(st.st_mode)) {
-        // Grow array more aggressively
-        if (*count >= *cap) {
-            *cap = *cap ? *cap * 2 : 2048;  // Start larger
-            *paths = realloc(*paths, *cap * sizeof(char*));
+        append_file(paths, sizes, count, cap, path, (size_t)st.st_size);
+    }
+}
+
+// Index entries point at objects that are already in the store
+static void seed_known_object(const char* path, const avc_oid_t* oid, unsigned int mode, void* ctx) {
+    (void)path;
+    (void)mode;
+    object_set_seed((object_set_t*)ctx, oid);
+}
+
+// Index entries the sparse checkout no longer agrees with
+typedef struct {
+    index_entry_t* entries;
+    size_t count;
+    size_t capacity;
+} sparse_changes_t;
+
+static void find_sparse_change(const char* path, const avc_oid_t* oid, unsigned int mode, void* ctx) {
+    sparse_changes_t* changes = ctx;
+    int stale = mode == SPARSE_DIR_MODE ? !sparse_excludes(path, 1) : sparse_excludes(path, 0);
+    if (!stale) return;
+    if (changes->count == changes->capacity) {
+        size_t capacity = changes->capacity ? changes->capacity * 2 : 64;
+        index_entry_t* grown = realloc(changes->entries, capacity * sizeof(index_entry_t));
+        if (!grown) return;
+        changes->entries = grown;
+        changes->capacity = capacity;
+    }
+    index_entry_t* entry = &changes->entries[changes->count++];
+    snprintf(entry->path, sizeof(entry->path), "%s", path);
+    entry->oid = *oid;
+    entry->mode = mode;
+}
+
+// Commits are built from the index alone, so with a sparse checkout every
+// directory outside the cone is staged as its tree in the last commit.
+// Collapsed directories the cone now covers are expanded into their files
+// and files of directories that left it are dropped.
+static int stage_sparse_dirs(void) {
+    sparse_changes_t changes = {0};
+    index_foreach(find_sparse_change, &changes);
+    int result = 0;
+    for (size_t i = 0; i < changes.count; i++) {
+        index_entry_t* entry = &changes.entries[i];
+        index_upsert_entry(entry->path, NULL, 0, NULL);
+        if (entry->mode != SPARSE_DIR_MODE) continue;
+
+        tree_files_t expanded;
+        if (tree_flatten(&entry->oid, entry->path, TREE_FLATTEN_CONE, &expanded) != 0) {
+            result = -1;
+            continue;
+        }
+        for (size_t j = 0; j < expanded.count; j++) {
+            const tree_file_t* file = &expanded.files[j];
+            index_upsert_entry(file->path, &file->oid, file->mode, NULL);
+        }
+        tree_files_free(&expanded);
+    }
+    free(changes.entries);
+
+    avc_oid_t head_tree;
+    tree_files_t collapsed;
+    if (get_last_commit_tree(&head_tree) > 0) {
+        if (tree_flatten(&head_tree, "", TREE_FLATTEN_COLLAPSED, &collapsed) != 0) return -1;
+        for (size_t i = 0; i < collapsed.count; i++) {
+            const tree_file_t* dir = &collapsed.files[i];
+            if (!index_get_oid(dir->path)) index_upsert_entry(dir->path, &dir->oid, dir->mode, NULL);
+        }
+        tree_files_free(&collapsed);
+    }
+    return result;
+}
+
+typedef struct {
+    size_t size;
+    size_t index;
+} add_order_t;
+
+// Largest files first so a few huge files never end up as the tail
+static int compare_add_order(const void* a, const void* b) {
+    const add_order_t* oa = a;
+    const add_order_t* ob = b;
+    if (oa->size != ob->size) return oa->size < ob->size ? 1 : -1;
+    return oa->index < ob->index ? -1 : (oa->index > ob->index);
+}
+
+// Files this small are hashed in SIMD batches (header + content fit one chunk)
+#define ADD_BATCH_MAX_SIZE 1000
+#define ADD_BATCH_FILES 64
+
+typedef struct {
+    char** file_paths;
+    const add_order_t* order;
+    size_t large_count;   // order[0..large_count) are processed one by one
+    size_t file_count;
+    avc_oid_t* oids;
+    unsigned int* modes;
+    int* changed;
+    struct stat* stats;   // Taken before hashing, for the index
+    progress_bar_t* progress;
+    _Atomic size_t done;
+} add_job_t;
+
+static pthread_mutex_t g_progress_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void report_progress(add_job_t* job, size_t files) {
+    // Reduce progress update frequency for better performance
+    size_t before = atomic_fetch_add(&job->done, files);
+    if (job->progress && before / 2000 != (before + files) / 2000) {
+        pthread_mutex_lock(&g_progress_lock);
+        progress_update(job->progress, before + files);
+        pthread_mutex_unlock(&g_progress_lock);
+    }
+}
+
+// Normalize file path to relative format (never use absolute paths)
+static int normalize_add_path(const char* path, char normalized_path[1024]) {
+    if (path[0] == '/') {
+        // Skip absolute paths to prevent Git issues
+        return -1;
+    } else if (strncmp(path, "./", 2) == 0) {
+        // Already has "./" prefix
+        snprintf(normalized_path, 1024, "%s", path);
+    } else {
+        // Add "./" prefix
+        snprintf(normalized_path, 1024, "./%s", path);
+    }
+    return 0;
+}
+
+static void add_file(add_job_t* job, size_t i) {
+    struct stat st;
+    if (stat(job->file_paths[i], &st) == -1) return;
+    job->stats[i] = st;
+    
+    char normalized_path[1024];
+    if (normalize_add_path(job->file_paths[i], normalized_path) != 0) return;
+    
+    const avc_oid_t* old_oid = index_get_oid(normalized_path);
+    if (old_oid) {
+        avc_oid_t new_oid;
+        if (blake3_file_oid(job->file_paths[i], &new_oid) == 0 && oid_equal(old_oid, &new_oid)) {
+            // unchanged, reuse old hash but mark as unchanged
+            job->oids[i] = *old_oid;
+            job->modes[i] = (unsigned int)st.st_mode;
+            job->changed[i] = 0; // Mark as unchanged
+            return;
+        }
+    }
+    if (store_blob_from_file(job->file_paths[i], &job->oids[i]) != 0) return;
+    job->modes[i] = (unsigned int)st.st_mode;
+    job->changed[i] = 1; // Mark as changed
+}
+
+// Read up to ADD_BATCH_FILES small files and hash them together
+static void add_small_batch(add_job_t* job, size_t first_slot, size_t count) {
+    char buffers[ADD_BATCH_FILES][ADD_BATCH_MAX_SIZE];
+    const char* contents[ADD_BATCH_FILES];
+    size_t sizes[ADD_BATCH_FILES];
+    size_t files[ADD_BATCH_FILES];
+    unsigned int modes[ADD_BATCH_FILES];
+    avc_oid_t oids[ADD_BATCH_FILES];
+    size_t n = 0;
+
+    for (size_t slot = first_slot; slot < first_slot + count; slot++) {
+        size_t i = job->order[slot].index;
+        struct stat st;
+        if (stat(job->file_paths[i], &st) == -1) continue;
+        if (job->file_paths[i][0] == '/') continue;
+        if ((size_t)st.st_size > ADD_BATCH_MAX_SIZE) {
+            // Grew since it was collected
+            add_file(job, i);
+            continue;
+        }
+
+        FILE* f = fopen(job->file_paths[i], "rb");
+        if (!f) continue;
+        size_t bytes_read = fread(buffers[n], 1, ADD_BATCH_MAX_SIZE, f);
+        int grew = fgetc(f) != EOF;
+        fclose(f);
+        if (grew) {
+            add_file(job, i);
+            continue;
+        }
+
+        contents[n] = buffers[n];
+        sizes[n] = bytes_read;
+        files[n] = i;
+        modes[n] = (unsigned int)st.st_mode;
+        job->stats[i] = st;
+        n++;
+    }
+
+    if (n == 0) return;
+    blake3_hash_objects_batch("blob", contents, sizes, n, oids);
+
+    for (size_t k = 0; k < n; k++) {
+        size_t i = files[k];
+        char normalized_path[1024];
+        normalize_add_path(job->file_paths[i], normalized_path);
+
+        const avc_oid_t* old_oid = index_get_oid(normalized_path);
+        job->oids[i] = oids[k];
+        job->modes[i] = modes[k];
+        if (old_oid && oid_equal(old_oid, &oids[k])) {
+            job->changed[i] = 0; // Mark as unchanged
+            continue;
         }
-        (*paths)[*count] = strdup2(path);
-        (*count)++;
+        if (store_object_hashed("blob", contents[k], sizes[k], &oids[k]) != 0) continue;
+        job->changed[i] = 1; // Mark as changed
+    }
+}
+
+// Work unit: one large file, or one batch of small files
+static void add_work_unit(void* ctx, size_t unit) {
+    add_job_t* job = ctx;
+
+    if (unit < job->large_count) {
+        add_file(job, job->order[unit].index);
+        report_progress(job, 1);
+        return;
     }
+
+    size_t first_slot = job->large_count + (unit - job->large_count) * ADD_BATCH_FILES;
+    size_t count = job->file_count - first_slot;
+    if (count > ADD_BATCH_FILES) count = ADD_BATCH_FILES;
+    add_small_batch(job, first_slot, count);
+    report_progress(job, count);
 }
 
 int cmd_add(int argc, char* argv[]) {
@@ -185,12 +425,20 @@ int cmd_add(int argc, char* argv[]) {
 
         // Collect all files to add first
     char** file_paths = NULL;
+    size_t* file_sizes = NULL;
     size_t file_count = 0, file_cap = 0;
 
     // forward declaration
 
 
-    for (int i = 0; i < positional_count; ++i) collect_files(positional[i], &file_paths, &file_count, &file_cap, preserve_empty_dirs);
+    for (int i = 0; i < positional_count; ++i) {
+        struct stat st;
+        if (stat(positional[i], &st) == 0 && sparse_excludes(positional[i], S_ISDIR(st.st_mode))) {
+            fprintf(stderr, "Skipping %s: outside the sparse checkout (%s)\n", positional[i], SPARSE_FILE);
+            continue;
+        }
+        collect_files(positional[i], &file_paths, &file_sizes, &file_count, &file_cap, preserve_empty_dirs);
+    }
 
     if (!file_count) {
         fprintf(stderr, "Nothing to add\n");
@@ -206,9 +454,10 @@ int cmd_add(int argc, char* argv[]) {
     int use_tui = file_count > 1000;
     
     // Results arrays
-    char (*hashes)[65] = calloc(file_count, 65);
+    avc_oid_t* oids = calloc(file_count, sizeof(avc_oid_t));
     unsigned int* modes = calloc(file_count, sizeof(unsigned int));
     int* changed = calloc(file_count, sizeof(int)); // Track which files are actually changed
+    struct stat* stats = calloc(file_count, sizeof(struct stat));
 
     // Load index once so we can compare hashes
     if (index_load() == -1) {
@@ -216,55 +465,62 @@ int cmd_add(int argc, char* argv[]) {
         return 1;
     }
 
+    // Shared set of stored/in-flight hashes so identical files are written once
+    object_set_t* known_objects = object_set_create(file_count + index_count());
+    if (known_objects) {
+        index_foreach(seed_known_object, known_objects);
+        objects_set_known_objects(known_objects);
+    }
+
     // Hash and store files with progress
     if (use_tui) {
         hash_progress = progress_create("Processing files", file_count);
         progress_update(hash_progress, 0);
     }
     
-    // Ultra-fast parallel processing with optimal scheduling
-    #pragma omp parallel for schedule(guided, 64)
+    // Schedule by size, largest first, on the shared work-stealing pool
+    add_order_t* order = malloc(file_count * sizeof(add_order_t));
     for (size_t i = 0; i < file_count; ++i) {
-        // Reduce progress update frequency for better performance
-        if (use_tui && i % 2000 == 0) {
-            #pragma omp critical
-            {
-                progress_update(hash_progress, i);
-            }
-        }
-        struct stat st;
-        if (stat(file_paths[i], &st) == -1) continue;
-        
-        // Normalize file path to relative format (never use absolute paths)
-        char normalized_path[1024];
-        if (file_paths[i][0] == '/') {
-            // Skip absolute paths to prevent Git issues
-            continue;
-        } else if (strncmp(file_paths[i], "./", 2) == 0) {
-            // Already has "./" prefix
-            strcpy(normalized_path, file_paths[i]);
-        } else {
-            // Add "./" prefix
-            snprintf(normalized_path, sizeof(normalized_path), "./%s", file_paths[i]);
-        }
-        
-        const char* old_hash = index_get_hash(normalized_path);
-        if (old_hash) {
-            char new_hash[65];
-            blake3_file_hex(file_paths[i], new_hash);
-            if (strcmp(old_hash, new_hash) == 0) {
-                // unchanged, reuse old hash but mark as unchanged
-                strcpy(hashes[i], old_hash);
-                modes[i] = (unsigned int)st.st_mode;
-                changed[i] = 0; // Mark as unchanged
-                continue;
-            }
-        }
-        store_blob_from_file(file_paths[i], hashes[i]);
-        modes[i] = (unsigned int)st.st_mode;
-        changed[i] = 1; // Mark as changed
+        order[i].size = file_sizes[i];
+        order[i].index = i;
     }
+    qsort(order, file_count, sizeof(add_order_t), compare_add_order);
+
+    // Small files sit at the tail of the order and are hashed in batches
+    size_t large_count = file_count;
+    while (large_count > 0 && order[large_count - 1].size <= ADD_BATCH_MAX_SIZE) large_count--;
+    size_t batch_count = (file_count - large_count + ADD_BATCH_FILES - 1) / ADD_BATCH_FILES;
+
+    add_job_t job = {
+        .file_paths = file_paths,
+        .order = order,
+        .large_count = large_count,
+        .file_count = file_count,
+        .oids = oids,
+        .modes = modes,
+        .changed = changed,
+        .stats = stats,
+        .progress = hash_progress,
+    };
+    atomic_init(&job.done, 0);
+
+    // Dual-hash repositories get Git blob IDs and objects in the same pass
+    int dual_hash = dual_hash_enabled();
+    if (dual_hash) objects_set_blob_hook(dual_hash_record_blob);
+
+    thread_pool_parallel_for(large_count + batch_count, add_work_unit, &job);
+    free(order);
     
+    objects_set_known_objects(NULL);
+    object_set_free(known_objects);
+
+    if (dual_hash) {
+        objects_set_blob_hook(NULL);
+        if (dual_hash_flush() != 0) {
+            fprintf(stderr, "Warning: failed to record Git blob IDs in .git/avc-map\n");
+        }
+    }
+
     if (use_tui) {
         progress_finish(hash_progress);
     }
@@ -273,20 +529,20 @@ int cmd_add(int argc, char* argv[]) {
     int added_count = 0;
     int unchanged_count = 0;
     for (size_t i = 0; i < file_count; ++i) {
+        // Normalize file path for index operations (relative paths only)
+        char normalized_path[1024];
+        if (file_paths[i][0] == '/') {
+            // Skip absolute paths
+            continue;
+        } else if (strncmp(file_paths[i], "./", 2) == 0) {
+            strcpy(normalized_path, file_paths[i]);
+        } else {
+            snprintf(normalized_path, sizeof(normalized_path), "./%s", file_paths[i]);
+        }
+
         if (changed[i]) {
-            // Normalize file path for index operations (relative paths only)
-            char normalized_path[1024];
-            if (file_paths[i][0] == '/') {
-                // Skip absolute paths
-                continue;
-            } else if (strncmp(file_paths[i], "./", 2) == 0) {
-                strcpy(normalized_path, file_paths[i]);
-            } else {
-                snprintf(normalized_path, sizeof(normalized_path), "./%s", file_paths[i]);
-            }
-            
         int unchanged=0;
-            if (index_upsert_entry(normalized_path, hashes[i], modes[i], &unchanged)==-1) {
+            if (index_upsert_entry(normalized_path, &oids[i], modes[i], &unchanged)==-1) {
             fprintf(stderr, "Failed to update index for %s\n", file_paths[i]);
             } else {
                 added_count++;
@@ -294,6 +550,12 @@ int cmd_add(int argc, char* argv[]) {
         } else {
             unchanged_count++;
         }
+        // Lets .git/index treat the file as clean without reading it
+        if (stats[i].st_ino != 0) index_set_stat(normalized_path, &oids[i], &stats[i]);
+    }
+
+    if (sparse_enabled() && stage_sparse_dirs() != 0) {
+        fprintf(stderr, "Warning: failed to stage directories outside the sparse checkout\n");
     }
 
     // Show spinner for index commit
@@ -333,9 +595,11 @@ int cmd_add(int argc, char* argv[]) {
         // free memory
     for (size_t i=0;i<file_count;++i) free(file_paths[i]);
     free(file_paths);
-    free(hashes);
+    free(file_sizes);
+    free(oids);
     free(modes);
     free(changed);
+    free(stats);
 
     free_parsed_args(args);
     return 0;
@@ -5,6 +5,7 @@
 #ifndef COMMANDS_H
 #define COMMANDS_H
 #include <stddef.h>
+#include "oid.h"
 // Command function declarations
 int cmd_init(int argc, char* argv[]);
 int cmd_add(int argc, char* argv[]);
@@ -18,4 +19,7 @@ int cmd_clean(int argc, char* argv[]);
 int cmd_repo_migrate(int argc, char* argv[]);
 int cmd_agcl(int argc, char* argv[]);
 
+// Tree of the commit HEAD points at: 1 if found, 0 before the first commit
+int get_last_commit_tree(avc_oid_t* tree_oid);
+
 #endif
@@ -4,14 +4,19 @@
 #include <string.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <stdatomic.h>
 #include <omp.h>
 #include "commands.h"
 #include "repository.h"
 #include "objects.h"
 #include "index.h"
+#include "thread_pool.h"
+#include "hash.h"
 #include "arg_parser.h"
 #include "tui.h"
 #include "fast_index.h"
+#include "sparse.h"
+#include "hash_checkpoint.h"
 
 // Structure to hold file information for parallel processing
 typedef struct {
@@ -32,11 +37,8 @@ static int file_entry_cmp(const void *a, const void *b) {
 
 // Configure OpenMP for optimal performance
 static void configure_parallel_processing() {
-    // Get number of CPU cores
-    int num_cores = omp_get_num_procs();
-    
-    // Set number of threads (use all cores for maximum performance)
-    omp_set_num_threads(num_cores);
+    // Stay within the global thread budget (cgroup quota, AVC_THREADS)
+    omp_set_num_threads(thread_pool_budget());
     
     // Set thread affinity for better performance
     #ifdef _GNU_SOURCE
@@ -47,21 +49,22 @@ static void configure_parallel_processing() {
 // Tree node structure for building hierarchical trees
 typedef struct tree_node {
     char name[256];
-    char hash[65];
+    avc_oid_t oid;
     unsigned int mode;
     int is_dir;
+    int collapsed;      // Directory outside the sparse checkout: oid is its tree
     struct tree_node* children;
     struct tree_node* next;
     int child_count;
 } tree_node_t;
 
 // Create a new tree node
-static tree_node_t* create_tree_node(const char* name, const char* hash, unsigned int mode, int is_dir) {
+static tree_node_t* create_tree_node(const char* name, const avc_oid_t* oid, unsigned int mode, int is_dir) {
     tree_node_t* node = calloc(1, sizeof(tree_node_t));
     if (!node) return NULL;
 
     strncpy(node->name, name, sizeof(node->name) - 1);
-    if (hash) strncpy(node->hash, hash, sizeof(node->hash) - 1);
+    if (oid) node->oid = *oid;
     node->mode = mode;
     node->is_dir = is_dir;
     return node;
@@ -88,7 +91,7 @@ static tree_node_t* find_or_create_child(tree_node_t* parent, const char* name)
 }
 
 // Add file to tree structure
-static int add_file_to_tree(tree_node_t* root, const char* filepath, const char* hash, unsigned int mode) {
+static int add_file_to_tree(tree_node_t* root, const char* filepath, const avc_oid_t* oid, unsigned int mode) {
     char path_copy[512];
     strncpy(path_copy, filepath, sizeof(path_copy) - 1);
     path_copy[sizeof(path_copy) - 1] = '\0';
@@ -112,7 +115,7 @@ static int add_file_to_tree(tree_node_t* root, const char* filepath, const char*
             if (!current) return -1;
         } else {
             // This is the file component
-            tree_node_t* file_node = create_tree_node(token, hash, mode, 0);
+            tree_node_t* file_node = create_tree_node(token, oid, mode, 0);
             if (!file_node) return -1;
 
             file_node->next = current->children;
@@ -126,6 +129,28 @@ static int add_file_to_tree(tree_node_t* root, const char* filepath, const char*
     return 0;
 }
 
+// Add a collapsed directory entry of the sparse index, keeping its tree hash
+static int add_collapsed_dir_to_tree(tree_node_t* root, const char* dirpath, const avc_oid_t* oid) {
+    char path_copy[512];
+    strncpy(path_copy, dirpath, sizeof(path_copy) - 1);
+    path_copy[sizeof(path_copy) - 1] = '\0';
+
+    char* path = path_copy;
+    if (strncmp(path, "./", 2) == 0) {
+        path += 2;
+    }
+
+    tree_node_t* current = root;
+    for (char* token = strtok(path, "/"); token; token = strtok(NULL, "/")) {
+        current = find_or_create_child(current, token);
+        if (!current || !current->is_dir) return -1;
+    }
+    if (current == root) return -1;
+    current->oid = *oid;
+    current->collapsed = 1;
+    return 0;
+}
+
 // Compare tree nodes for sorting
 static int compare_tree_nodes(const void* a, const void* b) {
     const tree_node_t* node_a = *(const tree_node_t**)a;
@@ -133,16 +158,63 @@ static int compare_tree_nodes(const void* a, const void* b) {
     return strcmp(node_a->name, node_b->name);
 }
 
-// Create tree object from tree node (recursive)
-static int create_tree_object_recursive(tree_node_t* node, char* tree_hash_out) {
+// Directory nodes that share a height (0 = no subdirectories)
+typedef struct {
+    tree_node_t** nodes;
+    size_t count;
+    size_t capacity;
+} tree_level_t;
+
+// Bucket every directory node by height; returns the node's height or -1
+static int collect_tree_levels(tree_node_t* node, tree_level_t** levels, int* level_count) {
+    int height = 0;
+    for (tree_node_t* child = node->children; child; child = child->next) {
+        if (!child->is_dir) continue;
+        if (child->collapsed) {
+            // Its hash is reused as-is; files staged under it would be lost
+            if (child->children) {
+                fprintf(stderr, "Files are staged inside %s, which is outside the sparse checkout\n",
+                        child->name);
+                return -1;
+            }
+            continue;
+        }
+        int child_height = collect_tree_levels(child, levels, level_count);
+        if (child_height < 0) return -1;
+        if (child_height + 1 > height) height = child_height + 1;
+    }
+
+    if (height >= *level_count) {
+        tree_level_t* grown = realloc(*levels, (height + 1) * sizeof(tree_level_t));
+        if (!grown) return -1;
+        memset(grown + *level_count, 0, (height + 1 - *level_count) * sizeof(tree_level_t));
+        *levels = grown;
+        *level_count = height + 1;
+    }
+
+    tree_level_t* level = &(*levels)[height];
+    if (level->count >= level->capacity) {
+        size_t new_capacity = level->capacity ? level->capacity * 2 : 64;
+        tree_node_t** grown = realloc(level->nodes, new_capacity * sizeof(tree_node_t*));
+        if (!grown) return -1;
+        level->nodes = grown;
+        level->capacity = new_capacity;
+    }
+    level->nodes[level->count++] = node;
+    return height;
+}
+
+// Serialize a directory; subdirectory hashes must already be computed
+static char* build_tree_content(tree_node_t* node, size_t* size_out) {
+    *size_out = 0;
     if (!node->children) {
         // Empty tree
-        return store_object("tree", "", 0, tree_hash_out);
+        return calloc(1, 1);
     }
 
     // Collect children into array for sorting
     tree_node_t** children_array = malloc(node->child_count * sizeof(tree_node_t*));
-    if (!children_array) return -1;
+    if (!children_array) return NULL;
 
     tree_node_t* child = node->children;
     int idx = 0;
@@ -159,38 +231,89 @@ static int create_tree_object_recursive(tree_node_t* node, char* tree_hash_out)
     char* tree_content = malloc(node->child_count * 512); // Estimate size
     if (!tree_content) {
         free(children_array);
-        return -1;
+        return NULL;
     }
 
+    char hex[AVC_OID_HEXSZ + 1];
     for (int i = 0; i < node->child_count; i++) {
         tree_node_t* child_node = children_array[i];
+        unsigned int mode = child_node->is_dir ? 040000 : child_node->mode;
+        oid_to_hex(&child_node->oid, hex);
+        int entry_len = snprintf(tree_content + content_size, 512,
+                               "%o %s %s\n", mode, child_node->name, hex);
+        content_size += entry_len;
+    }
 
-        if (child_node->is_dir) {
-            // Recursively create subtree
-            char subtree_hash[65];
-            if (create_tree_object_recursive(child_node, subtree_hash) != 0) {
-                free(tree_content);
-                free(children_array);
-                return -1;
+    free(children_array);
+    *size_out = content_size;
+    return tree_content;
+}
+
+typedef struct {
+    tree_node_t** nodes;
+    char** contents;
+    size_t* sizes;
+    _Atomic int failed;
+} tree_store_job_t;
+
+static void store_tree_node(void* ctx, size_t i) {
+    tree_store_job_t* job = ctx;
+    if (store_object_hashed("tree", job->contents[i], job->sizes[i], &job->nodes[i]->oid) != 0) {
+        atomic_store(&job->failed, 1);
+    }
+}
+
+// Hash one level of directories as a batch, then store them in parallel
+static int create_tree_level(tree_level_t* level) {
+    size_t n = level->count;
+    char** contents = calloc(n, sizeof(char*));
+    size_t* sizes = calloc(n, sizeof(size_t));
+    avc_oid_t* oids = malloc(n * sizeof(avc_oid_t));
+    int result = -1;
+
+    if (contents && sizes && oids) {
+        size_t built = 0;
+        while (built < n && (contents[built] = build_tree_content(level->nodes[built], &sizes[built]))) {
+            built++;
+        }
+
+        if (built == n) {
+            blake3_hash_objects_batch("tree", (const char* const*)contents, sizes, n, oids);
+            for (size_t i = 0; i < n; i++) {
+                level->nodes[i]->oid = oids[i];
             }
 
-            int entry_len = snprintf(tree_content + content_size, 512,
-                                   "%o %s %s\n", 040000, child_node->name, subtree_hash);
-            content_size += entry_len;
-        } else {
-            // File entry
-            int entry_len = snprintf(tree_content + content_size, 512,
-                                   "%o %s %s\n", child_node->mode, child_node->name, child_node->hash);
-            content_size += entry_len;
+            tree_store_job_t job = { .nodes = level->nodes, .contents = contents, .sizes = sizes };
+            atomic_init(&job.failed, 0);
+            thread_pool_parallel_for(n, store_tree_node, &job);
+            result = atomic_load(&job.failed) ? -1 : 0;
         }
     }
 
-    free(children_array);
+    if (contents) {
+        for (size_t i = 0; i < n; i++) free(contents[i]);
+    }
+    free(contents);
+    free(sizes);
+    free(oids);
+    return result;
+}
 
-    // Store tree object
-    int result = store_object("tree", tree_content, content_size, tree_hash_out);
-    free(tree_content);
+// Create tree objects bottom-up, one height level at a time
+static int create_tree_objects(tree_node_t* root, avc_oid_t* tree_oid_out) {
+    tree_level_t* levels = NULL;
+    int level_count = 0;
+    int result = collect_tree_levels(root, &levels, &level_count) < 0 ? -1 : 0;
 
+    for (int h = 0; result == 0 && h < level_count; h++) {
+        result = create_tree_level(&levels[h]);
+    }
+    if (result == 0) {
+        *tree_oid_out = root->oid;
+    }
+
+    for (int h = 0; h < level_count; h++) free(levels[h].nodes);
+    free(levels);
     return result;
 }
 
@@ -208,7 +331,7 @@ static void free_tree_node(tree_node_t* node) {
     free(node);
 }
 
-int create_tree(char* tree_hash) {
+int create_tree(avc_oid_t* tree_oid) {
     // Use fast index for O(1) operations
     fast_index_t* fast_idx = fast_index_create();
     if (!fast_idx || fast_index_load(fast_idx) != 0) {
@@ -235,7 +358,10 @@ int create_tree(char* tree_hash) {
     for (int i = 0; i < FAST_INDEX_SIZE; i++) {
         index_entry_t* entry = fast_idx->buckets[i];
         while (entry) {
-            if (add_file_to_tree(root, entry->path, entry->hash, entry->mode) != 0) {
+            int added = entry->mode == SPARSE_DIR_MODE
+                ? add_collapsed_dir_to_tree(root, entry->path, &entry->oid)
+                : add_file_to_tree(root, entry->path, &entry->oid, entry->mode);
+            if (added != 0) {
                 fprintf(stderr, "Failed to add file to tree: %s\n", entry->path);
                 free_tree_node(root);
                 fast_index_free(fast_idx);
@@ -247,8 +373,8 @@ int create_tree(char* tree_hash) {
 
     fast_index_free(fast_idx);
 
-    // Create tree objects recursively
-    int result = create_tree_object_recursive(root, tree_hash);
+    // Create tree objects level by level
+    int result = create_tree_objects(root, tree_oid);
 
     free_tree_node(root);
 
@@ -392,13 +518,15 @@ int cmd_commit(int argc, char* argv[]) {
     // Create tree from index
     spinner_set_label(commit_spinner, "Building hierarchical tree...");
     spinner_update(commit_spinner);
-    char tree_hash[65]; // Updated to 65 for SHA-256
-    if (create_tree(tree_hash) == -1) {
+    avc_oid_t tree_oid;
+    if (create_tree(&tree_oid) == -1) {
         spinner_stop(commit_spinner);
         spinner_free(commit_spinner);
         free_parsed_args(args);
         return 1;
     }
+    char tree_hash[AVC_OID_HEXSZ + 1];
+    oid_to_hex(&tree_oid, tree_hash);
 
     // Get parent commit
     char parent_hash[65]; // Updated to 65 for SHA-256
@@ -432,14 +560,16 @@ int cmd_commit(int argc, char* argv[]) {
     }
 
     // Generate commit hash and store object
-    char commit_hash[65]; // Updated to 65 for SHA-256
-    if (store_object("commit", commit_content, strlen(commit_content), commit_hash) == -1) {
+    avc_oid_t commit_oid;
+    if (store_object("commit", commit_content, strlen(commit_content), &commit_oid) == -1) {
         spinner_stop(commit_spinner);
         spinner_free(commit_spinner);
         fprintf(stderr, "Failed to create commit object\n");
         free_parsed_args(args);
         return 1;
     }
+    char commit_hash[AVC_OID_HEXSZ + 1];
+    oid_to_hex(&commit_oid, commit_hash);
 
     // Update HEAD
     spinner_set_label(commit_spinner, "Updating HEAD...");
@@ -452,9 +582,13 @@ int cmd_commit(int argc, char* argv[]) {
         return 1;
     }
 
-    // Clear index
+    // Clear index, keeping the stat data of what was committed
     spinner_set_label(commit_spinner, "Clearing index...");
     spinner_update(commit_spinner);
+    if (index_save_stat_cache() == -1) {
+        fprintf(stderr, "Warning: Failed to update %s\n", INDEX_STAT_CACHE_PATH);
+    }
+    if (hash_checkpoint_enabled()) hash_checkpoint_prune();
     if (clear_index() == -1) {
         fprintf(stderr, "Warning: Failed to clear index after commit\n");
     }
@@ -148,7 +148,9 @@ int cmd_log(int argc, char* argv[]) {
         // Load commit object
         size_t commit_size;
         char commit_type[16];
-        char* commit_content = load_object(commit_hash, &commit_size, commit_type);
+        avc_oid_t commit_oid;
+        char* commit_content = oid_from_hex(commit_hash, &commit_oid) == 0
+            ? load_object(&commit_oid, &commit_size, commit_type) : NULL;
 
         if (!commit_content || strcmp(commit_type, "commit") != 0) {
             printf("Warning: Invalid commit object: %s\n", commit_hash);
@@ -1,46 +1,25 @@
 // src/commands/reset.c - FIXED VERSION
+#define _XOPEN_SOURCE 700
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
-#include <libgen.h>
 #include <errno.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include "commands.h"
 #include "repository.h"
 #include "index.h"
 #include "objects.h"
+#include "blob_cache.h"
+#include "sparse.h"
+#include "tree_flatten.h"
 #include "file_utils.h"
 #include "arg_parser.h"
 #include "fast_index.h"
+#include "thread_pool.h"
 #include "tui.h"
-// Fast directory creation with minimal stat calls
-int create_directory_recursive(const char* path) {
-    char path_buf[1024];
-    strncpy(path_buf, path, sizeof(path_buf) - 1);
-    path_buf[sizeof(path_buf) - 1] = '\0';
-    
-    char* dir = dirname(path_buf);
-    if (strcmp(dir, ".") == 0 || strcmp(dir, "/") == 0) {
-        return 0;
-    }
-    
-    // Try to create directory first, then recurse only if needed
-    if (mkdir(dir, 0755) == 0 || errno == EEXIST) {
-        return 0;
-    }
-    
-    if (errno == ENOENT) {
-        // Parent doesn't exist, recurse
-        if (create_directory_recursive(dir) == 0) {
-            return mkdir(dir, 0755) == 0 || errno == EEXIST ? 0 : -1;
-        }
-    }
-    
-    return -1;
-}
-
 // Recursively delete all files and directories except .avc, .git, .idea
 static int clean_working_directory(const char* path) {
     DIR* dir = opendir(path);
@@ -66,99 +45,344 @@ static int clean_working_directory(const char* path) {
     return result;
 }
 
-// File entry for flattened tree
+// Work tree state of one entry of the flattened tree
 typedef struct {
-    char path[1024];
-    char hash[65];
+    const char* path;       // In the flattened tree's arena
+    avc_oid_t oid;
     unsigned int mode;
+    int write;              // Hard reset: the work tree file differs
+    int written;            // ... and was checked out
+    int have_stat;          // st holds the file's stat data after the reset
+    struct stat st;
 } file_entry_reset_t;
 
-// Recursively flatten hierarchical tree into file list
-static int flatten_tree_recursive(const char* tree_hash, const char* base_path, file_entry_reset_t** files, int* count, int* capacity) {
-    size_t tree_size;
-    char tree_type[16];
-    char* tree_content = load_object(tree_hash, &tree_size, tree_type);
-    
-    if (!tree_content || strcmp(tree_type, "tree") != 0) {
-        if (tree_content) free(tree_content);
-        return -1;
+typedef struct {
+    size_t size;
+    int index;
+    const char* path;
+    size_t dir_len;         // Length of the directory part of path, 0 at the top
+} reset_order_t;
+
+// Files of one directory, written by one worker through one directory fd
+#define RESTORE_UNIT_FILES 64
+
+typedef struct {
+    size_t first;           // Into the order, which is grouped by directory
+    size_t count;
+    size_t size;
+} restore_unit_t;
+
+// A directory the written files need; path is a prefix of a file's path
+typedef struct {
+    const char* path;
+    size_t len;
+    int depth;
+} restore_dir_t;
+
+typedef struct {
+    file_entry_reset_t* files;
+    reset_order_t* order;
+    fast_index_t* known;    // Last known object and stat data per path
+    restore_unit_t* units;
+    restore_dir_t* dirs;    // One depth level while directories are created
+} reset_job_t;
+
+// Compressed object size is a cheap proxy for restore cost
+static void stat_restore_size(void* ctx, size_t i) {
+    reset_job_t* job = ctx;
+    if (object_stored_size(&job->files[job->order[i].index].oid, &job->order[i].size) != 0) {
+        job->order[i].size = 0;
     }
-    
-    char* tree_copy = malloc(tree_size + 1);
-    if (!tree_copy) {
-        free(tree_content);
-        return -1;
+}
+
+static const char* work_tree_path(const char* path) {
+    return strncmp(path, "./", 2) == 0 ? path + 2 : path;
+}
+
+// Decide whether a file must be written. Stat data recorded for the same
+// object settles it without reading; otherwise a file of the blob's size
+// is hashed, which is cheaper than decompressing and writing it.
+static void check_one_file(void* ctx, size_t i) {
+    reset_job_t* job = ctx;
+    file_entry_reset_t* file = &job->files[i];
+    file->write = file->mode != SPARSE_DIR_MODE;   // Collapsed: nothing to check out
+    if (!file->write) return;
+    if (lstat(work_tree_path(file->path), &file->st) != 0 || !S_ISREG(file->st.st_mode)) return;
+
+    const index_entry_t* entry = fast_index_get(job->known, file->path);
+    if (entry && oid_equal(&entry->oid, &file->oid) && fast_index_stat_matches(entry, &file->st)) {
+        file->write = 0;
+    } else {
+        char type[16];
+        size_t size;
+        avc_oid_t oid;
+        if (stream_object(&file->oid, type, &size, NULL, NULL) == 0 && size == (size_t)file->st.st_size &&
+            blake3_file_oid(work_tree_path(file->path), &oid) == 0 && oid_equal(&oid, &file->oid)) {
+            file->write = 0;
+        }
     }
-    memcpy(tree_copy, tree_content, tree_size);
-    tree_copy[tree_size] = '\0';
-    free(tree_content);
-    
-    char* current_pos = tree_copy;
-    char* end_of_buffer = tree_copy + tree_size;
-    
-    while (current_pos < end_of_buffer) {
-        char* next_line = strchr(current_pos, '\n');
-        if (next_line) *next_line = '\0';
-        
-        if (strlen(current_pos) > 0) {
-            unsigned int mode;
-            char name[256], hash[65];
-            
-            if (sscanf(current_pos, "%o %255s %64s", &mode, name, hash) == 3) {
-                char full_path[1024];
-                if (strlen(base_path) > 0) {
-                    snprintf(full_path, sizeof(full_path), "%s/%s", base_path, name);
-                } else {
-                    strcpy(full_path, name);
-                }
-                
-                if (mode == 040000) {
-                    // Directory - recurse
-                    if (flatten_tree_recursive(hash, full_path, files, count, capacity) != 0) {
-                        free(tree_copy);
-                        return -1;
-                    }
-                } else {
-                    // File - add to flattened list
-                    if (*count >= *capacity) {
-                        *capacity = *capacity ? *capacity * 2 : 1024;
-                        *files = realloc(*files, *capacity * sizeof(file_entry_reset_t));
-                        if (!*files) {
-                            free(tree_copy);
-                            return -1;
-                        }
-                    }
-                    
-                    snprintf((*files)[*count].path, sizeof((*files)[*count].path), "./%s", full_path);
-                    strcpy((*files)[*count].hash, hash);
-                    (*files)[*count].mode = mode;
-                    (*count)++;
+    file->have_stat = !file->write;
+}
+
+static int compare_dir_names(const char* a, size_t a_len, const char* b, size_t b_len) {
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    return cmp ? cmp : (a_len > b_len) - (a_len < b_len);
+}
+
+// Grouped by directory, largest objects first within one
+static int compare_restore_order(const void* a, const void* b) {
+    const reset_order_t* oa = a;
+    const reset_order_t* ob = b;
+    int cmp = compare_dir_names(oa->path, oa->dir_len, ob->path, ob->dir_len);
+    if (cmp) return cmp;
+    if (oa->size != ob->size) return oa->size < ob->size ? 1 : -1;
+    return oa->index - ob->index;
+}
+
+// Largest units first so big files don't form the tail
+static int compare_restore_units(const void* a, const void* b) {
+    const restore_unit_t* ua = a;
+    const restore_unit_t* ub = b;
+    if (ua->size != ub->size) return ua->size < ub->size ? 1 : -1;
+    return (ua->first > ub->first) - (ua->first < ub->first);
+}
+
+// Parents before children
+static int compare_restore_dirs(const void* a, const void* b) {
+    const restore_dir_t* da = a;
+    const restore_dir_t* db = b;
+    if (da->depth != db->depth) return da->depth - db->depth;
+    return compare_dir_names(da->path, da->len, db->path, db->len);
+}
+
+// Split the directory-grouped order into units and list every directory
+// they need, ancestors included, sorted parents first without duplicates
+static int plan_restore(reset_order_t* order, size_t count, restore_unit_t** units_out, size_t* unit_count,
+                        restore_dir_t** dirs_out, size_t* dir_count) {
+    restore_unit_t* units = malloc((count + 1) * sizeof(restore_unit_t));
+    restore_dir_t* dirs = NULL;
+    size_t units_used = 0, dirs_used = 0, dirs_capacity = 0;
+    if (!units) return -1;
+
+    for (size_t i = 0; i < count; i++) {
+        restore_unit_t* unit = units_used ? &units[units_used - 1] : NULL;
+        int same_dir = unit && compare_dir_names(order[i].path, order[i].dir_len, order[i - 1].path,
+                                                 order[i - 1].dir_len) == 0;
+        if (same_dir && unit->count < RESTORE_UNIT_FILES) {
+            unit->count++;
+            unit->size += order[i].size;
+            continue;
+        }
+        units[units_used++] = (restore_unit_t){i, 1, order[i].size};
+        if (same_dir) continue;
+
+        for (size_t len = 1; len <= order[i].dir_len; len++) {
+            if (len < order[i].dir_len && order[i].path[len] != '/') continue;
+            if (dirs_used == dirs_capacity) {
+                dirs_capacity = dirs_capacity ? dirs_capacity * 2 : 256;
+                restore_dir_t* grown = realloc(dirs, dirs_capacity * sizeof(restore_dir_t));
+                if (!grown) {
+                    free(units);
+                    free(dirs);
+                    return -1;
                 }
+                dirs = grown;
             }
+            int depth = 0;
+            for (size_t k = 0; k < len; k++) depth += order[i].path[k] == '/';
+            dirs[dirs_used++] = (restore_dir_t){order[i].path, len, depth};
         }
-        
-        if (next_line) {
-            current_pos = next_line + 1;
-        } else {
-            break;
+    }
+
+    if (dirs_used > 0) qsort(dirs, dirs_used, sizeof(restore_dir_t), compare_restore_dirs);
+    size_t unique = 0;
+    for (size_t i = 0; i < dirs_used; i++) {
+        if (unique == 0 || compare_restore_dirs(&dirs[unique - 1], &dirs[i]) != 0) dirs[unique++] = dirs[i];
+    }
+    qsort(units, units_used, sizeof(restore_unit_t), compare_restore_units);
+
+    *units_out = units;
+    *unit_count = units_used;
+    *dirs_out = dirs;
+    *dir_count = unique;
+    return 0;
+}
+
+static void create_restore_dir(void* ctx, size_t i) {
+    reset_job_t* job = ctx;
+    char path[1024];
+    snprintf(path, sizeof(path), "%.*s", (int)job->dirs[i].len, job->dirs[i].path);
+    mkdir(path, 0755);   // Already there is fine; anything else fails its files
+}
+
+static void restore_one_file(file_entry_reset_t* file, int dir_fd, const char* name) {
+    if (blob_cache_checkout(&file->oid, file->mode, dir_fd, name) == 0) {
+        file->written = 1;
+        file->have_stat = fstatat(dir_fd, name, &file->st, AT_SYMLINK_NOFOLLOW) == 0;
+        return;
+    }
+
+    // Streamed, so a worker holds one zstd window however large the blob
+    if (checkout_blob(&file->oid, file->mode, dir_fd, name) == 0) {
+        file->written = 1;
+        if (fstatat(dir_fd, name, &file->st, AT_SYMLINK_NOFOLLOW) == 0) {
+            file->have_stat = 1;
+            blob_cache_store(&file->oid, dir_fd, name);
         }
     }
-    
-    free(tree_copy);
+}
+
+// Files are opened by name relative to their directory, which is looked
+// up once per unit. Files left unwritten are reported by the caller.
+static void restore_unit(void* ctx, size_t u) {
+    reset_job_t* job = ctx;
+    const restore_unit_t* unit = &job->units[u];
+    const reset_order_t* first = &job->order[unit->first];
+
+    int dir_fd = AT_FDCWD;
+    if (first->dir_len > 0) {
+        char dir[1024];
+        snprintf(dir, sizeof(dir), "%.*s", (int)first->dir_len, first->path);
+        dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd == -1) {
+            fprintf(stderr, "Error: Cannot open directory %s: %s\n", dir, strerror(errno));
+            return;
+        }
+    }
+    for (size_t k = 0; k < unit->count; k++) {
+        const reset_order_t* slot = &first[k];
+        const char* name = slot->path + (slot->dir_len ? slot->dir_len + 1 : 0);
+        restore_one_file(&job->files[slot->index], dir_fd, name);
+    }
+    if (dir_fd != AT_FDCWD) close(dir_fd);
+}
+
+// Create the directories level by level, then write the files
+static int restore_files(reset_job_t* job, size_t count) {
+    restore_unit_t* units;
+    restore_dir_t* dirs;
+    size_t unit_count, dir_count;
+    if (plan_restore(job->order, count, &units, &unit_count, &dirs, &dir_count) != 0) return -1;
+
+    for (size_t level = 0; level < dir_count;) {
+        size_t end = level;
+        while (end < dir_count && dirs[end].depth == dirs[level].depth) end++;
+        job->dirs = dirs + level;
+        thread_pool_parallel_for(end - level, create_restore_dir, job);
+        level = end;
+    }
+
+    job->units = units;
+    thread_pool_parallel_for(unit_count, restore_unit, job);
+    free(units);
+    free(dirs);
     return 0;
 }
 
+// Remove now-empty directories from path's parent upwards
+static void prune_empty_dirs(const char* path) {
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char* slash = strrchr(dir, '/'); slash && slash != dir; slash = strrchr(dir, '/')) {
+        *slash = '\0';
+        if (rmdir(dir) != 0) break;
+    }
+}
+
+// Tracked paths the target does not have: in the current commit or staged
+typedef struct {
+    fast_index_t* target;
+    int removed;
+} reset_prune_t;
+
+static void remove_if_untargeted(reset_prune_t* prune, const char* path) {
+    if (fast_index_get(prune->target, path)) return;
+    const char* file_path = work_tree_path(path);
+    if (unlink(file_path) == 0) {
+        prune->removed++;
+        prune_empty_dirs(file_path);
+    }
+}
+
+// A directory that left the sparse checkout loses the files it had in the
+// current commit. It is only read if it is still there.
+static void remove_collapsed_dir(reset_prune_t* prune, const tree_file_t* dir) {
+    struct stat st;
+    tree_files_t tree;
+    if (lstat(dir->path, &st) != 0 || !S_ISDIR(st.st_mode) ||
+        tree_flatten(&dir->oid, dir->path, TREE_FLATTEN_ALL, &tree) != 0) {
+        return;
+    }
+    for (size_t i = 0; i < tree.count; i++) {
+        if (unlink(tree.files[i].path) == 0) {
+            prune->removed++;
+            prune_empty_dirs(tree.files[i].path);
+        }
+    }
+    tree_files_free(&tree);
+}
+
+static int remove_untargeted_files(fast_index_t* target, fast_index_t* staged) {
+    reset_prune_t prune = {target, 0};
+    avc_oid_t head_tree;
+    tree_files_t tree;
+    if (get_last_commit_tree(&head_tree) > 0 && tree_flatten(&head_tree, "", TREE_FLATTEN_CONE, &tree) == 0) {
+        for (size_t i = 0; i < tree.count; i++) {
+            if (tree.files[i].mode == SPARSE_DIR_MODE) {
+                remove_collapsed_dir(&prune, &tree.files[i]);
+            } else {
+                remove_if_untargeted(&prune, tree.files[i].path);
+            }
+        }
+        tree_files_free(&tree);
+    }
+    for (int i = 0; i < FAST_INDEX_SIZE; i++) {
+        for (const index_entry_t* entry = staged->buckets[i]; entry; entry = entry->next) {
+            if (entry->mode != SPARSE_DIR_MODE) remove_if_untargeted(&prune, entry->path);
+        }
+    }
+    return prune.removed;
+}
+
+// What the work tree is known to hold: the stat cache of committed files,
+// overridden by the staged entries
+static fast_index_t* load_known_files(fast_index_t** staged_out) {
+    fast_index_t* known = fast_index_create();
+    fast_index_t* staged = fast_index_create();
+    if (!known || !staged || fast_index_load_file(known, INDEX_STAT_CACHE_PATH) != 0 ||
+        fast_index_load(staged) != 0) {
+        fast_index_free(known);
+        fast_index_free(staged);
+        return NULL;
+    }
+    for (int i = 0; i < FAST_INDEX_SIZE; i++) {
+        for (const index_entry_t* entry = staged->buckets[i]; entry; entry = entry->next) {
+            if (fast_index_set(known, entry->path, &entry->oid, entry->mode) == 0) {
+                ((index_entry_t*)fast_index_get(known, entry->path))->stat = entry->stat;
+            }
+        }
+    }
+    *staged_out = staged;
+    return known;
+}
+
 // Reset working directory to match a commit
 int reset_to_commit(const char* commit_hash, int hard_reset) {
     printf("Loading commit object: %s\n", commit_hash);
 
+    avc_oid_t commit_oid;
+    if (oid_from_hex(commit_hash, &commit_oid) != 0) {
+        fprintf(stderr, "Invalid commit hash: %s\n", commit_hash);
+        return -1;
+    }
+
     // Load commit object
     size_t commit_size;
     char commit_type[16];
     
     
     
-    char* commit_content = load_object(commit_hash, &commit_size, commit_type);
+    char* commit_content = load_object(&commit_oid, &commit_size, commit_type);
     if (!commit_content) {
         fprintf(stderr, "Failed to load commit object: %s\n", commit_hash);
         return -1;
@@ -197,7 +421,8 @@ int reset_to_commit(const char* commit_hash, int hard_reset) {
     free(commit_content);
     free(content_copy);
 
-    if (strlen(tree_hash) != 64) {
+    avc_oid_t tree_oid;
+    if (oid_from_hex(tree_hash, &tree_oid) != 0) {
         fprintf(stderr, "Invalid commit format - no tree hash found\n");
         return -1;
     }
@@ -210,7 +435,7 @@ int reset_to_commit(const char* commit_hash, int hard_reset) {
     
     
     
-    char* tree_content = load_object(tree_hash, &tree_size, tree_type);
+    char* tree_content = load_object(&tree_oid, &tree_size, tree_type);
     if (!tree_content) {
         fprintf(stderr, "Failed to load tree object: %s\n", tree_hash);
         return -1;
@@ -232,45 +457,94 @@ int reset_to_commit(const char* commit_hash, int hard_reset) {
     }
 
     // Flatten hierarchical tree into file list for batch processing
+    tree_files_t tree;
     file_entry_reset_t* files = NULL;
-    int file_count = 0, file_capacity = 0;
-    
-    if (flatten_tree_recursive(tree_hash, "", &files, &file_count, &file_capacity) != 0) {
+    if (tree_flatten(&tree_oid, "", TREE_FLATTEN_CONE, &tree) != 0 ||
+        !(files = calloc(tree.count + 1, sizeof(file_entry_reset_t)))) {
         fprintf(stderr, "Failed to flatten tree structure\n");
+        tree_files_free(&tree);
         fast_index_free(fast_idx);
-        if (files) free(files);
+        free(tree_content);
         return -1;
     }
+    int file_count = (int)tree.count;
+    for (int i = 0; i < file_count; i++) {
+        files[i].path = tree.files[i].path;
+        files[i].oid = tree.files[i].oid;
+        files[i].mode = tree.files[i].mode;
+    }
     
     // Batch process all files for maximum performance
-    int files_processed = 0;
+    int files_processed = 0, failed_count = 0;
     for (int i = 0; i < file_count; i++) {
-        if (fast_index_set(fast_idx, files[i].path, files[i].hash, files[i].mode) == 0) {
+        if (fast_index_set(fast_idx, files[i].path, &files[i].oid, files[i].mode) == 0) {
             files_processed++;
         }
     }
     
-    // Parallel file restoration if hard reset
+    // Hard reset: write only the files that differ, in parallel, and
+    // remove tracked files the target does not have
     if (hard_reset) {
-        #pragma omp parallel for schedule(dynamic, 64)
+        fast_index_t* staged = NULL;
+        fast_index_t* known = load_known_files(&staged);
+        reset_order_t* order = malloc((file_count + 1) * sizeof(reset_order_t));
+        if (!known || !order) {
+            fprintf(stderr, "Out of memory\n");
+            fast_index_free(known);
+            fast_index_free(staged);
+            free(order);
+            fast_index_free(fast_idx);
+            free(files);
+            tree_files_free(&tree);
+            free(tree_content);
+            return -1;
+        }
+        reset_job_t job = { files, order, known, NULL, NULL };
+        thread_pool_parallel_for(file_count, check_one_file, &job);
+        int removed = remove_untargeted_files(fast_idx, staged);
+        fast_index_free(known);
+        fast_index_free(staged);
+
+        int write_count = 0, collapsed_count = 0;
+        for (int i = 0; i < file_count; i++) {
+            if (files[i].write) {
+                const char* slash = strrchr(files[i].path, '/');
+                order[write_count++] = (reset_order_t){0, i, files[i].path, slash ? (size_t)(slash - files[i].path) : 0};
+            }
+            if (files[i].mode == SPARSE_DIR_MODE) collapsed_count++;
+        }
+        thread_pool_parallel_for(write_count, stat_restore_size, &job);
+        qsort(order, write_count, sizeof(reset_order_t), compare_restore_order);
+        if (restore_files(&job, (size_t)write_count) != 0) {
+            fprintf(stderr, "Out of memory; files were not written\n");
+        }
+        free(order);
+        blob_cache_trim();
+
+        // Recorded so that the next reset or add can trust these files;
+        // files that failed have none, so the next reset writes them again
+        int written_count = 0;
         for (int i = 0; i < file_count; i++) {
-            size_t file_size;
-            char file_type[16];
-            char* file_content = load_object(files[i].hash, &file_size, file_type);
-            
-            if (file_content && strcmp(file_type, "blob") == 0) {
-                // Remove ./ prefix for file creation
-                const char* file_path = files[i].path;
-                if (strncmp(file_path, "./", 2) == 0) file_path += 2;
-                
-                create_directory_recursive(file_path);
-                write_file(file_path, file_content, file_size);
-                free(file_content);
+            if (files[i].have_stat) fast_index_set_stat(fast_idx, files[i].path, &files[i].st);
+            if (files[i].written) {
+                written_count++;
+            } else if (files[i].write) {
+                fprintf(stderr, "Error: Failed to write %s\n", work_tree_path(files[i].path));
+                failed_count++;
             }
         }
+        printf("Wrote %d files, removed %d, %d already up to date\n", written_count, removed,
+               file_count - write_count - collapsed_count);
+        if (failed_count > 0) {
+            fprintf(stderr, "%d files could not be written\n", failed_count);
+        }
+        if (collapsed_count > 0) {
+            printf("%d directories outside the sparse checkout (%s)\n", collapsed_count, SPARSE_FILE);
+        }
     }
     
     free(files);
+    tree_files_free(&tree);
     
     free(tree_content);
     
@@ -335,7 +609,7 @@ int reset_to_commit(const char* commit_hash, int hard_reset) {
         fclose(head);
     }
 
-    return 0;
+    return failed_count > 0 ? -1 : 0;
 }
 
 int cmd_reset(int argc, char* argv[]) {
@@ -434,7 +708,9 @@ int cmd_reset(int argc, char* argv[]) {
 
             size_t commit_size;
             char commit_type[16];
-            char* commit_content = load_object(current_commit_hash, &commit_size, commit_type);
+            avc_oid_t current_oid;
+            char* commit_content = oid_from_hex(current_commit_hash, &current_oid) == 0
+                ? load_object(&current_oid, &commit_size, commit_type) : NULL;
             if (!commit_content || strcmp(commit_type, "commit") != 0) {
                 fprintf(stderr, "Failed to load HEAD commit object.\n");
                 if (commit_content) free(commit_content);
@@ -8,6 +8,8 @@
 #include "objects.h"
 #include "tui.h"
 #include "fast_index.h"
+#include "sparse.h"
+#include "tree_flatten.h"
 #include <stdint.h>
 
 // ANSI color codes
@@ -18,18 +20,16 @@
 // Check if we're in a repository
 int check_repo();
 
-// Get the tree hash from the last commit
-int get_last_commit_tree(char* tree_hash) {
+// Get the tree of the last commit: 1 if found, 0 if there is no commit yet
+int get_last_commit_tree(avc_oid_t* tree_oid) {
     FILE* head = fopen(".avc/HEAD", "r");
     if (!head) {
-        tree_hash[0] = '\0';
         return 0;
     }
 
     char head_content[256];
     if (!fgets(head_content, sizeof(head_content), head)) {
         fclose(head);
-        tree_hash[0] = '\0';
         return 0;
     }
     fclose(head);
@@ -44,27 +44,28 @@ int get_last_commit_tree(char* tree_hash) {
 
         FILE* branch_file = fopen(branch_path, "r");
         if (!branch_file) {
-            tree_hash[0] = '\0';
             return 0;
         }
 
-        char commit_hash[65];
-        if (fgets(commit_hash, 65, branch_file)) {
+        char commit_hash[AVC_OID_HEXSZ + 1];
+        avc_oid_t commit_oid;
+        if (fgets(commit_hash, sizeof(commit_hash), branch_file)) {
             commit_hash[strcspn(commit_hash, "\n")] = '\0';
         } else {
             fclose(branch_file);
-            tree_hash[0] = '\0';
             return 0;
         }
         fclose(branch_file);
+        if (oid_from_hex(commit_hash, &commit_oid) != 0) {
+            return 0;
+        }
 
         // Load commit object to get tree hash
         size_t commit_size;
         char commit_type[16];
-        char* commit_content = load_object(commit_hash, &commit_size, commit_type);
+        char* commit_content = load_object(&commit_oid, &commit_size, commit_type);
         if (!commit_content || strcmp(commit_type, "commit") != 0) {
             free(commit_content);
-            tree_hash[0] = '\0';
             return 0;
         }
 
@@ -72,7 +73,6 @@ int get_last_commit_tree(char* tree_hash) {
         char* content_copy = malloc(commit_size + 1);
         if (!content_copy) {
             free(commit_content);
-            tree_hash[0] = '\0';
             return 0;
         }
         memcpy(content_copy, commit_content, commit_size);
@@ -85,9 +85,7 @@ int get_last_commit_tree(char* tree_hash) {
         while ((line_end = strchr(line_start, '\n')) != NULL) {
             *line_end = '\0';
             if (strncmp(line_start, "tree ", 5) == 0) {
-                strncpy(tree_hash, line_start + 5, 64);
-                tree_hash[64] = '\0';
-                found = 1;
+                found = oid_from_hex(line_start + 5, tree_oid) == 0;
                 break;
             }
             line_start = line_end + 1;
@@ -95,20 +93,19 @@ int get_last_commit_tree(char* tree_hash) {
 
         free(commit_content);
         free(content_copy);
-        return found ? 0 : -1;
+        return found ? 1 : -1;
     }
 
-    tree_hash[0] = '\0';
     return 0;
 }
 
 // Check if file exists in tree with same hash
-int file_in_tree_with_hash(const char* tree_hash, const char* filepath, const char* hash) {
-    if (strlen(tree_hash) == 0) return 0; // No previous commit
+int file_in_tree_with_hash(const avc_oid_t* tree_oid, const char* filepath, const avc_oid_t* oid) {
+    if (!tree_oid) return 0; // No previous commit
 
     size_t tree_size;
     char tree_type[16];
-    char* tree_content = load_object(tree_hash, &tree_size, tree_type);
+    char* tree_content = load_object(tree_oid, &tree_size, tree_type);
     if (!tree_content || strcmp(tree_type, "tree") != 0) {
         free(tree_content);
         return 0;
@@ -128,10 +125,11 @@ int file_in_tree_with_hash(const char* tree_hash, const char* filepath, const ch
 
     while ((line_end = strchr(line_start, '\n')) != NULL) {
         *line_end = '\0';
-        char tree_mode[16], tree_path[256], tree_hash_from_tree[65];
+        char tree_mode[16], tree_path[256], tree_hash_from_tree[AVC_OID_HEXSZ + 1];
+        avc_oid_t entry_oid;
         if (sscanf(line_start, "%15s %255s %64s", tree_mode, tree_path, tree_hash_from_tree) == 3) {
             if (strcmp(tree_path, filepath) == 0) {
-                found = (strcmp(tree_hash_from_tree, hash) == 0);
+                found = oid_from_hex(tree_hash_from_tree, &entry_oid) == 0 && oid_equal(&entry_oid, oid);
                 break;
             }
         }
@@ -143,56 +141,6 @@ int file_in_tree_with_hash(const char* tree_hash, const char* filepath, const ch
     return found;
 }
 
-// Simple hash table for tree entries (open addressing, FNV-1a hash)
-#define TREE_TABLE_SIZE 4096
-
-typedef struct {
-    char path[256];
-    char hash[65];
-    int used;
-} tree_entry_t;
-
-static uint32_t fnv1a_hash(const char* s) {
-    uint32_t h = 2166136261u;
-    while (*s) h = (h ^ (unsigned char)*s++) * 16777619u;
-    return h;
-}
-
-// Parse tree content into hash table
-static void build_tree_table(const char* tree_content, size_t tree_size, tree_entry_t* table) {
-    char* content_copy = malloc(tree_size + 1);
-    memcpy(content_copy, tree_content, tree_size);
-    content_copy[tree_size] = '\0';
-    char* line = strtok(content_copy, "\n");
-    while (line) {
-        unsigned int mode; char path[256], hash[65];
-        if (sscanf(line, "%o %255s %64s", &mode, path, hash) == 3) {
-            uint32_t idx = fnv1a_hash(path) % TREE_TABLE_SIZE;
-            for (int i = 0; i < TREE_TABLE_SIZE; ++i) {
-                uint32_t j = (idx + i) % TREE_TABLE_SIZE;
-                if (!table[j].used) {
-                    strcpy(table[j].path, path);
-                    strcpy(table[j].hash, hash);
-                    table[j].used = 1;
-                    break;
-                }
-            }
-        }
-        line = strtok(NULL, "\n");
-    }
-    free(content_copy);
-}
-
-static const char* lookup_tree_hash(tree_entry_t* table, const char* path) {
-    uint32_t idx = fnv1a_hash(path) % TREE_TABLE_SIZE;
-    for (int i = 0; i < TREE_TABLE_SIZE; ++i) {
-        uint32_t j = (idx + i) % TREE_TABLE_SIZE;
-        if (!table[j].used) return NULL;
-        if (strcmp(table[j].path, path) == 0) return table[j].hash;
-    }
-    return NULL;
-}
-
 int cmd_status(int argc, char* argv[]) {
     if (check_repo() == -1) {
         return 1;
@@ -208,18 +156,14 @@ int cmd_status(int argc, char* argv[]) {
     }
 
     // Get the tree hash from the last commit
-    char last_tree_hash[65];
-    get_last_commit_tree(last_tree_hash);
+    avc_oid_t last_tree_oid;
+    int has_last_tree = get_last_commit_tree(&last_tree_oid) > 0;
 
-    // Load and parse last commit's tree ONCE
-    tree_entry_t* tree_table = calloc(TREE_TABLE_SIZE, sizeof(tree_entry_t));
-    if (strlen(last_tree_hash) > 0) {
-        size_t tree_size; char tree_type[16];
-        char* tree_content = load_object(last_tree_hash, &tree_size, tree_type);
-        if (tree_content && strcmp(tree_type, "tree") == 0) {
-            build_tree_table(tree_content, tree_size, tree_table);
-            free(tree_content);
-        }
+    // Flatten the last commit's tree once; collapsed directories stay collapsed
+    tree_files_t last_tree = {0};
+    if (has_last_tree && tree_flatten(&last_tree_oid, "", TREE_FLATTEN_CONE, &last_tree) != 0) {
+        tui_error("Failed to read the last commit's tree");
+        return 1;
     }
 
     // Use fast index for O(1) operations
@@ -227,11 +171,12 @@ int cmd_status(int argc, char* argv[]) {
     if (!fast_idx || fast_index_load(fast_idx) != 0) {
         tui_error("Failed to load index");
         if (fast_idx) fast_index_free(fast_idx);
-        free(tree_table);
+        tree_files_free(&last_tree);
         return 1;
     }
 
     int has_staged = 0;
+    size_t collapsed = 0;
     printf("Changes to be committed:\n");
     printf("  (use \"avc commit\" to commit)\n\n");
     
@@ -239,22 +184,34 @@ int cmd_status(int argc, char* argv[]) {
     for (int i = 0; i < FAST_INDEX_SIZE; i++) {
         index_entry_t* entry = fast_idx->buckets[i];
         while (entry) {
-            const char* old_hash = lookup_tree_hash(tree_table, entry->path);
-            if (old_hash && strcmp(old_hash, entry->hash) == 0) {
-                printf("  " ANSI_YELLOW "modified:   %s" ANSI_RESET "\n", entry->path);
-            } else {
+            if (entry->mode == SPARSE_DIR_MODE) {
+                // Outside the sparse checkout, so as in the last commit
+                collapsed++;
+                entry = entry->next;
+                continue;
+            }
+            const tree_file_t* old = tree_files_find(&last_tree, entry->path);
+            if (!old) {
                 printf("  " ANSI_BRIGHT_GREEN "new file:   %s" ANSI_RESET "\n", entry->path);
+                has_staged = 1;
+            } else if (!oid_equal(&old->oid, &entry->oid)) {
+                printf("  " ANSI_YELLOW "modified:   %s" ANSI_RESET "\n", entry->path);
+                has_staged = 1;
             }
-            has_staged = 1;
             entry = entry->next;
         }
     }
     
     fast_index_free(fast_idx);
-    free(tree_table);
+    tree_files_free(&last_tree);
     if (!has_staged) {
         printf("No changes to be committed.\n");
     }
     printf("\n");
+    if (collapsed > 0) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "%zu directories outside the sparse checkout", collapsed);
+        tui_info(msg);
+    }
     return 0;
 }
\ No newline at end of file
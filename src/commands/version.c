@@ -4,6 +4,8 @@
 #include <string.h>
 #include <omp.h>
 #include "commands.h"
+#include "thread_pool.h"
+#include <blake3.h>
 
 // Version information
 #define AVC_VERSION "0.4.0"
@@ -12,14 +14,19 @@
 #define AVC_BUILD_TIME __TIME__
 
 int cmd_version(int argc, char* argv[]) {
-    (void)argc; // Suppress unused parameter warning
-    (void)argv;
+    // argv[0] is "version"
+    if (argc > 1 && strcmp(argv[1], "--cpu") == 0) {
+        printf("BLAKE3 kernel: %s\n", blake3_kernel_name());
+        printf("Thread budget: %d\n", thread_pool_budget());
+        return 0;
+    }
     
     printf("AVC - Archive Version Control\n");
     printf("Version: %s \"%s\"\n", AVC_VERSION, AVC_CODENAME);
     printf("Build: %s %s\n", AVC_BUILD_DATE, AVC_BUILD_TIME);
     printf("Compile time: %s %s\n", __VERSION__, __DATE__);
     printf("OpenMP: %d threads available\n", omp_get_num_procs());
+    printf("Thread budget: %d (set AVC_THREADS to override)\n", thread_pool_budget());
     printf("\n");
     
     return 0;
@@ -0,0 +1,245 @@
+#define _GNU_SOURCE
+#include "blob_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#include "config.h"
+#include "objects.h"
+
+#define BLOB_CACHE_SECTION "cache"
+#define BLOB_CACHE_COPY_BUFFER (256 * 1024)
+// Eviction goes this far below the limit so that it does not run every time
+#define BLOB_CACHE_TRIM_PERCENT 90
+
+static struct {
+    int enabled;
+    int hardlinks;
+    uint64_t max_size;
+    char dir[PATH_MAX];
+} g_cache;
+static pthread_once_t g_cache_once = PTHREAD_ONCE_INIT;
+static _Atomic uint64_t g_stored_bytes;
+static atomic_flag g_use_warned = ATOMIC_FLAG_INIT;
+
+static void load_config(void) {
+    char value[PATH_MAX];
+    if (avc_config_get(BLOB_CACHE_SECTION, "blobs", value, sizeof(value)) != 0) return;
+    int flag = avc_config_get_bool(BLOB_CACHE_SECTION, "blobs", -1);
+    if (flag == 0 || !value[0]) return;
+    snprintf(g_cache.dir, sizeof(g_cache.dir), "%s", flag == 1 ? BLOB_CACHE_DEFAULT_DIR : value);
+    g_cache.max_size = avc_config_get_size(BLOB_CACHE_SECTION, "maxsize", BLOB_CACHE_DEFAULT_MAX);
+    g_cache.hardlinks = avc_config_get_bool(BLOB_CACHE_SECTION, "hardlinks", 0);
+    g_cache.enabled = 1;
+}
+
+int blob_cache_enabled(void) {
+    pthread_once(&g_cache_once, load_config);
+    return g_cache.enabled;
+}
+
+static void cache_path(const avc_oid_t* oid, char* path_out, size_t path_size) {
+    char hex[AVC_OID_HEXSZ + 1];
+    oid_to_hex(oid, hex);
+    snprintf(path_out, path_size, "%s/%.2s/%s", g_cache.dir, hex, hex + 2);
+}
+
+// Create every directory of path up to its last component
+static int make_parent_dirs(const char* path) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char* slash = strchr(dir + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        int failed = mkdir(dir, 0755) == -1 && errno != EEXIST;
+        *slash = '/';
+        if (failed) return -1;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Share the extents if the file system can, else copy in the kernel, else
+// through a buffer
+static int copy_contents(int in, int out) {
+#ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0) return 0;
+#endif
+    struct stat st;
+    if (fstat(in, &st) != 0) return -1;
+    off_t left = st.st_size;
+#ifdef __linux__
+    // Both offsets advance, so a partial copy continues below
+    while (left > 0) {
+        ssize_t n = copy_file_range(in, NULL, out, NULL, (size_t)left, 0);
+        if (n <= 0) break;
+        left -= n;
+    }
+    if (left == 0) return 0;
+#endif
+    char* buffer = malloc(BLOB_CACHE_COPY_BUFFER);
+    if (!buffer) return -1;
+    int result = 0;
+    while (result == 0) {
+        ssize_t n = read(in, buffer, BLOB_CACHE_COPY_BUFFER);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            result = n < 0 ? -1 : 0;
+            break;
+        }
+        result = write_all(out, buffer, (size_t)n);
+    }
+    free(buffer);
+    return result;
+}
+
+// Last use, for eviction. Setting the time needs ownership of the file,
+// which a cache shared between users may not give
+static void record_use(int fd) {
+    if (futimens(fd, NULL) != 0 && !atomic_flag_test_and_set(&g_use_warned)) {
+        fprintf(stderr, "Warning: Cannot record use of cached blobs in %s (%s); they are evicted in the order they were added\n",
+                g_cache.dir, strerror(errno));
+    }
+}
+
+int blob_cache_checkout(const avc_oid_t* oid, unsigned int mode, int dir_fd, const char* path) {
+    if (!blob_cache_enabled()) return -1;
+    char src[PATH_MAX];
+    cache_path(oid, src, sizeof(src));
+    int in = open(src, O_RDONLY);
+    if (in == -1) return -1;   // A miss leaves path as it was
+    record_use(in);
+
+    // A file linked to the cache must never be written through
+    unlinkat(dir_fd, path, 0);
+
+    // Cache files are 0444, so executables are always copied
+    unsigned int file_mode = checkout_file_mode(mode);
+    if (g_cache.hardlinks && !(file_mode & 0111) && linkat(AT_FDCWD, src, dir_fd, path, 0) == 0) {
+        close(in);
+        return 0;
+    }
+    int out = openat(dir_fd, path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out == -1) {
+        close(in);
+        return -1;
+    }
+    int result = copy_contents(in, out);
+    if (result == 0 && fchmod(out, file_mode) != 0) result = -1;
+    close(in);
+    if (close(out) != 0) result = -1;
+    if (result != 0) unlinkat(dir_fd, path, 0);
+    return result;
+}
+
+void blob_cache_store(const avc_oid_t* oid, int dir_fd, const char* src) {
+    if (!blob_cache_enabled()) return;
+    char path[PATH_MAX];
+    cache_path(oid, path, sizeof(path));
+    if (access(path, F_OK) == 0 || make_parent_dirs(path) != 0) return;
+    int in = openat(dir_fd, src, O_RDONLY);
+    if (in == -1) return;
+
+    // Complete files only: concurrent checkouts may share the directory
+    char tmp_path[PATH_MAX + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp-XXXXXX", path);
+    int fd = mkstemp(tmp_path);
+    struct stat st;
+    int result = fd != -1 && fstat(in, &st) == 0 ? copy_contents(in, fd) : -1;
+    close(in);
+    if (fd == -1) return;
+    if (fchmod(fd, 0444) != 0 || close(fd) != 0) result = -1;
+    if (result == 0 && rename(tmp_path, path) == 0) {
+        atomic_fetch_add(&g_stored_bytes, (uint64_t)st.st_size);
+    } else {
+        unlink(tmp_path);
+    }
+}
+
+typedef struct {
+    int64_t used_sec;
+    int64_t used_nsec;
+    uint64_t size;
+    char name[AVC_OID_HEXSZ + 1];   // The hex, without the slash after its first two digits
+} cache_file_t;
+
+static int compare_last_use(const void* a, const void* b) {
+    const cache_file_t* x = a;
+    const cache_file_t* y = b;
+    if (x->used_sec != y->used_sec) return x->used_sec < y->used_sec ? -1 : 1;
+    return x->used_nsec < y->used_nsec ? -1 : x->used_nsec > y->used_nsec;
+}
+
+void blob_cache_trim(void) {
+    if (!blob_cache_enabled() || atomic_exchange(&g_stored_bytes, 0) == 0) return;
+    DIR* top = opendir(g_cache.dir);
+    if (!top) return;
+
+    cache_file_t* files = NULL;
+    size_t count = 0, capacity = 0;
+    uint64_t total = 0;
+    struct dirent* sub;
+    while ((sub = readdir(top)) != NULL) {
+        if (strlen(sub->d_name) != 2 || sub->d_name[0] == '.') continue;
+        char dir[PATH_MAX];
+        if (snprintf(dir, sizeof(dir), "%s/%s", g_cache.dir, sub->d_name) >= (int)sizeof(dir)) continue;
+        DIR* d = opendir(dir);
+        struct dirent* entry;
+        while (d && (entry = readdir(d)) != NULL) {
+            if (strlen(entry->d_name) != AVC_OID_HEXSZ - 2) continue;
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 1024;
+                cache_file_t* grown = realloc(files, capacity * sizeof(cache_file_t));
+                if (!grown) break;
+                files = grown;
+            }
+            cache_file_t* file = &files[count];
+            struct stat st;
+            if (fstatat(dirfd(d), entry->d_name, &st, 0) != 0) continue;
+            memcpy(file->name, sub->d_name, 2);
+            memcpy(file->name + 2, entry->d_name, AVC_OID_HEXSZ - 1);
+            file->used_sec = st.st_mtim.tv_sec;
+            file->used_nsec = st.st_mtim.tv_nsec;
+            file->size = (uint64_t)st.st_size;
+            total += file->size;
+            count++;
+        }
+        if (d) closedir(d);
+    }
+    closedir(top);
+
+    if (total > g_cache.max_size) {
+        uint64_t target = g_cache.max_size / 100 * BLOB_CACHE_TRIM_PERCENT;
+        qsort(files, count, sizeof(cache_file_t), compare_last_use);
+        for (size_t i = 0; i < count && total > target; i++) {
+            char path[PATH_MAX];
+            if (snprintf(path, sizeof(path), "%s/%.2s/%s", g_cache.dir, files[i].name, files[i].name + 2) >=
+                (int)sizeof(path)) {
+                continue;
+            }
+            if (unlink(path) == 0) total -= files[i].size;
+        }
+    }
+    free(files);
+}
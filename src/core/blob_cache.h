@@ -0,0 +1,42 @@
+#ifndef BLOB_CACHE_H
+#define BLOB_CACHE_H
+
+#include <stddef.h>
+#include "oid.h"
+
+// Uncompressed copies of blobs for checkouts that repeat (CI runners).
+// Enabled in .avc/config:
+//
+//   [cache]
+//       blobs = true           # .avc/cache/blobs, or a directory to share
+//       maxsize = 2G           # least recently used blobs go first beyond it
+//       hardlinks = false      # link files read-only instead of copying
+//
+// A cached blob is materialized with a FICLONE reflink where the file
+// system shares extents (btrfs, XFS), else copy_file_range, else plain
+// copies; with hardlinks the work tree file is the cache file itself and
+// is made read-only, so edits must replace it rather than write through
+// (executables are still copied, as they need their own mode).
+// Cache files are named <aa>/<rest of hex> and their mtime is the last use.
+
+#define BLOB_CACHE_DEFAULT_DIR ".avc/cache/blobs"
+#define BLOB_CACHE_DEFAULT_MAX (2ULL << 30)
+
+// Nonzero if the cache is configured (read once)
+int blob_cache_enabled(void);
+
+// Create path relative to dir_fd (or AT_FDCWD), replacing any file there,
+// from the cached blob, with checkout_file_mode(mode) for the tree entry
+// mode. Executables are copied even with hardlinks. 0 on a hit; -1 on a
+// miss or error, with path left for the caller to write. Thread-safe.
+int blob_cache_checkout(const avc_oid_t* oid, unsigned int mode, int dir_fd, const char* path);
+
+// Add a blob checked out to path on a miss (cloned where possible).
+// Thread-safe; failures only cost a later miss.
+void blob_cache_store(const avc_oid_t* oid, int dir_fd, const char* path);
+
+// Evict least recently used blobs if stores since the last call may have
+// pushed the cache over its size limit
+void blob_cache_trim(void);
+
+#endif // BLOB_CACHE_H
@@ -1,10 +1,17 @@
 #include "compression.h"
+#include "thread_pool.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <zstd.h>
-#include <omp.h>
 
-// Multi-threaded zstd contexts (thread-local)
+// Inputs above this are cut into independent zstd frames compressed on the
+// thread pool. ZSTD_decompress() handles concatenated frames transparently.
+#define SPLIT_THRESHOLD (8 * 1024 * 1024)
+#define SPLIT_FRAME_SIZE (4 * 1024 * 1024)
+
+// Single-threaded zstd contexts (thread-local). Parallelism comes from the
+// shared thread pool, never from zstd's own workers.
 static __thread ZSTD_CCtx* g_cctx = NULL;
 static __thread ZSTD_DCtx* g_dctx = NULL;
 
@@ -12,18 +19,89 @@ static __thread ZSTD_DCtx* g_dctx = NULL;
 static void init_zstd_contexts(void) {
     if (!g_cctx) {
         g_cctx = ZSTD_createCCtx();
-        if (g_cctx) {
-            // Enable multi-threading
-            int num_threads = omp_get_num_procs();
-            ZSTD_CCtx_setParameter(g_cctx, ZSTD_c_nbWorkers, num_threads);
-            ZSTD_CCtx_setParameter(g_cctx, ZSTD_c_jobSize, 1024*1024); // 1MB jobs
-        }
     }
     if (!g_dctx) {
         g_dctx = ZSTD_createDCtx();
     }
 }
 
+static size_t compress_frame(char* dst, size_t dst_cap, const char* src, size_t size, int level) {
+    init_zstd_contexts();
+    if (g_cctx) {
+        return ZSTD_compressCCtx(g_cctx, dst, dst_cap, src, size, level);
+    }
+    return ZSTD_compress(dst, dst_cap, src, size, level);
+}
+
+typedef struct {
+    const char* data;
+    size_t size;
+    int level;
+    char** frames;
+    size_t* frame_sizes;
+} split_job_t;
+
+static void compress_split_frame(void* ctx, size_t index) {
+    split_job_t* job = ctx;
+    size_t offset = index * SPLIT_FRAME_SIZE;
+    size_t len = job->size - offset < SPLIT_FRAME_SIZE ? job->size - offset : SPLIT_FRAME_SIZE;
+
+    size_t bound = ZSTD_compressBound(len);
+    char* frame = malloc(bound);
+    if (!frame) return;
+
+    size_t result = compress_frame(frame, bound, job->data + offset, len, job->level);
+    if (ZSTD_isError(result)) {
+        free(frame);
+        return;
+    }
+    job->frames[index] = frame;
+    job->frame_sizes[index] = result;
+}
+
+// Compress a large buffer as several frames in parallel and concatenate them
+static char* compress_split(const char* data, size_t size, size_t* compressed_size, int level) {
+    *compressed_size = 0;
+    size_t frame_count = (size + SPLIT_FRAME_SIZE - 1) / SPLIT_FRAME_SIZE;
+    split_job_t job = { data, size, level, NULL, NULL };
+    job.frames = calloc(frame_count, sizeof(char*));
+    job.frame_sizes = calloc(frame_count, sizeof(size_t));
+    if (!job.frames || !job.frame_sizes) {
+        free(job.frames);
+        free(job.frame_sizes);
+        return NULL;
+    }
+
+    task_group_t group;
+    task_group_init(&group);
+    for (size_t i = 0; i < frame_count; i++) {
+        thread_pool_spawn(&group, compress_split_frame, &job, i);
+    }
+    thread_pool_wait(&group);
+
+    size_t total = 0;
+    int failed = 0;
+    for (size_t i = 0; i < frame_count; i++) {
+        if (!job.frames[i]) failed = 1;
+        total += job.frame_sizes[i];
+    }
+
+    char* compressed = failed ? NULL : malloc(total);
+    if (compressed) {
+        size_t offset = 0;
+        for (size_t i = 0; i < frame_count; i++) {
+            memcpy(compressed + offset, job.frames[i], job.frame_sizes[i]);
+            offset += job.frame_sizes[i];
+        }
+        *compressed_size = total;
+    }
+
+    for (size_t i = 0; i < frame_count; i++) free(job.frames[i]);
+    free(job.frames);
+    free(job.frame_sizes);
+    return compressed;
+}
+
 // Global compression backend
 static avc_compression_type_t g_compression_backend = AVC_COMPRESS_ZSTD;
 
@@ -60,20 +138,16 @@ char* avc_compress(const char* data, size_t size, size_t* compressed_size,
                    avc_compression_type_t type, int level) {
     switch (type) {
         case AVC_COMPRESS_ZSTD: {
-            init_zstd_contexts();
-            
+            // Huge inputs are split across the thread pool
+            if (size > SPLIT_THRESHOLD && thread_pool_budget() > 1) {
+                return compress_split(data, size, compressed_size, level);
+            }
+
             size_t max_size = ZSTD_compressBound(size);
             char* compressed = malloc(max_size);
             if (!compressed) return NULL;
             
-            // Multi-threaded compression for large files
-            size_t result;
-            if (size > 1024*1024 && g_cctx) { // >1MB = multi-threaded
-                ZSTD_CCtx_setParameter(g_cctx, ZSTD_c_compressionLevel, level);
-                result = ZSTD_compress2(g_cctx, compressed, max_size, data, size);
-            } else {
-                result = ZSTD_compress(compressed, max_size, data, size, level);
-            }
+            size_t result = compress_frame(compressed, max_size, data, size, level);
             
             if (ZSTD_isError(result)) {
                 free(compressed);
@@ -102,9 +176,9 @@ char* avc_decompress(const char* compressed_data, size_t compressed_size,
             char* decompressed = malloc(expected_size);
             if (!decompressed) return NULL;
             
-            // Multi-threaded decompression for large files
+            // Reuse the thread-local context for large objects
             size_t result;
-            if (expected_size > 1024*1024 && g_dctx) { // >1MB = multi-threaded
+            if (expected_size > 1024*1024 && g_dctx) {
                 result = ZSTD_decompressDCtx(g_dctx, decompressed, expected_size, compressed_data, compressed_size);
             } else {
                 result = ZSTD_decompress(decompressed, expected_size, compressed_data, compressed_size);
@@ -127,6 +201,22 @@ char* avc_decompress(const char* compressed_data, size_t compressed_size,
     return NULL;
 }
 
+size_t avc_decompressed_size(const char* compressed_data, size_t compressed_size) {
+    size_t total = 0;
+    while (compressed_size > 0) {
+        unsigned long long frame_size = ZSTD_getFrameContentSize(compressed_data, compressed_size);
+        size_t frame_len = ZSTD_findFrameCompressedSize(compressed_data, compressed_size);
+        if (frame_size == ZSTD_CONTENTSIZE_ERROR || frame_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+            ZSTD_isError(frame_len)) {
+            return 0;
+        }
+        total += (size_t)frame_size;
+        compressed_data += frame_len;
+        compressed_size -= frame_len;
+    }
+    return total;
+}
+
 // Cleanup compression contexts
 void avc_cleanup_compression_contexts(void) {
     if (g_cctx) {
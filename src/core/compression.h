@@ -16,6 +16,9 @@ char* avc_compress(const char* data, size_t size, size_t* compressed_size,
 char* avc_decompress(const char* compressed_data, size_t compressed_size, 
                      size_t expected_size, avc_compression_type_t type);
 
+// Total decompressed size across all frames, or 0 if the frames don't record it
+size_t avc_decompressed_size(const char* compressed_data, size_t compressed_size);
+
 // Auto-detect compression type from header
 avc_compression_type_t avc_detect_compression_type(const char* data, size_t size);
 
@@ -0,0 +1,160 @@
+#define _XOPEN_SOURCE 700
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <limits.h>
+
+#define CONFIG_LINE_MAX 1024
+
+// Trim whitespace in place and return the start
+static char* trim(char* s) {
+    while (isspace((unsigned char)*s)) s++;
+    char* end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+// "[name]" -> name; NULL if the line is not a section header
+static char* parse_section(char* line) {
+    line = trim(line);
+    size_t len = strlen(line);
+    if (len < 2 || line[0] != '[' || line[len - 1] != ']') return NULL;
+    line[len - 1] = '\0';
+    return trim(line + 1);
+}
+
+// "key = value" -> key and value; -1 for comments and lines without '='
+static int parse_entry(char* line, char** key_out, char** value_out) {
+    line = trim(line);
+    if (line[0] == '#' || line[0] == ';') return -1;
+    char* eq = strchr(line, '=');
+    if (!eq) return -1;
+    *eq = '\0';
+    *key_out = trim(line);
+    *value_out = trim(eq + 1);
+    return 0;
+}
+
+int avc_config_get(const char* section, const char* key, char* value_out, size_t value_size) {
+    FILE* f = fopen(AVC_CONFIG_FILE, "r");
+    if (!f) return -1;
+
+    char line[CONFIG_LINE_MAX];
+    int in_section = 0;
+    int found = -1;
+    while (fgets(line, sizeof(line), f)) {
+        char scratch[CONFIG_LINE_MAX];
+        memcpy(scratch, line, sizeof(scratch));
+        char* name = parse_section(scratch);
+        if (name) {
+            in_section = strcasecmp(name, section) == 0;
+            continue;
+        }
+        char *k, *v;
+        if (!in_section) continue;
+        if (parse_entry(line, &k, &v) == 0 && strcasecmp(k, key) == 0) {
+            // Last assignment wins, as in Git
+            snprintf(value_out, value_size, "%s", v);
+            found = 0;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+int avc_config_get_bool(const char* section, const char* key, int default_value) {
+    char value[64];
+    if (avc_config_get(section, key, value, sizeof(value)) != 0) return default_value;
+
+    if (!strcasecmp(value, "true") || !strcasecmp(value, "yes") ||
+        !strcasecmp(value, "on") || !strcmp(value, "1")) {
+        return 1;
+    }
+    if (!strcasecmp(value, "false") || !strcasecmp(value, "no") ||
+        !strcasecmp(value, "off") || !strcmp(value, "0")) {
+        return 0;
+    }
+    return default_value;
+}
+
+int avc_config_get_int(const char* section, const char* key, int default_value) {
+    char value[64];
+    if (avc_config_get(section, key, value, sizeof(value)) != 0) return default_value;
+
+    char* end;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < INT_MIN || parsed > INT_MAX) return default_value;
+    return (int)parsed;
+}
+
+uint64_t avc_config_get_size(const char* section, const char* key, uint64_t default_value) {
+    char value[64];
+    if (avc_config_get(section, key, value, sizeof(value)) != 0) return default_value;
+
+    char* end;
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if (end == value || value[0] == '-') return default_value;
+    int shift = 0;
+    switch (tolower((unsigned char)*end)) {
+    case '\0': break;
+    case 'k': shift = 10; break;
+    case 'm': shift = 20; break;
+    case 'g': shift = 30; break;
+    default: return default_value;
+    }
+    if (*end && end[1] != '\0') return default_value;
+    return (uint64_t)parsed << shift;
+}
+
+int avc_config_set(const char* section, const char* key, const char* value) {
+    // Rewrite the file line by line into a temporary and rename it over
+    char tmp_path[] = AVC_CONFIG_FILE ".lock";
+    FILE* out = fopen(tmp_path, "w");
+    if (!out) return -1;
+
+    FILE* in = fopen(AVC_CONFIG_FILE, "r");
+    char line[CONFIG_LINE_MAX];
+    int in_section = 0, written = 0;
+    while (in && fgets(line, sizeof(line), in)) {
+        char scratch[CONFIG_LINE_MAX];
+        memcpy(scratch, line, sizeof(scratch));
+        char* name = parse_section(scratch);
+        if (name) {
+            // Leaving our section without having seen the key: add it here
+            if (in_section && !written && value) {
+                fprintf(out, "    %s = %s\n", key, value);
+                written = 1;
+            }
+            in_section = strcasecmp(name, section) == 0;
+            fputs(line, out);
+            continue;
+        }
+
+        char *k, *v;
+        memcpy(scratch, line, sizeof(scratch));
+        if (in_section && parse_entry(scratch, &k, &v) == 0 && strcasecmp(k, key) == 0) {
+            if (value && !written) {
+                fprintf(out, "    %s = %s\n", key, value);
+                written = 1;
+            }
+            continue;
+        }
+        fputs(line, out);
+    }
+    if (in) fclose(in);
+
+    if (!written && value) {
+        if (!in_section) fprintf(out, "[%s]\n", section);
+        fprintf(out, "    %s = %s\n", key, value);
+    }
+
+    if (fclose(out) != 0 || rename(tmp_path, AVC_CONFIG_FILE) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
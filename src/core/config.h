@@ -0,0 +1,31 @@
+#ifndef AVC_CONFIG_H
+#define AVC_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Repository settings in .avc/config, Git-style INI:
+//
+//   [section]
+//       key = value
+//
+// Sections and keys are matched case-insensitively.
+
+#define AVC_CONFIG_FILE ".avc/config"
+
+// Copy a value into value_out; 0 if found, -1 if missing
+int avc_config_get(const char* section, const char* key, char* value_out, size_t value_size);
+
+// true/yes/on/1 and false/no/off/0; anything else gives default_value
+int avc_config_get_bool(const char* section, const char* key, int default_value);
+
+// Decimal integer value, or default_value if missing or malformed
+int avc_config_get_int(const char* section, const char* key, int default_value);
+
+// Byte count with an optional k/M/G suffix (binary), or default_value
+uint64_t avc_config_get_size(const char* section, const char* key, uint64_t default_value);
+
+// Set a value, adding the section and key if needed (NULL value removes it)
+int avc_config_set(const char* section, const char* key, const char* value);
+
+#endif // AVC_CONFIG_H
@@ -1,3 +1,4 @@
+#define _XOPEN_SOURCE 700
 #include "fast_index.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -24,21 +25,38 @@ fast_index_t* fast_index_create(void) {
 }
 
 int fast_index_load(fast_index_t* idx) {
+    return fast_index_load_file(idx, ".avc/index");
+}
+
+int fast_index_load_file(fast_index_t* idx, const char* path) {
     if (!idx || idx->loaded) return 0;
     
-    FILE* f = fopen(".avc/index", "r");
+    FILE* f = fopen(path, "r");
     if (!f) {
         idx->loaded = 1;
         return 0; // Empty index is OK
     }
     
+    // "<hash> <path> <mode>", optionally followed by the stat data
+    // "<size> <mtime> <mtime_ns> <ctime> <ctime_ns> <dev> <ino>"
     char line[1024];
     while (fgets(line, sizeof(line), f)) {
-        char hash[MAX_HASH_LEN], path[MAX_PATH_LEN];
+        char hash[AVC_OID_HEXSZ + 1], entry_path[MAX_PATH_LEN];
         uint32_t mode;
+        avc_oid_t oid;
+        int used = 0;
         
-        if (sscanf(line, "%64s %255s %o", hash, path, &mode) == 3) {
-            fast_index_set(idx, path, hash, mode);
+        if (sscanf(line, "%64s %255s %o%n", hash, entry_path, &mode, &used) == 3 &&
+            oid_from_hex(hash, &oid) == 0) {
+            fast_index_set(idx, entry_path, &oid, mode);
+
+            unsigned long long size, dev, ino;
+            long long mtime_sec, mtime_nsec, ctime_sec, ctime_nsec;
+            if (sscanf(line + used, " %llu %lld %lld %lld %lld %llu %llu", &size, &mtime_sec, &mtime_nsec,
+                       &ctime_sec, &ctime_nsec, &dev, &ino) == 7) {
+                index_entry_t* entry = (index_entry_t*)fast_index_get(idx, entry_path);
+                entry->stat = (index_stat_t){size, mtime_sec, mtime_nsec, ctime_sec, ctime_nsec, dev, ino};
+            }
         }
     }
     
@@ -64,8 +82,8 @@ const index_entry_t* fast_index_get(fast_index_t* idx, const char* path) {
     return NULL;
 }
 
-int fast_index_set(fast_index_t* idx, const char* path, const char* hash, uint32_t mode) {
-    if (!idx || !path || !hash) return -1;
+int fast_index_set(fast_index_t* idx, const char* path, const avc_oid_t* oid, uint32_t mode) {
+    if (!idx || !path || !oid) return -1;
     
     const char* norm_path = normalize_path(path);
     uint32_t bucket = hash_path(norm_path);
@@ -75,9 +93,9 @@ int fast_index_set(fast_index_t* idx, const char* path, const char* hash, uint32
     while (entry) {
         if (strcmp(entry->path, norm_path) == 0) {
             // Update existing entry
-            strncpy(entry->hash, hash, MAX_HASH_LEN - 1);
-            entry->hash[MAX_HASH_LEN - 1] = '\0';
+            entry->oid = *oid;
             entry->mode = mode;
+            memset(&entry->stat, 0, sizeof(entry->stat));
             return 0;
         }
         entry = entry->next;
@@ -89,9 +107,9 @@ int fast_index_set(fast_index_t* idx, const char* path, const char* hash, uint32
     
     strncpy(entry->path, norm_path, MAX_PATH_LEN - 1);
     entry->path[MAX_PATH_LEN - 1] = '\0';
-    strncpy(entry->hash, hash, MAX_HASH_LEN - 1);
-    entry->hash[MAX_HASH_LEN - 1] = '\0';
+    entry->oid = *oid;
     entry->mode = mode;
+    memset(&entry->stat, 0, sizeof(entry->stat));
     entry->next = idx->buckets[bucket];
     
     idx->buckets[bucket] = entry;
@@ -100,6 +118,31 @@ int fast_index_set(fast_index_t* idx, const char* path, const char* hash, uint32
     return 0;
 }
 
+int fast_index_set_stat(fast_index_t* idx, const char* path, const struct stat* st) {
+    index_entry_t* entry = (index_entry_t*)fast_index_get(idx, path);
+    if (!entry || !st) return -1;
+    entry->stat.size = (uint64_t)st->st_size;
+    entry->stat.mtime_sec = (int64_t)st->st_mtim.tv_sec;
+    entry->stat.mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+    entry->stat.ctime_sec = (int64_t)st->st_ctim.tv_sec;
+    entry->stat.ctime_nsec = (int64_t)st->st_ctim.tv_nsec;
+    entry->stat.dev = (uint64_t)st->st_dev;
+    entry->stat.ino = (uint64_t)st->st_ino;
+    return 0;
+}
+
+int fast_index_stat_matches(const index_entry_t* entry, const struct stat* st) {
+    const index_stat_t* s = &entry->stat;
+    return s->ino != 0 &&
+           s->size == (uint64_t)st->st_size &&
+           s->mtime_sec == (int64_t)st->st_mtim.tv_sec &&
+           s->mtime_nsec == (int64_t)st->st_mtim.tv_nsec &&
+           s->ctime_sec == (int64_t)st->st_ctim.tv_sec &&
+           s->ctime_nsec == (int64_t)st->st_ctim.tv_nsec &&
+           s->dev == (uint64_t)st->st_dev &&
+           s->ino == (uint64_t)st->st_ino;
+}
+
 int fast_index_remove(fast_index_t* idx, const char* path) {
     if (!idx || !path) return -1;
     
@@ -122,16 +165,32 @@ int fast_index_remove(fast_index_t* idx, const char* path) {
 }
 
 int fast_index_commit(fast_index_t* idx) {
+    return fast_index_commit_file(idx, ".avc/index");
+}
+
+int fast_index_commit_file(fast_index_t* idx, const char* path) {
     if (!idx) return -1;
     
-    FILE* f = fopen(".avc/index.tmp", "w");
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* f = fopen(tmp_path, "w");
     if (!f) return -1;
     
     // Write all entries
+    char hex[AVC_OID_HEXSZ + 1];
     for (int i = 0; i < FAST_INDEX_SIZE; i++) {
         index_entry_t* entry = idx->buckets[i];
         while (entry) {
-            fprintf(f, "%s %s %o\n", entry->hash, entry->path, entry->mode);
+            oid_to_hex(&entry->oid, hex);
+            const index_stat_t* st = &entry->stat;
+            if (st->ino != 0) {
+                fprintf(f, "%s %s %o %llu %lld %lld %lld %lld %llu %llu\n", hex, entry->path, entry->mode,
+                        (unsigned long long)st->size, (long long)st->mtime_sec, (long long)st->mtime_nsec,
+                        (long long)st->ctime_sec, (long long)st->ctime_nsec,
+                        (unsigned long long)st->dev, (unsigned long long)st->ino);
+            } else {
+                fprintf(f, "%s %s %o\n", hex, entry->path, entry->mode);
+            }
             entry = entry->next;
         }
     }
@@ -139,8 +198,8 @@ int fast_index_commit(fast_index_t* idx) {
     fclose(f);
     
     // Atomic replace
-    if (rename(".avc/index.tmp", ".avc/index") != 0) {
-        remove(".avc/index.tmp");
+    if (rename(tmp_path, path) != 0) {
+        remove(tmp_path);
         return -1;
     }
     
@@ -162,7 +221,7 @@ void fast_index_free(fast_index_t* idx) {
     free(idx);
 }
 
-const char* fast_index_get_hash(fast_index_t* idx, const char* path) {
+const avc_oid_t* fast_index_get_oid(fast_index_t* idx, const char* path) {
     const index_entry_t* entry = fast_index_get(idx, path);
-    return entry ? entry->hash : NULL;
+    return entry ? &entry->oid : NULL;
 }
\ No newline at end of file
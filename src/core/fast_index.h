@@ -3,16 +3,30 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/stat.h>
+#include "oid.h"
 
 // Fast hash table index for O(1) lookups
 #define FAST_INDEX_SIZE 8192
 #define MAX_PATH_LEN 256
-#define MAX_HASH_LEN 65
+
+// Stat data of a file when it was hashed; all zero if unknown. A file whose
+// stat data still matches has not changed since.
+typedef struct {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+    uint64_t dev;
+    uint64_t ino;
+} index_stat_t;
 
 typedef struct index_entry {
     char path[MAX_PATH_LEN];
-    char hash[MAX_HASH_LEN];
+    avc_oid_t oid;
     uint32_t mode;
+    index_stat_t stat;
     struct index_entry* next; // Chaining for collisions
 } index_entry_t;
 
@@ -28,11 +42,20 @@ fast_index_t* fast_index_create(void);
 // Load index from file into hash table
 int fast_index_load(fast_index_t* idx);
 
+// Same for another file in the index format (e.g. the stat cache)
+int fast_index_load_file(fast_index_t* idx, const char* path);
+
 // Get entry by path (O(1) average case)
 const index_entry_t* fast_index_get(fast_index_t* idx, const char* path);
 
-// Insert/update entry (O(1) average case)
-int fast_index_set(fast_index_t* idx, const char* path, const char* hash, uint32_t mode);
+// Insert/update entry (O(1) average case); its stat data is cleared
+int fast_index_set(fast_index_t* idx, const char* path, const avc_oid_t* oid, uint32_t mode);
+
+// Record the stat data of an existing entry
+int fast_index_set_stat(fast_index_t* idx, const char* path, const struct stat* st);
+
+// Nonzero if the entry's stat data is known and matches st
+int fast_index_stat_matches(const index_entry_t* entry, const struct stat* st);
 
 // Remove entry (O(1) average case)
 int fast_index_remove(fast_index_t* idx, const char* path);
@@ -40,10 +63,13 @@ int fast_index_remove(fast_index_t* idx, const char* path);
 // Write hash table back to file
 int fast_index_commit(fast_index_t* idx);
 
+// Write hash table to another file, replacing it atomically
+int fast_index_commit_file(fast_index_t* idx, const char* path);
+
 // Free hash table
 void fast_index_free(fast_index_t* idx);
 
-// Get hash for path (convenience function)
-const char* fast_index_get_hash(fast_index_t* idx, const char* path);
+// Get object ID for path (convenience function)
+const avc_oid_t* fast_index_get_oid(fast_index_t* idx, const char* path);
 
 #endif // FAST_INDEX_H
\ No newline at end of file
@@ -2,45 +2,127 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <string.h>
+#include <pthread.h>
 #include <blake3.h> // BLAKE3 reference implementation
 #include "hash.h"
+#include "thread_pool.h"
 #define HASH_SIZE 64
-void blake3_hash(const char* content, size_t size, char* hash_out) {
-    uint8_t digest[32];
+
+// Smallest subtree worth handing to another thread
+#define HASH_MIN_SUBTREE (128 * 1024)
+
+typedef struct {
+    void (*task)(void* arg);
+    void* arg;
+} join_half_t;
+
+static void run_join_half(void* ctx, size_t index) {
+    (void)index;
+    join_half_t* half = ctx;
+    half->task(half->arg);
+}
+
+// BLAKE3 join backend: right subtree goes to the pool, left runs here
+static void pool_join(void (*task)(void* arg), void* left, void* right) {
+    join_half_t right_half = { task, right };
+    task_group_t group;
+    task_group_init(&group);
+    thread_pool_spawn(&group, run_join_half, &right_half, 0);
+    task(left);
+    thread_pool_wait(&group);
+}
+
+static pthread_once_t g_join_once = PTHREAD_ONCE_INIT;
+
+static void install_join_hook(void) {
+    if (thread_pool_budget() > 1) {
+        blake3_set_join_hook(pool_join, HASH_MIN_SUBTREE);
+    }
+}
+
+void blake3_hash_update(blake3_hasher* hasher, const void* data, size_t size) {
+    if (size < HASH_PARALLEL_THRESHOLD) {
+        blake3_hasher_update(hasher, data, size);
+        return;
+    }
+    pthread_once(&g_join_once, install_join_hook);
+    blake3_hasher_update_parallel(hasher, data, size);
+}
+
+void blake3_hash_resume_update(blake3_resume_state* state, const void* data, size_t size) {
+    int parallel = size >= HASH_PARALLEL_THRESHOLD;
+    if (parallel) pthread_once(&g_join_once, install_join_hook);
+    blake3_resume_update(state, data, size, parallel);
+}
+
+void blake3_hash(const char* content, size_t size, avc_oid_t* oid_out) {
     blake3_hasher hasher;
     blake3_hasher_init(&hasher);
-    blake3_hasher_update(&hasher, content, size);
-    blake3_hasher_finalize(&hasher, digest, 32);
-    for (int i = 0; i < 32; i++) {
-        sprintf(hash_out + (i * 2), "%02x", digest[i]);
-    }
-    hash_out[64] = '\0';
+    blake3_hash_update(&hasher, content, size);
+    blake3_hasher_finalize(&hasher, oid_out->bytes, AVC_OID_RAWSZ);
 }
 
 // Hash with Git-style object format using BLAKE3
 // Git prepends "blob <size>\0" before hashing (same as before)
-void blake3_hash_object(const char* type, const char* content, size_t size, char* hash_out) {
+void blake3_hash_object(const char* type, const char* content, size_t size, avc_oid_t* oid_out) {
     // Create Git-style object format
     char header[64];
     int header_len = snprintf(header, sizeof(header), "%s %zu", type, size);
 
-    // Allocate buffer for header + null byte + content
-    size_t total_size = header_len + 1 + size;
-    char* full_content = malloc(total_size);
-    if (!full_content) {
-        fprintf(stderr, "Memory allocation failed\n");
+    // Hash header (with its null byte) and content without copying them together
+    blake3_hasher hasher;
+    blake3_hasher_init(&hasher);
+    blake3_hasher_update(&hasher, header, header_len + 1);
+    blake3_hash_update(&hasher, content, size);
+    blake3_hasher_finalize(&hasher, oid_out->bytes, AVC_OID_RAWSZ);
+}
+
+// Objects per SIMD batch; bounds the scratch buffer to 64 KiB
+#define HASH_BATCH_SIZE 64
+
+void blake3_hash_objects_batch(const char* type, const char* const* contents,
+                               const size_t* sizes, size_t count, avc_oid_t* oids_out) {
+    uint8_t (*messages)[BLAKE3_CHUNK_LEN] = malloc(HASH_BATCH_SIZE * BLAKE3_CHUNK_LEN);
+    if (!messages) {
+        for (size_t i = 0; i < count; i++) {
+            blake3_hash_object(type, contents[i], sizes[i], &oids_out[i]);
+        }
         return;
     }
 
-    // Copy header, null byte, then content
-    memcpy(full_content, header, header_len);
-    full_content[header_len] = '\0';
-    memcpy(full_content + header_len + 1, content, size);
+    const uint8_t* inputs[HASH_BATCH_SIZE];
+    size_t lens[HASH_BATCH_SIZE];
+    size_t owners[HASH_BATCH_SIZE];
+    uint8_t digests[HASH_BATCH_SIZE * AVC_OID_RAWSZ];
+
+    size_t i = 0;
+    while (i < count) {
+        // Build "type size\0content" messages until the batch is full
+        size_t n = 0;
+        for (; i < count && n < HASH_BATCH_SIZE; i++) {
+            char header[64];
+            int header_len = snprintf(header, sizeof(header), "%s %zu", type, sizes[i]);
+            size_t total = (size_t)header_len + 1 + sizes[i];
+            if (total > BLAKE3_CHUNK_LEN) {
+                // Multi-chunk objects gain nothing from lane sharing
+                blake3_hash_object(type, contents[i], sizes[i], &oids_out[i]);
+                continue;
+            }
+            memcpy(messages[n], header, (size_t)header_len + 1);
+            memcpy(messages[n] + header_len + 1, contents[i], sizes[i]);
+            inputs[n] = messages[n];
+            lens[n] = total;
+            owners[n] = i;
+            n++;
+        }
 
-    // Hash the full content
-    blake3_hash(full_content, total_size, hash_out);
+        blake3_hash_short_many(inputs, lens, n, digests);
+        for (size_t j = 0; j < n; j++) {
+            memcpy(oids_out[owners[j]].bytes, &digests[j * AVC_OID_RAWSZ], AVC_OID_RAWSZ);
+        }
+    }
 
-    free(full_content);
+    free(messages);
 }
 
 // Store object with proper format
@@ -1,6 +1,24 @@
 #ifndef HASH_H
 #define HASH_H
+#include <stddef.h>
+#include <blake3.h>
+#include "oid.h"
 #define HASH_SIZE 64
-void blake3_hash(const char* content, size_t size, char* hash_out);
-void blake3_hash_object(const char* type, const char* content, size_t size, char* hash_out);
+
+// Inputs at least this large are hashed across the thread pool
+#define HASH_PARALLEL_THRESHOLD (1024 * 1024)
+
+void blake3_hash(const char* content, size_t size, avc_oid_t* oid_out);
+void blake3_hash_object(const char* type, const char* content, size_t size, avc_oid_t* oid_out);
+
+// Hash `count` objects of one type into oids_out. Objects that fit in one
+// BLAKE3 chunk with their header are hashed together across SIMD lanes.
+void blake3_hash_objects_batch(const char* type, const char* const* contents,
+                               const size_t* sizes, size_t count, avc_oid_t* oids_out);
+
+// Feed data into a hasher, splitting large inputs into parallel subtrees
+void blake3_hash_update(blake3_hasher* hasher, const void* data, size_t size);
+
+// Same for whole chunks appended to a resumable state
+void blake3_hash_resume_update(blake3_resume_state* state, const void* data, size_t size);
 #endif //HASH_H
@@ -0,0 +1,271 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <blake3.h>
+#include "hash.h"
+#include "hash_checkpoint.h"
+#include "fast_index.h"
+#include "index.h"
+
+#define CHECKPOINT_DIR ".avc/checkpoints"
+#define CHECKPOINT_MAGIC 0x31504b43  // "CKP1"
+
+// Prefix guard: this many windows spread evenly over the old content,
+// always including its first and last bytes
+#define CHECKPOINT_SAMPLES 16
+#define CHECKPOINT_SAMPLE_LEN 256
+
+typedef struct {
+    uint32_t magic;
+    uint32_t header_len;         // "blob <size>" plus its NUL
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+    uint64_t dev;
+    uint64_t ino;
+    uint8_t path_id[BLAKE3_OUT_LEN];  // BLAKE3 of the normalized path
+    uint8_t guard[BLAKE3_OUT_LEN];
+    avc_oid_t oid;
+    blake3_resume_state state;   // Complete chunks after chunk 0
+} checkpoint_record_t;
+
+static int g_enabled = 1;
+static pthread_once_t g_enabled_once = PTHREAD_ONCE_INIT;
+
+static void detect_enabled(void) {
+    const char* env = getenv("AVC_HASH_CHECKPOINTS");
+    if (env && strcmp(env, "0") == 0) g_enabled = 0;
+}
+
+int hash_checkpoint_enabled(void) {
+    pthread_once(&g_enabled_once, detect_enabled);
+    return g_enabled;
+}
+
+// "./a/b" and "a/b" share a checkpoint
+static void checkpoint_location(const char* path, uint8_t path_id[BLAKE3_OUT_LEN],
+                                char* file_out, size_t file_size) {
+    while (path[0] == '.' && path[1] == '/') path += 2;
+
+    blake3_hasher hasher;
+    blake3_hasher_init(&hasher);
+    blake3_hasher_update(&hasher, path, strlen(path));
+    blake3_hasher_finalize(&hasher, path_id, BLAKE3_OUT_LEN);
+
+    char hex[33];
+    hex_encode(path_id, 16, hex);
+    snprintf(file_out, file_size, CHECKPOINT_DIR "/%s", hex);
+}
+
+static int load_record(const char* path, checkpoint_record_t* rec) {
+    uint8_t path_id[BLAKE3_OUT_LEN];
+    char file[512];
+    checkpoint_location(path, path_id, file, sizeof(file));
+
+    int fd = open(file, O_RDONLY);
+    if (fd == -1) return -1;
+    ssize_t n = read(fd, rec, sizeof(*rec));
+    close(fd);
+
+    if (n != (ssize_t)sizeof(*rec) || rec->magic != CHECKPOINT_MAGIC) return -1;
+    if (memcmp(rec->path_id, path_id, BLAKE3_OUT_LEN) != 0) return -1;
+    return 0;
+}
+
+static void remove_record(const char* path) {
+    uint8_t path_id[BLAKE3_OUT_LEN];
+    char file[512];
+    checkpoint_location(path, path_id, file, sizeof(file));
+    unlink(file);
+}
+
+// Write to a temporary file and rename so readers never see a partial record
+static void save_record(const char* path, checkpoint_record_t* rec) {
+    char file[512];
+    checkpoint_location(path, rec->path_id, file, sizeof(file));
+
+    if (mkdir(CHECKPOINT_DIR, 0755) == -1 && errno != EEXIST) return;
+
+    char tmp[540];
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", file);
+    int fd = mkstemp(tmp);
+    if (fd == -1) return;
+
+    ssize_t n = write(fd, rec, sizeof(*rec));
+    close(fd);
+    if (n != (ssize_t)sizeof(*rec) || rename(tmp, file) == -1) {
+        unlink(tmp);
+    }
+}
+
+static int stat_matches(const checkpoint_record_t* rec, const struct stat* st) {
+    return rec->size == (uint64_t)st->st_size &&
+           rec->mtime_sec == (int64_t)st->st_mtim.tv_sec &&
+           rec->mtime_nsec == (int64_t)st->st_mtim.tv_nsec &&
+           rec->ctime_sec == (int64_t)st->st_ctim.tv_sec &&
+           rec->ctime_nsec == (int64_t)st->st_ctim.tv_nsec &&
+           rec->dev == (uint64_t)st->st_dev &&
+           rec->ino == (uint64_t)st->st_ino;
+}
+
+// Hash sampled windows of content[0, size)
+static void prefix_guard(const char* content, size_t size, uint8_t guard[BLAKE3_OUT_LEN]) {
+    blake3_hasher hasher;
+    blake3_hasher_init(&hasher);
+    size_t span = size - CHECKPOINT_SAMPLE_LEN;
+    for (size_t i = 0; i < CHECKPOINT_SAMPLES; i++) {
+        size_t offset = span / (CHECKPOINT_SAMPLES - 1) * i;
+        if (i == CHECKPOINT_SAMPLES - 1) offset = span;
+        blake3_hasher_update(&hasher, content + offset, CHECKPOINT_SAMPLE_LEN);
+    }
+    blake3_hasher_finalize(&hasher, guard, BLAKE3_OUT_LEN);
+}
+
+int hash_checkpoint_lookup(const char* path, const struct stat* st, avc_oid_t* oid_out) {
+    if (!hash_checkpoint_enabled() || (size_t)st->st_size < HASH_PARALLEL_THRESHOLD) return -1;
+
+    checkpoint_record_t rec;
+    if (load_record(path, &rec) != 0 || !stat_matches(&rec, st)) return -1;
+    *oid_out = rec.oid;
+    return 0;
+}
+
+void hash_checkpoint_blob(const char* path, const struct stat* st,
+                          const char* content, avc_oid_t* oid_out) {
+    size_t size = (size_t)st->st_size;
+    if (!hash_checkpoint_enabled() || size < HASH_PARALLEL_THRESHOLD) {
+        blake3_hash_object("blob", content, size, oid_out);
+        return;
+    }
+
+    // The object stream is "blob <size>\0" followed by the content
+    uint8_t first_chunk[BLAKE3_CHUNK_LEN];
+    int header_len = snprintf((char*)first_chunk, sizeof(first_chunk), "blob %zu", size) + 1;
+    memcpy(first_chunk + header_len, content, BLAKE3_CHUNK_LEN - header_len);
+
+    // Chunks up to the last (possibly partial) one go into the state
+    size_t stream_len = (size_t)header_len + size;
+    uint64_t chunks = (stream_len - 1) / BLAKE3_CHUNK_LEN;
+
+    checkpoint_record_t rec;
+    int loaded = load_record(path, &rec) == 0, resumed = 0;
+    if (loaded &&
+        rec.dev == (uint64_t)st->st_dev && rec.ino == (uint64_t)st->st_ino &&
+        rec.size < size && rec.header_len == (uint32_t)header_len &&
+        rec.state.chunks == ((uint64_t)header_len + rec.size - 1) / BLAKE3_CHUNK_LEN) {
+        uint8_t guard[BLAKE3_OUT_LEN];
+        prefix_guard(content, rec.size, guard);
+        resumed = memcmp(guard, rec.guard, BLAKE3_OUT_LEN) == 0;
+    }
+
+    if (!resumed) {
+        // Replaced, shrunk or rewritten: the old record can never be resumed
+        // from, so it goes even if the new one cannot be saved
+        if (loaded) remove_record(path);
+        memset(&rec, 0, sizeof(rec));
+        blake3_resume_init(&rec.state);
+    }
+    size_t done = (size_t)rec.state.chunks * BLAKE3_CHUNK_LEN;
+    size_t tail = (size_t)chunks * BLAKE3_CHUNK_LEN;
+    blake3_hash_resume_update(&rec.state, content + (done - header_len), tail - done);
+
+    blake3_hasher hasher;
+    blake3_resume_hasher(&rec.state, first_chunk, &hasher);
+    blake3_hasher_update(&hasher, content + (tail - header_len), stream_len - tail);
+    blake3_hasher_finalize(&hasher, oid_out->bytes, AVC_OID_RAWSZ);
+
+    rec.magic = CHECKPOINT_MAGIC;
+    rec.header_len = (uint32_t)header_len;
+    rec.size = size;
+    rec.mtime_sec = (int64_t)st->st_mtim.tv_sec;
+    rec.mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+    rec.ctime_sec = (int64_t)st->st_ctim.tv_sec;
+    rec.ctime_nsec = (int64_t)st->st_ctim.tv_nsec;
+    rec.dev = (uint64_t)st->st_dev;
+    rec.ino = (uint64_t)st->st_ino;
+    prefix_guard(content, size, rec.guard);
+    rec.oid = *oid_out;
+    save_record(path, &rec);
+}
+
+typedef struct {
+    char (*names)[33];
+    unsigned char* keep;
+    size_t count;
+} prune_set_t;
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp((const char*)a, (const char*)b);
+}
+
+// Keep the records of tracked paths that are still large enough to have one
+static void mark_tracked(prune_set_t* set, const fast_index_t* idx) {
+    for (int i = 0; i < FAST_INDEX_SIZE; i++) {
+        for (const index_entry_t* entry = idx->buckets[i]; entry; entry = entry->next) {
+            uint8_t path_id[BLAKE3_OUT_LEN];
+            char file[512];
+            checkpoint_location(entry->path, path_id, file, sizeof(file));
+            const char* name = file + sizeof(CHECKPOINT_DIR);
+            char (*found)[33] = bsearch(name, set->names, set->count, sizeof(*set->names), compare_names);
+            if (!found || set->keep[found - set->names]) continue;
+
+            struct stat st;
+            if (stat(entry->path, &st) == 0 && S_ISREG(st.st_mode) &&
+                (size_t)st.st_size >= HASH_PARALLEL_THRESHOLD) {
+                set->keep[found - set->names] = 1;
+            }
+        }
+    }
+}
+
+void hash_checkpoint_prune(void) {
+    DIR* dir = opendir(CHECKPOINT_DIR);
+    if (!dir) return;
+
+    // Temporary files ("<name>.XXXXXX") may belong to a running add
+    prune_set_t set = {0};
+    size_t capacity = 0;
+    struct dirent* de;
+    while ((de = readdir(dir))) {
+        if (strlen(de->d_name) != 32) continue;
+        if (set.count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            char (*grown)[33] = realloc(set.names, capacity * sizeof(*set.names));
+            if (!grown) break;
+            set.names = grown;
+        }
+        memcpy(set.names[set.count++], de->d_name, 33);
+    }
+    if (set.count == 0) {
+        free(set.names);
+        closedir(dir);
+        return;
+    }
+    qsort(set.names, set.count, sizeof(*set.names), compare_names);
+
+    // Without both lists every record is kept
+    fast_index_t* staged = fast_index_create();
+    fast_index_t* committed = fast_index_create();
+    set.keep = calloc(set.count, 1);
+    if (set.keep && staged && committed && fast_index_load(staged) == 0 &&
+        fast_index_load_file(committed, INDEX_STAT_CACHE_PATH) == 0) {
+        mark_tracked(&set, staged);
+        mark_tracked(&set, committed);
+        for (size_t i = 0; i < set.count; i++) {
+            if (!set.keep[i]) unlinkat(dirfd(dir), set.names[i], 0);
+        }
+    }
+    fast_index_free(staged);
+    fast_index_free(committed);
+    free(set.keep);
+    free(set.names);
+    closedir(dir);
+}
@@ -0,0 +1,32 @@
+#ifndef HASH_CHECKPOINT_H
+#define HASH_CHECKPOINT_H
+
+#include <sys/stat.h>
+#include "oid.h"
+
+// Per-file BLAKE3 checkpoints for large blobs, kept in .avc/checkpoints.
+// A checkpoint records the file's stat data, its blob ID and the chaining
+// state of every complete subtree after the first chunk. When the stat data
+// still matches, the ID is reused without reading the file. When the file
+// only grew (same inode, sampled prefix unchanged, same header length), only
+// the first chunk and the appended bytes are hashed.
+//
+// Set AVC_HASH_CHECKPOINTS=0 to disable both reading and writing them.
+
+// Nonzero unless disabled through the environment
+int hash_checkpoint_enabled(void);
+
+// Fill oid_out and return 0 if the checkpoint matches st exactly, else -1
+int hash_checkpoint_lookup(const char* path, const struct stat* st, avc_oid_t* oid_out);
+
+// Compute the blob ID of `content` (st->st_size bytes read from path),
+// resuming from the checkpoint when possible, and save a new checkpoint.
+// Files below HASH_PARALLEL_THRESHOLD are hashed directly.
+void hash_checkpoint_blob(const char* path, const struct stat* st,
+                          const char* content, avc_oid_t* oid_out);
+
+// Delete the checkpoints of paths that are neither staged nor in the stat
+// cache, or whose file is gone or now below HASH_PARALLEL_THRESHOLD
+void hash_checkpoint_prune(void);
+
+#endif // HASH_CHECKPOINT_H
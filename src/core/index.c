@@ -11,10 +11,28 @@
 static fast_index_t *fast_idx = NULL;
 static int idx_loaded = 0;
 
-const char *index_get_hash(const char *filepath) {
+const avc_oid_t *index_get_oid(const char *filepath) {
   if (!idx_loaded || !fast_idx)
     return NULL;
-  return fast_index_get_hash(fast_idx, filepath);
+  return fast_index_get_oid(fast_idx, filepath);
+}
+
+size_t index_foreach(index_visit_fn visit, void *ctx) {
+  if (!idx_loaded || !fast_idx || !visit)
+    return 0;
+
+  size_t visited = 0;
+  for (int i = 0; i < FAST_INDEX_SIZE; i++) {
+    for (index_entry_t *entry = fast_idx->buckets[i]; entry; entry = entry->next) {
+      visit(entry->path, &entry->oid, entry->mode, ctx);
+      visited++;
+    }
+  }
+  return visited;
+}
+
+size_t index_count(void) {
+  return (idx_loaded && fast_idx) ? fast_idx->count : 0;
 }
 
 int index_load(void) {
@@ -35,7 +53,7 @@ int index_load(void) {
   return result;
 }
 
-int index_upsert_entry(const char *filepath, const char *hash, unsigned int mode,
+int index_upsert_entry(const char *filepath, const avc_oid_t *oid, unsigned int mode,
                        int *unchanged_out) {
   if (!idx_loaded || !fast_idx) {
     // Fallback or error, depending on desired behavior for unloaded index
@@ -45,20 +63,53 @@ int index_upsert_entry(const char *filepath, const char *hash, unsigned int mode
   if (unchanged_out)
     *unchanged_out = 0;
 
-  const char *old_hash = fast_index_get_hash(fast_idx, filepath);
-  if (hash && old_hash && strcmp(old_hash, hash) == 0) {
+  const avc_oid_t *old_oid = fast_index_get_oid(fast_idx, filepath);
+  if (oid && old_oid && oid_equal(old_oid, oid)) {
     if (unchanged_out)
       *unchanged_out = 1;
     return 0;
   }
 
-  if (hash) {
-    return fast_index_set(fast_idx, filepath, hash, mode);
+  if (oid) {
+    return fast_index_set(fast_idx, filepath, oid, mode);
   } else {
     return fast_index_remove(fast_idx, filepath);
   }
 }
 
+int index_set_stat(const char *filepath, const avc_oid_t *oid, const struct stat *st) {
+  if (!idx_loaded || !fast_idx)
+    return -1;
+  const avc_oid_t *current = fast_index_get_oid(fast_idx, filepath);
+  if (!current || !oid_equal(current, oid))
+    return -1;
+  return fast_index_set_stat(fast_idx, filepath, st);
+}
+
+int index_save_stat_cache(void) {
+  fast_index_t *staged = fast_index_create();
+  fast_index_t *cache = fast_index_create();
+  int result = -1;
+  if (staged && cache && fast_index_load(staged) == 0 &&
+      fast_index_load_file(cache, INDEX_STAT_CACHE_PATH) == 0) {
+    result = 0;
+    for (int i = 0; i < FAST_INDEX_SIZE && result == 0; i++) {
+      for (index_entry_t *entry = staged->buckets[i]; entry; entry = entry->next) {
+        if (fast_index_set(cache, entry->path, &entry->oid, entry->mode) != 0) {
+          result = -1;
+          break;
+        }
+        ((index_entry_t *)fast_index_get(cache, entry->path))->stat = entry->stat;
+      }
+    }
+    if (result == 0 && staged->count > 0)
+      result = fast_index_commit_file(cache, INDEX_STAT_CACHE_PATH);
+  }
+  fast_index_free(staged);
+  fast_index_free(cache);
+  return result;
+}
+
 int index_commit(void) {
   if (!idx_loaded || !fast_idx)
     return 0;
@@ -73,7 +124,7 @@ int index_commit(void) {
 }
 
 int is_file_in_index(const char *filepath) {
-  return index_get_hash(filepath) != NULL;
+  return index_get_oid(filepath) != NULL;
 }
 
 int clear_index(void) {
@@ -7,6 +7,12 @@
 #define INDEX_H
 
 #include <stddef.h>
+#include <sys/stat.h>
+#include "oid.h"
+
+// Stat data of committed files, kept in the index format after the index
+// itself is cleared by a commit
+#define INDEX_STAT_CACHE_PATH ".avc/stat-cache"
 
 // Index management functions
 int add_file_to_index(const char* filepath);
@@ -17,9 +23,23 @@ int clear_index(void);
 // Transactional index updates (load once, write once)
 int index_load(void);
 
-int index_upsert_entry(const char* filepath, const char* hash, unsigned int mode, int* unchanged_out);
+int index_upsert_entry(const char* filepath, const avc_oid_t* oid, unsigned int mode, int* unchanged_out);
 int index_commit(void);
-// Returns pointer to hash string for given path if present (internal buffer), else NULL
-const char* index_get_hash(const char* filepath);
+
+// Record the stat data the file had when it was hashed to oid, if the entry
+// still has that object
+int index_set_stat(const char* filepath, const avc_oid_t* oid, const struct stat* st);
+
+// Carry the staged entries' stat data over to INDEX_STAT_CACHE_PATH
+int index_save_stat_cache(void);
+// Returns pointer to the object ID for given path if present (internal buffer), else NULL
+const avc_oid_t* index_get_oid(const char* filepath);
+
+// Visit every entry of the loaded index
+typedef void (*index_visit_fn)(const char* path, const avc_oid_t* oid, unsigned int mode, void* ctx);
+size_t index_foreach(index_visit_fn visit, void* ctx);
+
+// Number of entries in the loaded index
+size_t index_count(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,176 @@
+#define _XOPEN_SOURCE 700
+#include "object_set.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <time.h>
+
+// An in-flight store is compressing and writing; waiters yield this many
+// times, then sleep between checks
+#define WAIT_SPINS 64
+#define WAIT_SLEEP_NS 50000
+
+// Slot lifecycle: EMPTY -> BUSY (key being written) -> INFLIGHT/STORED.
+// A failed store moves INFLIGHT -> ABSENT, which can be claimed again.
+enum {
+    SLOT_EMPTY    = 0,
+    SLOT_BUSY     = 1,
+    SLOT_INFLIGHT = 2,
+    SLOT_STORED   = 3,
+    SLOT_ABSENT   = 4
+};
+
+struct object_set_slot {
+    _Atomic uint32_t state;
+    avc_oid_t key;
+};
+
+static size_t key_bucket(const object_set_t* set, const avc_oid_t* key) {
+    return (size_t)oid_hash(key) & set->mask;
+}
+
+object_set_t* object_set_create(size_t expected) {
+    object_set_t* set = calloc(1, sizeof(object_set_t));
+    if (!set) return NULL;
+
+    // Keep load factor under 50% so probe sequences stay short
+    size_t capacity = 1024;
+    while (capacity < expected * 2) capacity <<= 1;
+
+    set->slots = calloc(capacity, sizeof(object_set_slot_t));
+    if (!set->slots) {
+        free(set);
+        return NULL;
+    }
+    set->capacity = capacity;
+    set->mask = capacity - 1;
+    return set;
+}
+
+void object_set_free(object_set_t* set) {
+    if (!set) return;
+    free(set->slots);
+    free(set);
+}
+
+// Wait for a concurrent inserter to finish publishing its key
+static uint32_t wait_published(object_set_slot_t* slot, uint32_t state) {
+    while (state == SLOT_BUSY) {
+        sched_yield();
+        state = atomic_load_explicit(&slot->state, memory_order_acquire);
+    }
+    return state;
+}
+
+// Find the slot holding key, inserting it with `insert_state` if missing.
+// Returns NULL when the table is full; *inserted tells whether we created it.
+static object_set_slot_t* find_or_insert(object_set_t* set, const avc_oid_t* key,
+                                         uint32_t insert_state, int* inserted) {
+    *inserted = 0;
+    size_t i = key_bucket(set, key);
+
+    for (size_t probe = 0; probe < set->capacity; probe++, i = (i + 1) & set->mask) {
+        object_set_slot_t* slot = &set->slots[i];
+        uint32_t state = atomic_load_explicit(&slot->state, memory_order_acquire);
+
+        if (state == SLOT_EMPTY) {
+            uint32_t expected = SLOT_EMPTY;
+            if (atomic_compare_exchange_strong_explicit(&slot->state, &expected, SLOT_BUSY,
+                                                        memory_order_acq_rel,
+                                                        memory_order_acquire)) {
+                slot->key = *key;
+                atomic_store_explicit(&slot->state, insert_state, memory_order_release);
+                *inserted = 1;
+                return slot;
+            }
+            state = expected;
+        }
+
+        wait_published(slot, state);
+        if (oid_equal(&slot->key, key)) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+// Lookup only, never inserts
+static object_set_slot_t* find_slot(object_set_t* set, const avc_oid_t* key) {
+    size_t i = key_bucket(set, key);
+
+    for (size_t probe = 0; probe < set->capacity; probe++, i = (i + 1) & set->mask) {
+        object_set_slot_t* slot = &set->slots[i];
+        uint32_t state = atomic_load_explicit(&slot->state, memory_order_acquire);
+        if (state == SLOT_EMPTY) return NULL;
+
+        wait_published(slot, state);
+        if (oid_equal(&slot->key, key)) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+object_set_result_t object_set_claim(object_set_t* set, const avc_oid_t* key) {
+    if (!set || !key) return OBJECT_SET_FULL;
+
+    int inserted;
+    object_set_slot_t* slot = find_or_insert(set, key, SLOT_INFLIGHT, &inserted);
+    if (!slot) return OBJECT_SET_FULL;
+    if (inserted) return OBJECT_SET_CLAIMED;
+
+    // Known hash; only a previously failed store can be claimed again
+    uint32_t expected = SLOT_ABSENT;
+    if (atomic_compare_exchange_strong_explicit(&slot->state, &expected, SLOT_INFLIGHT,
+                                                memory_order_acq_rel,
+                                                memory_order_acquire)) {
+        return OBJECT_SET_CLAIMED;
+    }
+    return expected == SLOT_STORED ? OBJECT_SET_EXISTS : OBJECT_SET_INFLIGHT;
+}
+
+object_set_result_t object_set_wait(object_set_t* set, const avc_oid_t* key) {
+    if (!set || !key) return OBJECT_SET_FULL;
+    object_set_slot_t* slot = find_slot(set, key);
+    if (!slot) return OBJECT_SET_FULL;
+
+    for (unsigned int spins = 0;; spins++) {
+        uint32_t expected = SLOT_ABSENT;
+        if (atomic_compare_exchange_strong_explicit(&slot->state, &expected, SLOT_INFLIGHT,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire)) {
+            return OBJECT_SET_CLAIMED;
+        }
+        if (expected == SLOT_STORED) return OBJECT_SET_EXISTS;
+        if (spins < WAIT_SPINS) {
+            sched_yield();
+        } else {
+            struct timespec pause = {0, WAIT_SLEEP_NS};
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+void object_set_mark_stored(object_set_t* set, const avc_oid_t* key) {
+    if (!set || !key) return;
+    object_set_slot_t* slot = find_slot(set, key);
+    if (slot) atomic_store_explicit(&slot->state, SLOT_STORED, memory_order_release);
+}
+
+void object_set_release(object_set_t* set, const avc_oid_t* key) {
+    if (!set || !key) return;
+    object_set_slot_t* slot = find_slot(set, key);
+    if (slot) atomic_store_explicit(&slot->state, SLOT_ABSENT, memory_order_release);
+}
+
+void object_set_seed(object_set_t* set, const avc_oid_t* key) {
+    if (!set || !key) return;
+    int inserted;
+    object_set_slot_t* slot = find_or_insert(set, key, SLOT_STORED, &inserted);
+    if (slot && !inserted) {
+        atomic_store_explicit(&slot->state, SLOT_STORED, memory_order_release);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef OBJECT_SET_H
+#define OBJECT_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "oid.h"
+
+// Lock-free concurrent set of object hashes shared by parallel workers.
+// Each key is an object's avc_oid_t. A worker that claims a hash owns
+// storing it; every other worker skips compression and the filesystem
+// entirely, waiting first if the store is still in flight so that it never
+// reports an object that is not on disk yet.
+
+typedef enum {
+    OBJECT_SET_CLAIMED = 0,  // Caller is the first to see this hash and must store it
+    OBJECT_SET_EXISTS   = 1,  // Already stored
+    OBJECT_SET_FULL     = 2,  // Table is full, caller falls back to the object store
+    OBJECT_SET_INFLIGHT = 3   // Being stored by another worker; see object_set_wait
+} object_set_result_t;
+
+typedef struct object_set_slot object_set_slot_t;
+
+typedef struct {
+    object_set_slot_t* slots;
+    size_t mask;
+    size_t capacity;
+} object_set_t;
+
+// Create a set sized for roughly `expected` distinct hashes
+object_set_t* object_set_create(size_t expected);
+
+// Free the set
+void object_set_free(object_set_t* set);
+
+// Try to claim a hash for storing (thread-safe, lock-free)
+object_set_result_t object_set_claim(object_set_t* set, const avc_oid_t* key);
+
+// Wait for the store of an in-flight hash to finish: OBJECT_SET_EXISTS if
+// it was stored, OBJECT_SET_CLAIMED if it failed and the caller now owns
+// storing it
+object_set_result_t object_set_wait(object_set_t* set, const avc_oid_t* key);
+
+// Mark a claimed hash as written to the object store
+void object_set_mark_stored(object_set_t* set, const avc_oid_t* key);
+
+// Give a claimed hash back after a failed store so another worker can retry
+void object_set_release(object_set_t* set, const avc_oid_t* key);
+
+// Insert a hash that is already known to exist in the object store
+void object_set_seed(object_set_t* set, const avc_oid_t* key);
+
+#endif // OBJECT_SET_H
@@ -1,4 +1,5 @@
 #define _XOPEN_SOURCE 700
+#define _GNU_SOURCE   /* for fallocate */
 //
 // Created by Atheria on 6/20/25.
 //
@@ -8,17 +9,29 @@
 #include <fcntl.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <errno.h>
+#include <stdatomic.h>
 #include <omp.h>
 #include "hash.h"
 #include "objects.h"
 #include "compression.h"
+#include "object_set.h"
+#include "hash_checkpoint.h"
 #include <blake3.h>
 #include <zstd.h>
 
 // Compression constants
 static int g_fast_mode = 0; // 0 = normal, 1 = fast
 void objects_set_fast_mode(int fast) { g_fast_mode = fast; }
+
+// Hashes known to be stored (or being stored) by the current operation
+static object_set_t* g_known_objects = NULL;
+void objects_set_known_objects(object_set_t* set) { g_known_objects = set; }
+
+// Extra per-blob work done while the content is in memory (e.g. Git IDs)
+static objects_blob_hook_t g_blob_hook = NULL;
+void objects_set_blob_hook(objects_blob_hook_t hook) { g_blob_hook = hook; }
 #define AVC_COMPRESSION_LEVEL_MAX 6  // Default maximum compression level
 
 #define AVC_COMPRESSION_LEVEL_BALANCED 3
@@ -84,7 +97,7 @@ void show_compression_stats(size_t original_size, size_t compressed_size, const
 // REMOVED: flush_to_file_libdeflate - no longer needed
 
 // Stream a file into a compressed blob object while computing its SHA-256.
-int store_blob_from_file(const char* filepath, char* hash_out) {
+int store_blob_from_file(const char* filepath, avc_oid_t* oid_out) {
     struct stat st;
     if (stat(filepath, &st) == -1) {
         perror("stat");
@@ -113,22 +126,30 @@ int store_blob_from_file(const char* filepath, char* hash_out) {
         return -1;
     }
 
-    // Delegate to store_object, which handles hashing, compression, and storage
-    int result = store_object("blob", file_content, size, hash_out);
+    // Large files reuse or extend their hash checkpoint
+    int result;
+    if (size >= HASH_PARALLEL_THRESHOLD) {
+        if (hash_checkpoint_lookup(filepath, &st, oid_out) != 0) {
+            hash_checkpoint_blob(filepath, &st, file_content, oid_out);
+        }
+        result = store_object_hashed("blob", file_content, size, oid_out);
+    } else {
+        result = store_object("blob", file_content, size, oid_out);
+    }
 
     free(file_content);
 
     return result;
 }
 
-int store_object(const char* type, const char* content, size_t size, char* hash_out) {
-    // Generate hash first (before compression, like Git)
-    blake3_hash_object(type, content, size, hash_out);
-
+// Compress and write an already-hashed object unless it is on disk
+static int write_object(const char* type, const char* content, size_t size, const avc_oid_t* oid) {
     // Create object path: .avc/objects/ab/cdef123... (Git-style subdirectories)
+    char hex[AVC_OID_HEXSZ + 1];
+    oid_to_hex(oid, hex);
     char obj_dir[512], obj_path[512];
-    snprintf(obj_dir, sizeof(obj_dir), ".avc/objects/%.2s", hash_out);
-    snprintf(obj_path, sizeof(obj_path), "%s/%s", obj_dir, hash_out + 2);
+    snprintf(obj_dir, sizeof(obj_dir), ".avc/objects/%.2s", hex);
+    snprintf(obj_path, sizeof(obj_path), "%s/%s", obj_dir, hex + 2);
 
     // Create subdirectory if it doesn't exist
     struct stat st;
@@ -160,7 +181,7 @@ int store_object(const char* type, const char* content, size_t size, char* hash_
     memcpy(full_content + header_len + 1, content, size);
 
     // Compress the full content with aggressive compression
-    size_t compressed_size;
+    size_t compressed_size = 0;
     char* compressed = compress_data_fast(full_content, full_size, &compressed_size);
     free(full_content);
     
@@ -183,12 +204,69 @@ int store_object(const char* type, const char* content, size_t size, char* hash_
     return 0;
 }
 
-// Compute SHA-256 of a file quickly, output hex.
-int blake3_file_hex(const char* filepath, char hash_out[65]) {
+int store_object_hashed(const char* type, const char* content, size_t size, const avc_oid_t* oid) {
+    // Skip duplicates already stored; one in flight on another worker is
+    // waited for, and stored here if that worker fails
+    int claimed = 0;
+    if (g_known_objects) {
+        object_set_result_t claim = object_set_claim(g_known_objects, oid);
+        if (claim == OBJECT_SET_INFLIGHT) {
+            claim = object_set_wait(g_known_objects, oid);
+        }
+        if (claim == OBJECT_SET_EXISTS) {
+            return 0;
+        }
+        claimed = (claim == OBJECT_SET_CLAIMED);
+    }
+
+    int result = write_object(type, content, size, oid);
+    if (result == 0 && g_blob_hook && strcmp(type, "blob") == 0) {
+        g_blob_hook(oid, content, size);
+    }
+
+    if (claimed) {
+        if (result == 0) {
+            object_set_mark_stored(g_known_objects, oid);
+        } else {
+            object_set_release(g_known_objects, oid);
+        }
+    }
+    return result;
+}
+
+int store_object(const char* type, const char* content, size_t size, avc_oid_t* oid_out) {
+    // Generate hash first (before compression, like Git)
+    blake3_hash_object(type, content, size, oid_out);
+    return store_object_hashed(type, content, size, oid_out);
+}
+
+// Compute the blob ID of a file without loading it into memory
+int blake3_file_oid(const char* filepath, avc_oid_t* oid_out) {
     struct stat st;
     if (stat(filepath, &st) == -1) return -1;
     size_t size = st.st_size;
 
+    // Unchanged large files are answered from their checkpoint
+    if (size >= HASH_PARALLEL_THRESHOLD && hash_checkpoint_lookup(filepath, &st, oid_out) == 0) {
+        return 0;
+    }
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd == -1) return -1;
+
+    // Large files are mapped and hashed across the thread pool, resuming
+    // from the checkpoint when they only grew
+    if (size >= HASH_PARALLEL_THRESHOLD) {
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            close(fd);
+            posix_madvise(mapped, size, POSIX_MADV_SEQUENTIAL);
+            hash_checkpoint_blob(filepath, &st, mapped, oid_out);
+            munmap(mapped, size);
+            return 0;
+        }
+    }
+
     // Prepare header "blob <size>\0" (same as store_blob_from_file)
     char header[64];
     int header_len = snprintf(header, sizeof(header), "blob %zu", size);
@@ -197,26 +275,29 @@ int blake3_file_hex(const char* filepath, char hash_out[65]) {
     blake3_hasher_init(&ctx);
     blake3_hasher_update(&ctx, header, header_len + 1);
 
-    FILE* fp = fopen(filepath, "rb");
-    if (!fp) return -1;
-    unsigned char buf[8192];
-    size_t n;
-    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
-        blake3_hasher_update(&ctx, buf, n);
+    unsigned char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        blake3_hasher_update(&ctx, buf, (size_t)n);
     }
-    fclose(fp);
-    uint8_t digest2[32];
-    blake3_hasher_finalize(&ctx, digest2, 32);
-    for (int i = 0; i < 32; ++i) sprintf(hash_out + i*2, "%02x", digest2[i]);
-    hash_out[64] = '\0';
+    close(fd);
+
+    blake3_hasher_finalize(&ctx, oid_out->bytes, AVC_OID_RAWSZ);
     return 0;
 }
 
 
 
-char* load_object(const char* hash, size_t* size_out, char* type_out) {
+// Loose object path for an ID: .avc/objects/ab/cdef...
+static void object_path(const avc_oid_t* oid, char* path_out, size_t path_size) {
+    char hex[AVC_OID_HEXSZ + 1];
+    oid_to_hex(oid, hex);
+    snprintf(path_out, path_size, ".avc/objects/%.2s/%s", hex, hex + 2);
+}
+
+char* load_object(const avc_oid_t* oid, size_t* size_out, char* type_out) {
     char obj_path[512];
-    snprintf(obj_path, sizeof(obj_path), ".avc/objects/%.2s/%s", hash, hash + 2);
+    object_path(oid, obj_path, sizeof(obj_path));
 
     FILE* obj_file = fopen(obj_path, "rb");
     if (!obj_file) return NULL;
@@ -238,8 +319,9 @@ char* load_object(const char* hash, size_t* size_out, char* type_out) {
     }
     fclose(obj_file);
 
-    // AUTO-DETECT and decompress with unified layer
-    size_t estimated_size = compressed_size * 20;
+    // Frames record their content size; fall back to guessing for old objects
+    size_t estimated_size = avc_decompressed_size(compressed_data, compressed_size);
+    if (estimated_size == 0) estimated_size = compressed_size * 20;
     char* decompressed = decompress_data_unified(compressed_data, compressed_size, estimated_size);
     
     // Retry with larger buffer if needed
@@ -279,6 +361,185 @@ char* load_object(const char* hash, size_t* size_out, char* type_out) {
     return content;
 }
 
+// Streaming state per thread, kept for the thread's lifetime like the zstd
+// contexts in compression.c, so a stream costs no allocation
+static __thread ZSTD_DCtx* t_stream_dctx = NULL;
+static __thread char* t_stream_in = NULL;
+static __thread char* t_stream_out = NULL;
+
+int stream_object(const avc_oid_t* oid, char* type_out, size_t* size_out, object_stream_fn fn, void* ctx) {
+    char obj_path[512];
+    object_path(oid, obj_path, sizeof(obj_path));
+    int fd = open(obj_path, O_RDONLY);
+    if (fd == -1) return -1;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // The compressed file is read a buffer at a time too, so memory stays
+    // bounded by zstd's window whatever the object's size
+    if (!t_stream_dctx) t_stream_dctx = ZSTD_createDCtx();
+    if (!t_stream_in) t_stream_in = malloc(ZSTD_DStreamInSize());
+    if (!t_stream_out) t_stream_out = malloc(ZSTD_DStreamOutSize());
+    ZSTD_DCtx* dctx = t_stream_dctx;
+    char* out = t_stream_out;
+    size_t out_cap = ZSTD_DStreamOutSize();
+    if (dctx) ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+    ZSTD_inBuffer in = {t_stream_in, 0, 0};
+    size_t ret = 1;            // Nonzero while inside a frame
+    int at_end = 0, out_full = 0;
+    char header[64];
+    size_t header_len = 0, delivered = 0;
+    int have_header = 0;
+    int result = dctx && t_stream_in && out ? 0 : -1;
+
+    // Frames follow each other in one stream (large objects are split)
+    while (result == 0) {
+        if (in.pos == in.size && !at_end) {
+            ssize_t n = read(fd, t_stream_in, ZSTD_DStreamInSize());
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                result = -1;
+                break;
+            }
+            in.size = (size_t)n;
+            in.pos = 0;
+            at_end = n == 0;
+        }
+        if (at_end && in.pos == in.size) {
+            if (ret == 0) break;       // The last frame is complete
+            if (!out_full) {           // Truncated
+                result = -1;
+                break;
+            }
+        }
+        ZSTD_outBuffer output = {out, out_cap, 0};
+        ret = ZSTD_decompressStream(dctx, &output, &in);
+        if (ZSTD_isError(ret)) {
+            result = -1;
+            break;
+        }
+        out_full = output.pos == out_cap;
+        const char* p = out;
+        size_t n = output.pos;
+        while (!have_header && n > 0 && header_len < sizeof(header)) {
+            header[header_len++] = *p;
+            have_header = *p == '\0';
+            p++;
+            n--;
+        }
+        if (!have_header && header_len == sizeof(header)) result = -1;
+        if (have_header && header_len > 0) {
+            if (sscanf(header, "%15s %zu", type_out, size_out) != 2) result = -1;
+            header_len = 0;
+            if (!fn) break;
+        }
+        if (result == 0 && have_header && n > 0) {
+            if (n > *size_out - delivered) n = *size_out - delivered;
+            if (fn(ctx, p, n) != 0) result = -1;
+            delivered += n;
+        }
+    }
+    if (result == 0 && (!have_header || (fn && delivered != *size_out))) result = -1;
+
+    close(fd);
+    return result;
+}
+
+typedef struct {
+    int fd;
+    off_t offset;
+    const char* type;
+    const size_t* size;
+    blake3_hasher hasher;
+} checkout_stream_t;
+
+static int write_checkout_piece(void* ctx, const void* data, size_t len) {
+    checkout_stream_t* out = ctx;
+    if (out->offset == 0) {
+        // The header is parsed by now: hash it, and reserve the blocks
+        char header[64];
+        int header_len = snprintf(header, sizeof(header), "%s %zu", out->type, *out->size);
+        blake3_hasher_update(&out->hasher, header, header_len + 1);
+        if (*out->size >= CHECKOUT_PREALLOCATE_MIN) fallocate(out->fd, 0, 0, (off_t)*out->size);
+    }
+    blake3_hasher_update(&out->hasher, data, len);
+    const char* p = data;
+    while (len > 0) {
+        ssize_t n = pwrite(out->fd, p, len, out->offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+        out->offset += n;
+    }
+    return 0;
+}
+
+// "<dir of path>/.avc-checkout-<pid>-<n>": beside the target, so it can be
+// renamed over it, and short whatever the file's name
+static int checkout_temp_name(const char* path, char* out, size_t out_size) {
+    static _Atomic unsigned int counter;
+    const char* slash = strrchr(path, '/');
+    int dir_len = slash ? (int)(slash - path + 1) : 0;
+    int n = snprintf(out, out_size, "%.*s.avc-checkout-%d-%u", dir_len, path, (int)getpid(),
+                     atomic_fetch_add(&counter, 1));
+    return n < 0 || (size_t)n >= out_size ? -1 : 0;
+}
+
+unsigned int checkout_file_mode(unsigned int mode) {
+    return mode & 0111 ? 0755 : 0644;
+}
+
+int checkout_blob(const avc_oid_t* oid, unsigned int mode, int dir_fd, const char* path) {
+    char tmp[1024];
+    if (checkout_temp_name(path, tmp, sizeof(tmp)) != 0) return -1;
+    int fd = openat(dir_fd, tmp, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd == -1) return -1;
+    char type[16];
+    size_t size = 0;
+    checkout_stream_t out = { .fd = fd, .type = type, .size = &size };
+    blake3_hasher_init(&out.hasher);
+    int result = stream_object(oid, type, &size, write_checkout_piece, &out);
+    if (result == 0 && size == 0) {
+        // No piece was delivered to hash the header
+        result = write_checkout_piece(&out, "", 0);
+    }
+    // Set explicitly: the temporary file replaces the target, umask or not
+    if (fchmod(fd, checkout_file_mode(mode)) != 0) result = -1;
+    if (close(fd) != 0) result = -1;
+
+    avc_oid_t written;
+    blake3_hasher_finalize(&out.hasher, written.bytes, AVC_OID_RAWSZ);
+    if (result == 0 && (strcmp(type, "blob") != 0 || !oid_equal(&written, oid))) {
+        char hex[AVC_OID_HEXSZ + 1];
+        oid_to_hex(oid, hex);
+        fprintf(stderr, "Error: Object %s is corrupt; not checked out to %s\n", hex, path);
+        result = -1;
+    }
+    if (result == 0 && renameat(dir_fd, tmp, dir_fd, path) != 0) result = -1;
+    if (result != 0) unlinkat(dir_fd, tmp, 0);
+    return result;
+}
+
+int object_stored_size(const avc_oid_t* oid, size_t* size_out) {
+    char obj_path[512];
+    object_path(oid, obj_path, sizeof(obj_path));
+
+    struct stat st;
+    if (stat(obj_path, &st) == -1) return -1;
+    *size_out = (size_t)st.st_size;
+    return 0;
+}
+
+void object_prefetch(const avc_oid_t* oid) {
+    char obj_path[512];
+    object_path(oid, obj_path, sizeof(obj_path));
+
+    int fd = open(obj_path, O_RDONLY);
+    if (fd == -1) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
 // Free memory pool (call periodically)
 void free_memory_pool(void) {
     // Nothing to clean up - contexts are managed in compression.c
@@ -6,15 +6,50 @@
 #define OBJECTS_H
 
 #include <stddef.h>
+#include "object_set.h"
+#include "oid.h"
 
 // Store a blob object from a file
-int store_blob_from_file(const char* filepath, char* hash_out);
+int store_blob_from_file(const char* filepath, avc_oid_t* oid_out);
 
 // Store an object with given type and content
-int store_object(const char* type, const char* content, size_t size, char* hash_out);
+int store_object(const char* type, const char* content, size_t size, avc_oid_t* oid_out);
 
-// Load an object by hash
-char* load_object(const char* hash, size_t* size_out, char* type_out);
+// Store an object whose hash the caller already computed (e.g. in a batch)
+int store_object_hashed(const char* type, const char* content, size_t size, const avc_oid_t* oid);
+
+// Load an object by ID
+char* load_object(const avc_oid_t* oid, size_t* size_out, char* type_out);
+
+// Called with consecutive pieces of an object's content; nonzero stops
+typedef int (*object_stream_fn)(void* ctx, const void* data, size_t len);
+
+// Decompress an object a piece at a time instead of into one buffer. The
+// header is parsed first into type_out (at least 16 bytes) and size_out;
+// with a NULL fn nothing else is decompressed. -1 if the object is missing
+// or corrupt, or fn stopped.
+int stream_object(const avc_oid_t* oid, char* type_out, size_t* size_out, object_stream_fn fn, void* ctx);
+
+// Blobs at least this large get their blocks reserved before being written
+#define CHECKOUT_PREALLOCATE_MIN (1024 * 1024)
+
+// Write a blob to path (relative to dir_fd, or AT_FDCWD) as it is
+// decompressed, with memory bounded by the zstd window, checking its BLAKE3
+// on the way. The blob is written to a temporary file beside path and
+// renamed over it, so on error (including a corrupt object) an existing
+// file is left as it was. The file gets checkout_file_mode(mode), mode
+// being the blob's tree entry mode.
+int checkout_blob(const avc_oid_t* oid, unsigned int mode, int dir_fd, const char* path);
+
+// Permissions of a checked out file: 0755 if the tree entry mode has any
+// execute bit, else 0644
+unsigned int checkout_file_mode(unsigned int mode);
+
+// Size of an object's compressed file on disk (-1 if missing)
+int object_stored_size(const avc_oid_t* oid, size_t* size_out);
+
+// Start reading an object's file into the page cache without waiting
+void object_prefetch(const avc_oid_t* oid);
 
 // Free memory pool (call periodically)
 void free_memory_pool(void);
@@ -25,8 +60,17 @@ void reset_memory_pool(void);
 // Enable/disable fast compression mode (level 0)
 void objects_set_fast_mode(int fast);
 
-// Calculate hash of a file using BLAKE3
-int blake3_file_hex(const char* filepath, char hash_out[65]);
+// Share a set of known object IDs so duplicate objects skip compression and I/O (NULL disables)
+void objects_set_known_objects(object_set_t* set);
+
+// Called with every blob this process stores, while its content is still in memory
+typedef void (*objects_blob_hook_t)(const avc_oid_t* oid, const char* content, size_t size);
+
+// Install a hook for stored blobs (NULL disables); must be thread-safe
+void objects_set_blob_hook(objects_blob_hook_t hook);
+
+// Calculate the blob ID of a file using BLAKE3
+int blake3_file_oid(const char* filepath, avc_oid_t* oid_out);
 
 // Diagnostic function to check object format
 int check_object_format(const char* hash);
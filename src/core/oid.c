@@ -0,0 +1,63 @@
+#include "oid.h"
+
+// Byte -> two hex digits, packed so one load writes both characters
+static const char g_hex_pairs[513] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+// Hex digit -> value, 0xff for anything that is not a hex digit
+#define HEX_INVALID 0xff
+#define HEX_ROW_INVALID \
+    HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, \
+    HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID
+
+static const uint8_t g_hex_values[256] = {
+    HEX_ROW_INVALID, HEX_ROW_INVALID, HEX_ROW_INVALID,
+    // '0'..'9', then ':'..'?'
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9,
+    HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID,
+    // '@', 'A'..'F', then 'G'..'O'
+    HEX_INVALID, 10, 11, 12, 13, 14, 15,
+    HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID,
+    HEX_ROW_INVALID,
+    // '`', 'a'..'f', then 'g'..'o'
+    HEX_INVALID, 10, 11, 12, 13, 14, 15,
+    HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID, HEX_INVALID,
+    HEX_ROW_INVALID,
+    HEX_ROW_INVALID, HEX_ROW_INVALID, HEX_ROW_INVALID, HEX_ROW_INVALID,
+    HEX_ROW_INVALID, HEX_ROW_INVALID, HEX_ROW_INVALID, HEX_ROW_INVALID
+};
+
+int hex_decode(const char* hex, uint8_t* out, size_t len) {
+    if (!hex) return -1;
+    for (size_t i = 0; i < len; i++) {
+        // A NUL terminator maps to HEX_INVALID, so short strings stop here
+        uint8_t hi = g_hex_values[(unsigned char)hex[i * 2]];
+        if (hi == HEX_INVALID) return -1;
+        uint8_t lo = g_hex_values[(unsigned char)hex[i * 2 + 1]];
+        if (lo == HEX_INVALID) return -1;
+        out[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return 0;
+}
+
+void hex_encode(const uint8_t* bytes, size_t len, char* hex_out) {
+    for (size_t i = 0; i < len; i++) {
+        memcpy(hex_out + i * 2, &g_hex_pairs[bytes[i] * 2], 2);
+    }
+    hex_out[len * 2] = '\0';
+}
+
+int oid_from_hex(const char* hex, avc_oid_t* oid_out) {
+    return hex_decode(hex, oid_out->bytes, AVC_OID_RAWSZ);
+}
+
+void oid_to_hex(const avc_oid_t* oid, char hex_out[AVC_OID_HEXSZ + 1]) {
+    hex_encode(oid->bytes, AVC_OID_RAWSZ, hex_out);
+}
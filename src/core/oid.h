@@ -0,0 +1,66 @@
+#ifndef OID_H
+#define OID_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Object IDs are kept as the raw 32-byte BLAKE3 digest everywhere in the
+// core. Hex only appears at the edges: object paths, the index file, tree
+// and commit content, refs and user-facing output.
+
+#define AVC_OID_RAWSZ 32
+#define AVC_OID_HEXSZ 64
+
+#ifndef AVC_OID_T_DEFINED
+#define AVC_OID_T_DEFINED
+typedef struct {
+    uint8_t bytes[AVC_OID_RAWSZ];
+} avc_oid_t;
+#endif
+
+// Decode exactly 2*len hex digits (either case); -1 on any non-hex digit
+int hex_decode(const char* hex, uint8_t* out, size_t len);
+
+// Encode len bytes as 2*len lowercase hex digits plus a terminating NUL
+void hex_encode(const uint8_t* bytes, size_t len, char* hex_out);
+
+// Parse a 64-digit hex object ID; -1 if it is short or malformed
+int oid_from_hex(const char* hex, avc_oid_t* oid_out);
+
+// Format an object ID as 64 lowercase hex digits plus NUL
+void oid_to_hex(const avc_oid_t* oid, char hex_out[AVC_OID_HEXSZ + 1]);
+
+static inline int oid_equal(const avc_oid_t* a, const avc_oid_t* b) {
+#if defined(__AVX2__)
+    __m256i va = _mm256_loadu_si256((const __m256i*)a->bytes);
+    __m256i vb = _mm256_loadu_si256((const __m256i*)b->bytes);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)) == -1;
+#elif defined(__SSE2__)
+    __m128i lo = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)a->bytes),
+                                _mm_loadu_si128((const __m128i*)b->bytes));
+    __m128i hi = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a->bytes + 16)),
+                                _mm_loadu_si128((const __m128i*)(b->bytes + 16)));
+    return _mm_movemask_epi8(_mm_and_si128(lo, hi)) == 0xffff;
+#else
+    return memcmp(a->bytes, b->bytes, AVC_OID_RAWSZ) == 0;
+#endif
+}
+
+// Total order for sorting (same order as comparing the hex forms)
+static inline int oid_cmp(const avc_oid_t* a, const avc_oid_t* b) {
+    return memcmp(a->bytes, b->bytes, AVC_OID_RAWSZ);
+}
+
+// BLAKE3 output is uniformly distributed, so any 8 bytes make a good hash
+static inline uint64_t oid_hash(const avc_oid_t* oid) {
+    uint64_t h;
+    memcpy(&h, oid->bytes, sizeof(h));
+    return h;
+}
+
+#endif // OID_H
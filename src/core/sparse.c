@@ -0,0 +1,87 @@
+#define _XOPEN_SOURCE 700
+#include "sparse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+static struct {
+    char** dirs;
+    size_t count;
+} g_cone;
+static pthread_once_t g_cone_once = PTHREAD_ONCE_INIT;
+
+// "./a/b/", "/a/b" and "a/b" are the same directory; "." is the root
+static const char* trim_path(char* path) {
+    while (strncmp(path, "./", 2) == 0) path += 2;
+    while (*path == '/') path++;
+    size_t len = strlen(path);
+    while (len > 0 && path[len - 1] == '/') path[--len] = '\0';
+    if (strcmp(path, ".") == 0) path[0] = '\0';
+    return path;
+}
+
+static void load_cone(void) {
+    FILE* f = fopen(SPARSE_FILE, "r");
+    if (!f) return;
+    char line[1024];
+    size_t capacity = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char* start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        // git's cone files also hold "/*" and "!/dir/*/"; those are implied here
+        if (*start == '\0' || *start == '#' || *start == '!' || strchr(start, '*')) continue;
+        const char* dir = trim_path(start);
+        if (!dir[0]) continue;
+
+        if (g_cone.count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            char** grown = realloc(g_cone.dirs, capacity * sizeof(char*));
+            if (!grown) break;
+            g_cone.dirs = grown;
+        }
+        g_cone.dirs[g_cone.count] = strdup(dir);
+        if (g_cone.dirs[g_cone.count]) g_cone.count++;
+    }
+    fclose(f);
+}
+
+int sparse_enabled(void) {
+    pthread_once(&g_cone_once, load_cone);
+    return g_cone.count > 0;
+}
+
+// dir is trimmed
+sparse_cone_t sparse_classify_dir(const char* dir) {
+    if (!sparse_enabled()) return SPARSE_INSIDE;
+    size_t len = strlen(dir);
+    if (len == 0) return SPARSE_PARENT;
+
+    sparse_cone_t result = SPARSE_OUTSIDE;
+    for (size_t i = 0; i < g_cone.count; i++) {
+        const char* cone = g_cone.dirs[i];
+        size_t cone_len = strlen(cone);
+        if (len >= cone_len && strncmp(dir, cone, cone_len) == 0 && (dir[cone_len] == '\0' || dir[cone_len] == '/')) {
+            return SPARSE_INSIDE;
+        }
+        if (cone_len > len && strncmp(cone, dir, len) == 0 && cone[len] == '/') {
+            result = SPARSE_PARENT;
+        }
+    }
+    return result;
+}
+
+int sparse_excludes(const char* path, int is_dir) {
+    if (!sparse_enabled()) return 0;
+    char buffer[1024];
+    snprintf(buffer, sizeof(buffer), "%s", path);
+    char* trimmed = (char*)trim_path(buffer);
+    if (!is_dir) {
+        // A file is in the cone when its directory is not outside it
+        char* slash = strrchr(trimmed, '/');
+        if (!slash) return 0;
+        *slash = '\0';
+    }
+    return sparse_classify_dir(trimmed) == SPARSE_OUTSIDE;
+}
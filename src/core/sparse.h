@@ -0,0 +1,34 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+// Cone-mode sparse checkout. .avc/sparse lists the directories to check
+// out, one per line ("services/api", or git's "/services/api/" form):
+//
+//   - everything under a listed directory is in the cone
+//   - files directly in the root and in the parents of listed directories
+//     are in the cone too
+//   - any other directory is outside, and the index holds it as a single
+//     collapsed entry: the directory's path with mode 040000 and the hash
+//     of its tree in the last commit. Commits reuse that hash unchanged.
+//
+// Without the file (or with no directories in it) everything is in the cone.
+
+#define SPARSE_FILE ".avc/sparse"
+#define SPARSE_DIR_MODE 040000
+
+// Nonzero if .avc/sparse lists any directory (read once)
+int sparse_enabled(void);
+
+// Nonzero if path (a file, or a directory if is_dir) is outside the cone
+int sparse_excludes(const char* path, int is_dir);
+
+typedef enum {
+    SPARSE_OUTSIDE,     // collapsed in the index
+    SPARSE_PARENT,      // leads to a cone directory: its files are in, its other subdirectories are not
+    SPARSE_INSIDE,
+} sparse_cone_t;
+
+// Where a directory ("" for the root) stands; SPARSE_INSIDE when disabled
+sparse_cone_t sparse_classify_dir(const char* dir);
+
+#endif // SPARSE_H
@@ -0,0 +1,385 @@
+#define _GNU_SOURCE
+#include "thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <omp.h>
+
+#define DEQUE_INITIAL_CAPACITY 256
+
+typedef struct {
+    thread_task_fn fn;
+    void* ctx;
+    size_t index;
+    task_group_t* group;
+} thread_task_t;
+
+// Mutex-guarded circular deque: owner uses the bottom, thieves the top
+typedef struct {
+    thread_task_t* tasks;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    pthread_mutex_t lock;
+} task_deque_t;
+
+// A parallel_for in progress; workers claim indices from `next`
+typedef struct loop_job {
+    thread_task_fn fn;
+    void* ctx;
+    size_t count;
+    _Atomic size_t next;
+    _Atomic size_t completed;
+    _Atomic size_t users;
+    struct loop_job* next_job;
+} loop_job_t;
+
+static struct {
+    pthread_once_t once;
+    int workers;              // Background threads (budget - 1)
+    int deque_count;          // workers + 1 shared deque for outside threads
+    task_deque_t* deques;
+    _Atomic size_t queued;    // Tasks sitting in any deque
+    _Atomic int sleeping;     // Idle workers and blocked waiters on idle_cond
+    _Atomic int claimable_loops;  // Loops with unclaimed items
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    pthread_mutex_t loop_lock;
+    loop_job_t* loops;
+} g_pool = { .once = PTHREAD_ONCE_INIT };
+
+static __thread int t_worker_id = -1;
+
+// ---------------------------------------------------------------------------
+// Thread budget
+// ---------------------------------------------------------------------------
+
+static int read_long(const char* path, long* value) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    int n = fscanf(f, "%ld", value);
+    fclose(f);
+    return n == 1 ? 0 : -1;
+}
+
+// CPUs granted by the cgroup CPU quota, or 0 if unlimited/unknown
+static int cgroup_cpu_limit(void) {
+    long quota = 0, period = 0;
+
+    // cgroup v2: "max 100000" or "<quota> <period>"
+    FILE* f = fopen("/sys/fs/cgroup/cpu.max", "r");
+    if (f) {
+        char quota_str[32];
+        int n = fscanf(f, "%31s %ld", quota_str, &period);
+        fclose(f);
+        if (n == 2 && strcmp(quota_str, "max") != 0) {
+            quota = atol(quota_str);
+        }
+    } else {
+        // cgroup v1
+        if (read_long("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", &quota) != 0 ||
+            read_long("/sys/fs/cgroup/cpu/cpu.cfs_period_us", &period) != 0) {
+            quota = 0;
+        }
+    }
+
+    if (quota <= 0 || period <= 0) return 0;
+    return (int)((quota + period - 1) / period);
+}
+
+static int g_budget = 0;
+static pthread_once_t g_budget_once = PTHREAD_ONCE_INIT;
+
+static void detect_budget(void) {
+    const char* env = getenv("AVC_THREADS");
+    if (env && atoi(env) > 0) {
+        g_budget = atoi(env);
+        return;
+    }
+
+    int cpus = 0;
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        cpus = CPU_COUNT(&set);
+    }
+    if (cpus <= 0) cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0) cpus = 1;
+
+    int quota = cgroup_cpu_limit();
+    if (quota > 0 && quota < cpus) cpus = quota;
+
+    g_budget = cpus;
+}
+
+int thread_pool_budget(void) {
+    pthread_once(&g_budget_once, detect_budget);
+    return g_budget;
+}
+
+// ---------------------------------------------------------------------------
+// Deques
+// ---------------------------------------------------------------------------
+
+static int deque_push(task_deque_t* d, const thread_task_t* task) {
+    pthread_mutex_lock(&d->lock);
+    if (d->count == d->capacity) {
+        size_t new_capacity = d->capacity ? d->capacity * 2 : DEQUE_INITIAL_CAPACITY;
+        thread_task_t* grown = malloc(new_capacity * sizeof(thread_task_t));
+        if (!grown) {
+            pthread_mutex_unlock(&d->lock);
+            return -1;
+        }
+        for (size_t i = 0; i < d->count; i++) {
+            grown[i] = d->tasks[(d->head + i) % d->capacity];
+        }
+        free(d->tasks);
+        d->tasks = grown;
+        d->capacity = new_capacity;
+        d->head = 0;
+    }
+    d->tasks[(d->head + d->count) % d->capacity] = *task;
+    d->count++;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+static int deque_pop_bottom(task_deque_t* d, thread_task_t* out) {
+    pthread_mutex_lock(&d->lock);
+    if (d->count == 0) {
+        pthread_mutex_unlock(&d->lock);
+        return 0;
+    }
+    d->count--;
+    *out = d->tasks[(d->head + d->count) % d->capacity];
+    pthread_mutex_unlock(&d->lock);
+    return 1;
+}
+
+static int deque_steal_top(task_deque_t* d, thread_task_t* out) {
+    pthread_mutex_lock(&d->lock);
+    if (d->count == 0) {
+        pthread_mutex_unlock(&d->lock);
+        return 0;
+    }
+    *out = d->tasks[d->head];
+    d->head = (d->head + 1) % d->capacity;
+    d->count--;
+    pthread_mutex_unlock(&d->lock);
+    return 1;
+}
+
+static int own_deque(void) {
+    return t_worker_id >= 0 ? t_worker_id : g_pool.workers;
+}
+
+// Pop from our own deque, otherwise steal from the others
+static int find_task(thread_task_t* out) {
+    if (atomic_load(&g_pool.queued) == 0) return 0;
+
+    int own = own_deque();
+    int found = deque_pop_bottom(&g_pool.deques[own], out);
+    for (int k = 1; !found && k < g_pool.deque_count; k++) {
+        found = deque_steal_top(&g_pool.deques[(own + k) % g_pool.deque_count], out);
+    }
+    if (found) atomic_fetch_sub(&g_pool.queued, 1);
+    return found;
+}
+
+static void wake_workers(int all) {
+    if (atomic_load(&g_pool.sleeping) == 0) return;
+    pthread_mutex_lock(&g_pool.idle_lock);
+    if (all) {
+        pthread_cond_broadcast(&g_pool.idle_cond);
+    } else {
+        pthread_cond_signal(&g_pool.idle_cond);
+    }
+    pthread_mutex_unlock(&g_pool.idle_lock);
+}
+
+// The last task of a group wakes whoever waits for it
+static void run_task(const thread_task_t* task) {
+    task_group_t* group = task->group;
+    task->fn(task->ctx, task->index);
+    if (group && atomic_fetch_sub(&group->pending, 1) == 1) wake_workers(1);
+}
+
+// Run queued tasks until *value reaches target, sleeping while there are
+// none. Whoever moves *value to target calls wake_workers(1) afterwards.
+static void wait_until(_Atomic size_t* value, size_t target) {
+    thread_task_t task;
+    while (atomic_load(value) != target) {
+        if (find_task(&task)) {
+            run_task(&task);
+            continue;
+        }
+        pthread_mutex_lock(&g_pool.idle_lock);
+        atomic_fetch_add(&g_pool.sleeping, 1);
+        while (atomic_load(value) != target && atomic_load(&g_pool.queued) == 0) {
+            pthread_cond_wait(&g_pool.idle_cond, &g_pool.idle_lock);
+        }
+        atomic_fetch_sub(&g_pool.sleeping, 1);
+        pthread_mutex_unlock(&g_pool.idle_lock);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Parallel loops
+// ---------------------------------------------------------------------------
+
+// Claim and run loop items, preferring queued tasks (split work) in between.
+// The one claim that runs past the end retires the loop, so idle workers
+// stop looking at it; the last item to finish wakes the loop's owner.
+static void drain_loop(loop_job_t* job) {
+    thread_task_t task;
+    for (;;) {
+        while (find_task(&task)) run_task(&task);
+
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) {
+            if (i == job->count) atomic_fetch_sub(&g_pool.claimable_loops, 1);
+            break;
+        }
+        job->fn(job->ctx, i);
+        if (atomic_fetch_add(&job->completed, 1) + 1 == job->count) wake_workers(1);
+    }
+}
+
+// Join the oldest loop that still has unclaimed items
+static int help_loop(void) {
+    if (atomic_load(&g_pool.claimable_loops) == 0) return 0;
+
+    pthread_mutex_lock(&g_pool.loop_lock);
+    loop_job_t* job = g_pool.loops;
+    while (job && atomic_load(&job->next) >= job->count) job = job->next_job;
+    if (job) atomic_fetch_add(&job->users, 1);
+    pthread_mutex_unlock(&g_pool.loop_lock);
+
+    if (!job) return 0;
+    drain_loop(job);
+    if (atomic_fetch_sub(&job->users, 1) == 1) wake_workers(1);
+    return 1;
+}
+
+static void* worker_main(void* arg) {
+    t_worker_id = (int)(size_t)arg;
+    thread_task_t task;
+
+    for (;;) {
+        if (find_task(&task)) {
+            run_task(&task);
+            continue;
+        }
+        if (help_loop()) continue;
+
+        // Loops whose items are all claimed are left to their owners
+        pthread_mutex_lock(&g_pool.idle_lock);
+        atomic_fetch_add(&g_pool.sleeping, 1);
+        while (atomic_load(&g_pool.queued) == 0 && atomic_load(&g_pool.claimable_loops) == 0) {
+            pthread_cond_wait(&g_pool.idle_cond, &g_pool.idle_lock);
+        }
+        atomic_fetch_sub(&g_pool.sleeping, 1);
+        pthread_mutex_unlock(&g_pool.idle_lock);
+    }
+    return NULL;
+}
+
+static void pool_start(void) {
+    int budget = thread_pool_budget();
+
+    // Leftover OpenMP regions share the same budget
+    omp_set_num_threads(budget);
+
+    g_pool.workers = budget - 1;
+    g_pool.deque_count = g_pool.workers + 1;
+    g_pool.deques = calloc(g_pool.deque_count, sizeof(task_deque_t));
+    if (!g_pool.deques) {
+        fprintf(stderr, "Failed to allocate thread pool\n");
+        exit(1);
+    }
+    for (int i = 0; i < g_pool.deque_count; i++) {
+        pthread_mutex_init(&g_pool.deques[i].lock, NULL);
+    }
+    pthread_mutex_init(&g_pool.idle_lock, NULL);
+    pthread_cond_init(&g_pool.idle_cond, NULL);
+    pthread_mutex_init(&g_pool.loop_lock, NULL);
+
+    for (int i = 0; i < g_pool.workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_main, (void*)(size_t)i) != 0) {
+            // Fewer workers is fine, the calling thread always helps
+            g_pool.workers = i;
+            break;
+        }
+        pthread_detach(thread);
+    }
+}
+
+static void ensure_pool(void) {
+    pthread_once(&g_pool.once, pool_start);
+}
+
+// ---------------------------------------------------------------------------
+// Public API
+// ---------------------------------------------------------------------------
+
+void task_group_init(task_group_t* group) {
+    atomic_init(&group->pending, 0);
+}
+
+void thread_pool_spawn(task_group_t* group, thread_task_fn fn, void* ctx, size_t index) {
+    ensure_pool();
+
+    thread_task_t task = { fn, ctx, index, group };
+    if (group) atomic_fetch_add(&group->pending, 1);
+
+    if (deque_push(&g_pool.deques[own_deque()], &task) != 0) {
+        // Out of memory for the queue; run inline instead
+        run_task(&task);
+        return;
+    }
+    atomic_fetch_add(&g_pool.queued, 1);
+    wake_workers(0);
+}
+
+void thread_pool_wait(task_group_t* group) {
+    wait_until(&group->pending, 0);
+}
+
+void thread_pool_parallel_for(size_t count, thread_task_fn fn, void* ctx) {
+    if (count == 0) return;
+    ensure_pool();
+
+    if (g_pool.workers == 0 || count == 1) {
+        for (size_t i = 0; i < count; i++) fn(ctx, i);
+        return;
+    }
+
+    loop_job_t job = { .fn = fn, .ctx = ctx, .count = count };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.completed, 0);
+    atomic_init(&job.users, 0);
+
+    pthread_mutex_lock(&g_pool.loop_lock);
+    job.next_job = g_pool.loops;
+    g_pool.loops = &job;
+    pthread_mutex_unlock(&g_pool.loop_lock);
+    atomic_fetch_add(&g_pool.claimable_loops, 1);
+    wake_workers(1);
+
+    drain_loop(&job);
+
+    // Everything is claimed; help with split work until the stragglers finish
+    wait_until(&job.completed, count);
+
+    pthread_mutex_lock(&g_pool.loop_lock);
+    loop_job_t** link = &g_pool.loops;
+    while (*link != &job) link = &(*link)->next_job;
+    *link = job.next_job;
+    pthread_mutex_unlock(&g_pool.loop_lock);
+
+    // Workers may still hold a pointer to the (stack) job
+    wait_until(&job.users, 0);
+}
@@ -0,0 +1,38 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Persistent work-stealing thread pool shared by every parallel operation.
+// Worker threads are started once, sized by the global thread budget, and
+// each owns a deque: spawned tasks go to the owner's bottom and idle workers
+// steal from the top. Threads waiting on a group run other tasks meanwhile,
+// so nested fork/join (e.g. splitting one huge file) never deadlocks.
+
+typedef void (*thread_task_fn)(void* ctx, size_t index);
+
+// Completion counter for a set of spawned tasks
+typedef struct {
+    _Atomic size_t pending;
+} task_group_t;
+
+// Total number of threads AVC may keep busy: AVC_THREADS if set, otherwise
+// the CPUs we are allowed to run on, capped by the cgroup CPU quota.
+int thread_pool_budget(void);
+
+// Initialize an empty task group
+void task_group_init(task_group_t* group);
+
+// Queue fn(ctx, index) on the pool as part of group
+void thread_pool_spawn(task_group_t* group, thread_task_fn fn, void* ctx, size_t index);
+
+// Block until every task in group finished, running queued tasks meanwhile
+// and sleeping while there are none
+void thread_pool_wait(task_group_t* group);
+
+// Run fn(ctx, i) for i in [0, count). Items are claimed in index order, so
+// callers sort them by priority (largest first) to avoid a long tail.
+void thread_pool_parallel_for(size_t count, thread_task_fn fn, void* ctx);
+
+#endif // THREAD_POOL_H
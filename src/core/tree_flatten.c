@@ -0,0 +1,256 @@
+#define _XOPEN_SOURCE 700
+#include "tree_flatten.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "objects.h"
+#include "sparse.h"
+#include "thread_pool.h"
+
+// Collected entry; the path is an offset into the task's own string buffer
+typedef struct {
+    size_t path_offset;
+    avc_oid_t oid;
+    unsigned int mode;
+} flat_entry_t;
+
+typedef struct flatten_task {
+    struct flatten_job* job;
+    avc_oid_t oid;
+    tree_flatten_t walk;
+    char* prefix;
+    flat_entry_t* entries;
+    size_t count, capacity;
+    char* paths;
+    size_t paths_len, paths_capacity;
+    struct flatten_task* next;          // Every task of the job, for the merge
+    struct flatten_task* next_spawn;    // Subtrees of the parent waiting to be spawned
+} flatten_task_t;
+
+typedef struct flatten_job {
+    task_group_t group;
+    _Atomic(flatten_task_t*) tasks;
+    _Atomic int failed;
+} flatten_job_t;
+
+static void flatten_subtree(void* ctx, size_t index);
+
+static flatten_task_t* create_task(flatten_job_t* job, const avc_oid_t* oid, const char* prefix,
+                                   size_t prefix_len, tree_flatten_t walk) {
+    flatten_task_t* task = calloc(1, sizeof(flatten_task_t));
+    if (!task || !(task->prefix = malloc(prefix_len + 1))) {
+        free(task);
+        atomic_store(&job->failed, 1);
+        return NULL;
+    }
+    memcpy(task->prefix, prefix, prefix_len);
+    task->prefix[prefix_len] = '\0';
+    task->job = job;
+    task->oid = *oid;
+    task->walk = walk;
+
+    flatten_task_t* head = atomic_load(&job->tasks);
+    do {
+        task->next = head;
+    } while (!atomic_compare_exchange_weak(&job->tasks, &head, task));
+    return task;
+}
+
+// Append "<prefix>/<name>" to the task's paths; returns its offset or -1
+static long append_path(flatten_task_t* task, const char* name, size_t name_len) {
+    size_t prefix_len = strlen(task->prefix);
+    size_t needed = prefix_len + 1 + name_len + 1;
+    if (task->paths_len + needed > task->paths_capacity) {
+        size_t capacity = task->paths_capacity ? task->paths_capacity * 2 : 4096;
+        while (capacity < task->paths_len + needed) capacity *= 2;
+        char* grown = realloc(task->paths, capacity);
+        if (!grown) return -1;
+        task->paths = grown;
+        task->paths_capacity = capacity;
+    }
+
+    size_t offset = task->paths_len;
+    char* out = task->paths + offset;
+    if (prefix_len) {
+        memcpy(out, task->prefix, prefix_len);
+        out[prefix_len++] = '/';
+    }
+    memcpy(out + prefix_len, name, name_len);
+    out[prefix_len + name_len] = '\0';
+    task->paths_len += prefix_len + name_len + 1;
+    return (long)offset;
+}
+
+static int add_entry(flatten_task_t* task, size_t path_offset, const avc_oid_t* oid, unsigned int mode) {
+    if (task->count == task->capacity) {
+        size_t capacity = task->capacity ? task->capacity * 2 : 64;
+        flat_entry_t* grown = realloc(task->entries, capacity * sizeof(flat_entry_t));
+        if (!grown) return -1;
+        task->entries = grown;
+        task->capacity = capacity;
+    }
+    task->entries[task->count++] = (flat_entry_t){path_offset, *oid, mode};
+    return 0;
+}
+
+// "<octal mode> <name> <hex>"; name may contain spaces
+static int parse_tree_line(const char* line, size_t len, unsigned int* mode, const char** name,
+                           size_t* name_len, avc_oid_t* oid) {
+    if (len < AVC_OID_HEXSZ + 4 || line[len - AVC_OID_HEXSZ - 1] != ' ') return -1;
+    char hex[AVC_OID_HEXSZ + 1];
+    memcpy(hex, line + len - AVC_OID_HEXSZ, AVC_OID_HEXSZ);
+    hex[AVC_OID_HEXSZ] = '\0';
+    if (oid_from_hex(hex, oid) != 0) return -1;
+
+    const char* p = line;
+    *mode = 0;
+    while (*p >= '0' && *p <= '7') *mode = *mode * 8 + (unsigned int)(*p++ - '0');
+    if (p == line || *p != ' ') return -1;
+    *name = p + 1;
+    *name_len = (size_t)(line + len - AVC_OID_HEXSZ - 1 - *name);
+    return *name_len > 0 ? 0 : -1;
+}
+
+static void flatten_subtree(void* ctx, size_t index) {
+    (void)index;
+    flatten_task_t* task = ctx;
+    flatten_job_t* job = task->job;
+    if (atomic_load(&job->failed)) return;
+
+    size_t tree_size;
+    char tree_type[16];
+    char* tree_content = load_object(&task->oid, &tree_size, tree_type);
+    if (!tree_content || strcmp(tree_type, "tree") != 0) {
+        free(tree_content);
+        atomic_store(&job->failed, 1);
+        return;
+    }
+
+    // Subtrees are prefetched while this one is parsed, then spawned
+    flatten_task_t* subtasks = NULL;
+    const char* end = tree_content + tree_size;
+    for (const char* line = tree_content; line < end;) {
+        const char* next = memchr(line, '\n', (size_t)(end - line));
+        size_t line_len = next ? (size_t)(next - line) : (size_t)(end - line);
+        unsigned int mode;
+        const char* name;
+        size_t name_len;
+        avc_oid_t oid;
+
+        if (parse_tree_line(line, line_len, &mode, &name, &name_len, &oid) == 0 &&
+            (mode == SPARSE_DIR_MODE || task->walk != TREE_FLATTEN_COLLAPSED)) {
+            int is_dir = mode == SPARSE_DIR_MODE;
+            long offset = append_path(task, name, name_len);
+            if (offset < 0) {
+                atomic_store(&job->failed, 1);
+                break;
+            }
+            const char* path = task->paths + offset;
+
+            tree_flatten_t sub_walk = task->walk;
+            int expand = 0, keep = !is_dir;
+            if (is_dir && task->walk != TREE_FLATTEN_ALL) {
+                sparse_cone_t cone = sparse_classify_dir(path);
+                keep = cone == SPARSE_OUTSIDE;
+                expand = cone == SPARSE_PARENT || (cone == SPARSE_INSIDE && task->walk == TREE_FLATTEN_CONE);
+                // Nothing below a cone directory is collapsed
+                if (cone == SPARSE_INSIDE) sub_walk = TREE_FLATTEN_ALL;
+            } else if (is_dir) {
+                expand = 1;
+            }
+
+            if (expand) {
+                flatten_task_t* sub = create_task(job, &oid, path, strlen(path), sub_walk);
+                if (!sub) break;
+                object_prefetch(&oid);
+                sub->next_spawn = subtasks;
+                subtasks = sub;
+            }
+            if (keep) {
+                if (add_entry(task, (size_t)offset, &oid, mode) != 0) {
+                    atomic_store(&job->failed, 1);
+                    break;
+                }
+            } else {
+                task->paths_len = (size_t)offset;   // Path no longer needed
+            }
+        }
+        line = next ? next + 1 : end;
+    }
+    free(tree_content);
+
+    for (flatten_task_t* sub = subtasks; sub; sub = sub->next_spawn) {
+        thread_pool_spawn(&job->group, flatten_subtree, sub, 0);
+    }
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(((const tree_file_t*)a)->path, ((const tree_file_t*)b)->path);
+}
+
+int tree_flatten(const avc_oid_t* tree_oid, const char* prefix, tree_flatten_t walk, tree_files_t* out) {
+    memset(out, 0, sizeof(*out));
+    flatten_job_t job;
+    task_group_init(&job.group);
+    atomic_init(&job.tasks, NULL);
+    atomic_init(&job.failed, 0);
+
+    flatten_task_t* root = create_task(&job, tree_oid, prefix, strlen(prefix), walk);
+    if (root) {
+        thread_pool_spawn(&job.group, flatten_subtree, root, 0);
+        thread_pool_wait(&job.group);
+    }
+
+    // Merge the task buffers into one entry array and one path arena
+    flatten_task_t* tasks = atomic_load(&job.tasks);
+    size_t count = 0, bytes = 0;
+    for (flatten_task_t* task = tasks; task; task = task->next) {
+        count += task->count;
+        bytes += task->paths_len;
+    }
+    int failed = atomic_load(&job.failed);
+    if (!failed) {
+        out->files = malloc((count ? count : 1) * sizeof(tree_file_t));
+        out->arena = malloc(bytes ? bytes : 1);
+        failed = !out->files || !out->arena;
+    }
+
+    size_t at = 0, arena_at = 0;
+    while (tasks) {
+        flatten_task_t* task = tasks;
+        tasks = task->next;
+        if (!failed) {
+            memcpy(out->arena + arena_at, task->paths, task->paths_len);
+            for (size_t i = 0; i < task->count; i++) {
+                const flat_entry_t* entry = &task->entries[i];
+                out->files[at++] = (tree_file_t){out->arena + arena_at + entry->path_offset, entry->oid, entry->mode};
+            }
+            arena_at += task->paths_len;
+        }
+        free(task->entries);
+        free(task->paths);
+        free(task->prefix);
+        free(task);
+    }
+
+    if (failed) {
+        tree_files_free(out);
+        return -1;
+    }
+    out->count = count;
+    qsort(out->files, count, sizeof(tree_file_t), compare_paths);
+    return 0;
+}
+
+const tree_file_t* tree_files_find(const tree_files_t* list, const char* path) {
+    if (strncmp(path, "./", 2) == 0) path += 2;
+    tree_file_t key = {path, {{0}}, 0};
+    return list->count ? bsearch(&key, list->files, list->count, sizeof(tree_file_t), compare_paths) : NULL;
+}
+
+void tree_files_free(tree_files_t* list) {
+    free(list->files);
+    free(list->arena);
+    memset(list, 0, sizeof(*list));
+}
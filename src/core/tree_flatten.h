@@ -0,0 +1,41 @@
+#ifndef TREE_FLATTEN_H
+#define TREE_FLATTEN_H
+
+#include <stddef.h>
+#include "oid.h"
+
+// A tree flattened to its files, sorted by path. Paths ("dir/file", no
+// "./") are stored back to back in one arena owned by the list.
+typedef struct {
+    const char* path;
+    avc_oid_t oid;
+    unsigned int mode;
+} tree_file_t;
+
+typedef struct {
+    tree_file_t* files;
+    size_t count;
+    char* arena;
+} tree_files_t;
+
+typedef enum {
+    TREE_FLATTEN_CONE,       // files in the sparse checkout, and collapsed directories
+    TREE_FLATTEN_COLLAPSED,  // collapsed directories only
+    TREE_FLATTEN_ALL,        // every file, ignoring the sparse checkout
+} tree_flatten_t;
+
+// Flatten a tree whose entries are at prefix ("" for the root). Each
+// subtree is a task on the thread pool: it prefetches the objects of its
+// own subtrees, spawns them and collects its entries into a buffer of its
+// own, so siblings are read and parsed concurrently. The buffers are then
+// merged into one sorted list. Trees outside the sparse checkout are never
+// read, and TREE_FLATTEN_COLLAPSED only reads the trees leading to it.
+// Returns -1 (with out empty) if a tree cannot be read.
+int tree_flatten(const avc_oid_t* tree_oid, const char* prefix, tree_flatten_t walk, tree_files_t* out);
+
+// Entry for a path (a leading "./" is ignored), by binary search
+const tree_file_t* tree_files_find(const tree_files_t* list, const char* path);
+
+void tree_files_free(tree_files_t* list);
+
+#endif // TREE_FLATTEN_H